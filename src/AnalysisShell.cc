@@ -3,15 +3,35 @@
 
 #include <algorithm>
 #include <atomic>
+#include <bit>
+#include <map>
 #include <mutex>
+#include <optional>
 #include <phosg/Arguments.hh>
+#include <queue>
 #include <set>
 
 #include "AnalysisShell.hh"
+#include "Types/GlibcMalloc.hh"
 #include "Types/PyAsyncObjects.hh"
+#include "Types/PyContextObjects.hh"
+#include "Types/PyDequeObject.hh"
+#include "Types/PyDictObject.hh"
+#include "Types/PyExceptionObjects.hh"
+#include "Types/PyFloatObject.hh"
+#include "Types/PyFunctionObjects.hh"
+#include "Types/PyGCRuntimeState.hh"
 #include "Types/PyGeneratorObjects.hh"
+#include "Types/PyIntegerObjects.hh"
+#include "Types/PyListObject.hh"
+#include "Types/PySetObject.hh"
+#include "Types/PySimpleQueueObject.hh"
+#include "Types/PyThreadLockObjects.hh"
 #include "Types/PyThreadState.hh"
+#include "Types/PyTupleObject.hh"
 #include "Types/PyTypeObject.hh"
+#include "Types/PymallocPool.hh"
+#include "Types/Tracemalloc.hh"
 
 struct ShellCommand {
   std::string name;
@@ -102,6 +122,164 @@ static void find_all_type_objects(Environment& env, size_t max_threads) {
   }
 }
 
+static inline uint64_t mix_hash(uint64_t v) {
+  // splitmix64 finalizer; used for combining hashes in an order-independent way
+  v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9;
+  v = (v ^ (v >> 27)) * 0x94D049BB133111EB;
+  return v ^ (v >> 31);
+}
+
+static std::unordered_map<MappedPtr<PyTypeObject>, std::string> names_for_types(const Environment& env) {
+  std::unordered_map<MappedPtr<PyTypeObject>, std::string> ret;
+  for (const auto& [name, type] : env.type_objects) {
+    ret.emplace(type, name);
+  }
+  return ret;
+}
+
+// Returns the __dict__ of the object if it's an instance of a Python-defined class, or null if it isn't or it doesn't
+// have a valid __dict__. Only the object's header is checked, so callers must validate any other fields they use.
+static MappedPtr<PyDictObject> heap_instance_dict(const Environment& env, const PyObject& obj, MappedPtr<PyObject> addr) {
+  if (!env.r.get(obj.ob_type).is_heap_type() || obj.invalid_reason(env)) {
+    return MappedPtr<PyDictObject>();
+  }
+  return env.instance_dict(addr);
+}
+
+// Returns the attribute name for a key in an instance __dict__. Most attribute names are interned, so scans can key
+// per-attribute stats by the key object's address and decode the names with this when merging the results.
+static std::string attribute_name(const Environment& env, MappedPtr<PyObject> key_addr) {
+  try {
+    return decode_string_types(env.r, key_addr);
+  } catch (const std::exception&) {
+    return std::format("<key@{}>", key_addr);
+  }
+}
+
+// Returns all known types that have any of the given base types in their MROs (including the types themselves).
+// Heap types' names don't include their modules (e.g. "BaseEventLoop", not "asyncio.base_events.BaseEventLoop"), so
+// if module_prefix isn't empty, only base types defined in modules whose names start with it are considered.
+static std::unordered_set<MappedPtr<PyTypeObject>> subclasses_of(
+    const Environment& env, const std::vector<std::string>& base_names, const std::string& module_prefix = "") {
+  std::unordered_set<MappedPtr<PyTypeObject>> ret;
+  for (const auto& [_, type_addr] : env.type_objects) {
+    try {
+      const auto& type_obj = env.r.get(type_addr);
+      for (const auto& base_name : base_names) {
+        if (!type_obj.find_in_mro(env, base_name, module_prefix).is_null()) {
+          ret.emplace(type_addr);
+          break;
+        }
+      }
+    } catch (const std::out_of_range&) {
+    }
+  }
+  return ret;
+}
+
+// Scans memory for objects whose type is in the given set, and returns their addresses in sorted order. Only checks
+// the object header; callers should validate the objects' contents.
+static std::vector<MappedPtr<PyObject>> find_instances_of_types(
+    AnalysisShell& shell, const std::unordered_set<MappedPtr<PyTypeObject>>& types) {
+  std::vector<std::vector<MappedPtr<PyObject>>> thread_results;
+  thread_results.resize(shell.max_threads);
+  if (!types.empty()) {
+    shell.env.r.map_all_addresses<PyObject>([&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+      if (types.count(obj.ob_type) && !obj.invalid_reason(shell.env)) {
+        thread_results[thread_index].emplace_back(addr);
+      }
+    },
+        8, shell.max_threads);
+    phosg::fwrite_fmt(stderr, CLEAR_LINE);
+  }
+  std::vector<MappedPtr<PyObject>> ret;
+  for (const auto& results : thread_results) {
+    ret.insert(ret.end(), results.begin(), results.end());
+  }
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+// Finds all valid thread states, in address order
+static std::vector<MappedPtr<PyThreadState>> find_thread_states(AnalysisShell& shell) {
+  std::mutex results_lock;
+  std::vector<MappedPtr<PyThreadState>> ret;
+  shell.env.r.map_all_addresses<PyThreadState>(
+      [&](const PyThreadState& ts, MappedPtr<PyThreadState> addr, size_t) -> void {
+        if (!ts.invalid_reason(shell.env)) {
+          std::lock_guard<std::mutex> g(results_lock);
+          ret.emplace_back(addr);
+        }
+      },
+      8, shell.max_threads);
+  phosg::fwrite_fmt(stderr, CLEAR_LINE);
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+// Returns "name (filename:line)" for the innermost frame that the task's coroutine is suspended in
+static std::string task_await_location(const Environment& env, MappedPtr<PyObject> task_addr) {
+  try {
+    const auto& task = env.r.get(task_addr.cast<PyAsyncTaskObject>());
+    const auto& coro_obj = env.r.get(task.task_coro);
+    if ((coro_obj.ob_type != env.get_type_if_exists("coroutine")) && (coro_obj.ob_type != env.get_type_if_exists("generator"))) {
+      return std::format("<{}>", env.r.get(coro_obj.ob_type).name(env.r));
+    }
+    auto frame_addr = env.r.get(task.task_coro.cast<PyGenObject>()).innermost_frame(env);
+    return frame_addr.is_null() ? "<finished>" : env.r.get(frame_addr).location(env);
+  } catch (const std::out_of_range&) {
+    return "<!invalid_addr>";
+  }
+}
+
+// Finds all valid tasks and returns a map of {awaited future: task awaiting it}
+static std::unordered_map<MappedPtr<PyObject>, MappedPtr<PyObject>> tasks_by_awaited_future(AnalysisShell& shell) {
+  std::unordered_map<MappedPtr<PyObject>, MappedPtr<PyObject>> ret;
+  auto task_type = shell.env.get_type_if_exists("_asyncio.Task");
+  if (task_type.is_null()) {
+    return ret;
+  }
+  for (auto task_addr : find_instances_of_types(shell, {task_type})) {
+    const auto& task = shell.env.r.get(task_addr.cast<PyAsyncTaskObject>());
+    if (!task.invalid_reason(shell.env) && !task.task_fut_waiter.is_null()) {
+      ret.emplace(task.task_fut_waiter, task_addr);
+    }
+  }
+  return ret;
+}
+
+// Returns the value of an int attribute of an instance as a string, or "?" if it's missing or not an int
+static std::string int_attribute_str(const Environment& env, MappedPtr<PyObject> addr, const char* name) {
+  auto value_addr = env.get_attribute(addr, name);
+  if (!value_addr.is_null() && !env.invalid_reason(value_addr, env.get_type_if_exists("int"))) {
+    try {
+      return std::format("{}", env.r.get(value_addr.cast<PyLongObject>()).as_int64(env.r));
+    } catch (const std::out_of_range&) {
+    }
+  }
+  return "?";
+}
+
+// Returns the value of a str attribute of an instance, or an empty string if it's missing or not a str
+static std::string str_attribute(const Environment& env, MappedPtr<PyObject> addr, const char* name) {
+  auto value_addr = env.get_attribute(addr, name);
+  if (!value_addr.is_null() && !env.invalid_reason(value_addr, env.get_type_if_exists("str"))) {
+    return decode_string_types(env.r, value_addr, 0x400);
+  }
+  return "";
+}
+
+// Returns true if the object is the True singleton (or any nonzero int)
+static bool is_truthy_int(const Environment& env, MappedPtr<PyObject> addr) {
+  try {
+    const auto& obj = env.r.get(addr.cast<PyVarObject>());
+    return ((obj.ob_type == env.get_type_if_exists("bool")) || (obj.ob_type == env.get_type_if_exists("int"))) &&
+        (obj.ob_size != 0);
+  } catch (const std::out_of_range&) {
+    return false;
+  }
+}
+
 AnalysisShell::AnalysisShell(const std::string& data_path, size_t max_threads)
     : max_threads(max_threads), env(data_path) {
   if (this->max_threads == 0) {
@@ -489,6 +667,300 @@ ShellCommand c_find_all_threads(
           8, shell.max_threads);
     });
 
+ShellCommand c_thread_locks(
+    "thread-locks", "\
+  thread-locks [OPTIONS]\n\
+    Finds all threading locks (_thread.lock and _thread.RLock objects) and\n\
+    thread states, and determines which lock each thread is blocked on and\n\
+    which threads hold it. From this, builds a wait-for graph between threads\n\
+    and reports any cycles in it (deadlocks), and the most contended locks.\n\
+    Locks are attributed to frames by looking at their local variables and\n\
+    value stacks. A thread is considered blocked on a lock if its innermost\n\
+    frame is calling the lock's acquire method or entering a with statement\n\
+    on it, and the lock is held (for RLocks, by a different thread). RLocks\n\
+    record their owners; plain Locks don't, so they're considered held by\n\
+    every thread that has them in any frame and isn't acquiring them. This is\n\
+    a heuristic, so check the reported stacks before concluding that a\n\
+    deadlock exists. Threads blocked in threading.Condition.wait are shown as\n\
+    waiting for a notify instead. Options:\n\
+      --max-results=N: Show at most this many contended locks (default 20).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t max_results = args.get<size_t>("max-results", 20);
+
+      auto lock_type = shell.env.get_type_if_exists("_thread.lock");
+      auto rlock_type = shell.env.get_type_if_exists("_thread.RLock");
+      if (lock_type.is_null() && rlock_type.is_null()) {
+        throw std::runtime_error("_thread.lock and _thread.RLock types are missing; run find-all-types first");
+      }
+      auto method_type = shell.env.get_type_if_exists("builtin_function_or_method");
+      auto method_descr_type = shell.env.get_type_if_exists("method_descriptor");
+      auto deque_type = shell.env.get_type_if_exists("collections.deque");
+
+      // Count all locks, not just those referenced from frames, so it's clear how many are held overall
+      size_t num_locks = 0, num_locked = 0;
+      for (auto addr : find_instances_of_types(shell, {lock_type, rlock_type})) {
+        if (shell.env.invalid_reason(addr)) {
+          continue;
+        }
+        num_locks++;
+        if (shell.env.r.get(addr).ob_type == lock_type) {
+          num_locked += shell.env.r.get(addr.cast<PyThreadLockObject>()).locked;
+        } else {
+          num_locked += (shell.env.r.get(addr.cast<PyThreadRLockObject>()).rlock_count > 0);
+        }
+      }
+      phosg::fwrite_fmt(stdout, "{} threading locks found; {} are held\n", num_locks, num_locked);
+
+      // Map each Condition's per-waiter locks back to the Condition
+      std::unordered_map<MappedPtr<PyObject>, MappedPtr<PyObject>> condition_for_waiter_lock;
+      for (auto cond_addr : find_instances_of_types(shell, subclasses_of(shell.env, {"Condition"}, "threading"))) {
+        auto waiters_addr = shell.env.get_attribute(cond_addr, "_waiters");
+        if (!waiters_addr.is_null() && !shell.env.invalid_reason(waiters_addr, deque_type)) {
+          for (auto waiter_addr : shell.env.r.get(waiters_addr.cast<PyDequeObject>()).get_items(shell.env.r)) {
+            condition_for_waiter_lock.emplace(waiter_addr, cond_addr);
+          }
+        }
+      }
+
+      // Returns the lock that a frame slot refers to (either the lock itself, or a bound method of it such as
+      // lock.acquire), or null if it doesn't refer to a lock
+      auto lock_for_slot = [&](MappedPtr<PyObject> slot_addr) -> MappedPtr<PyObject> {
+        if (!shell.env.r.obj_valid(slot_addr)) {
+          return MappedPtr<PyObject>();
+        }
+        auto type_addr = shell.env.r.get(slot_addr).ob_type;
+        if (!method_type.is_null() && (type_addr == method_type)) {
+          slot_addr = shell.env.r.get(slot_addr.cast<PyCFunctionObject>()).m_self;
+          if (!shell.env.r.obj_valid(slot_addr)) {
+            return MappedPtr<PyObject>();
+          }
+          type_addr = shell.env.r.get(slot_addr).ob_type;
+        }
+        if (((type_addr != lock_type) && (type_addr != rlock_type)) || shell.env.invalid_reason(slot_addr)) {
+          return MappedPtr<PyObject>();
+        }
+        return slot_addr;
+      };
+      // Returns the lock that a frame is currently acquiring, or null if it isn't acquiring one. This is the case if
+      // the current instruction is a call to a lock's acquire method (the stack holds either a bound method, or a
+      // method_descriptor followed by the lock for LOAD_METHOD/CALL_METHOD), or a with statement entering a lock
+      // (SETUP_WITH pushes the lock's __exit__ method before calling __enter__). Only stack slots at or above the
+      // innermost block's level are considered, since slots below it belong to enclosing with statements, whose locks
+      // this thread already holds.
+      auto lock_being_acquired = [&](const PyFrameObject& frame) -> MappedPtr<PyObject> {
+        int16_t opcode = frame.current_opcode(shell.env);
+        bool is_call = (opcode == PyOpcode::CALL_FUNCTION) || (opcode == PyOpcode::CALL_FUNCTION_KW) ||
+            (opcode == PyOpcode::CALL_FUNCTION_EX) || (opcode == PyOpcode::CALL_METHOD);
+        bool is_with = (opcode == PyOpcode::SETUP_WITH) || (opcode == PyOpcode::BEFORE_ASYNC_WITH);
+        if (!is_call && !is_with) {
+          return MappedPtr<PyObject>();
+        }
+        auto is_acquire_name = [&](MappedPtr<char> name_addr) -> bool {
+          std::string name = shell.env.r.get_cstr(name_addr);
+          return is_with ? (name == "__exit__") : ((name == "acquire") || (name == "acquire_lock") || (name == "__enter__"));
+        };
+        auto slots = frame.stack_slots(shell.env);
+        for (size_t z = frame.innermost_block_level(); z < slots.size(); z++) {
+          if (!shell.env.r.obj_valid(slots[z])) {
+            continue;
+          }
+          try {
+            auto type_addr = shell.env.r.get(slots[z]).ob_type;
+            if (!method_type.is_null() && (type_addr == method_type)) {
+              const auto& method = shell.env.r.get(slots[z].cast<PyCFunctionObject>());
+              auto lock_addr = lock_for_slot(slots[z]);
+              if (!lock_addr.is_null() && is_acquire_name(shell.env.r.get(method.m_ml).ml_name)) {
+                return lock_addr;
+              }
+            } else if (is_call && !method_descr_type.is_null() && (type_addr == method_descr_type) &&
+                (z + 1 < slots.size())) {
+              const auto& descr = shell.env.r.get(slots[z].cast<PyMethodDescrObject>());
+              auto lock_addr = lock_for_slot(slots[z + 1]);
+              if (!lock_addr.is_null() && is_acquire_name(shell.env.r.get(descr.d_method).ml_name)) {
+                return lock_addr;
+              }
+            }
+          } catch (const std::out_of_range&) {
+          }
+        }
+        return MappedPtr<PyObject>();
+      };
+      auto lock_is_held_by_other = [&](MappedPtr<PyObject> lock_addr, uint64_t thread_id) -> bool {
+        if (shell.env.r.get(lock_addr).ob_type == lock_type) {
+          return shell.env.r.get(lock_addr.cast<PyThreadLockObject>()).locked;
+        }
+        const auto& rlock = shell.env.r.get(lock_addr.cast<PyThreadRLockObject>());
+        return (rlock.rlock_count > 0) && (rlock.rlock_owner != thread_id);
+      };
+
+      struct ThreadInfo {
+        MappedPtr<PyThreadState> ts_addr;
+        std::string location;
+        std::set<MappedPtr<PyObject>> blocked_on;
+        std::set<MappedPtr<PyObject>> referenced_locks;
+      };
+      std::map<uint64_t, ThreadInfo> thread_infos;
+      for (auto ts_addr : find_thread_states(shell)) {
+        const auto& ts = shell.env.r.get(ts_addr);
+        auto& info = thread_infos[ts.thread_id];
+        info.ts_addr = ts_addr;
+        info.location = ts.frame.is_null() ? "<no Python frames>" : shell.env.r.get(ts.frame).location(shell.env);
+
+        size_t depth = 0;
+        for (auto frame_addr = ts.frame; !frame_addr.is_null() && (depth < 0x1000); depth++) {
+          try {
+            const auto& frame = shell.env.r.get(frame_addr);
+            if (depth == 0) {
+              auto lock_addr = lock_being_acquired(frame);
+              if (!lock_addr.is_null() && lock_is_held_by_other(lock_addr, ts.thread_id)) {
+                info.blocked_on.emplace(lock_addr);
+              }
+            }
+            for (auto slot_addr : frame.slot_values(shell.env)) {
+              auto lock_addr = lock_for_slot(slot_addr);
+              if (!lock_addr.is_null()) {
+                info.referenced_locks.emplace(lock_addr);
+              }
+            }
+            frame_addr = frame.f_back;
+          } catch (const std::out_of_range&) {
+            break;
+          } catch (const invalid_object&) {
+            break;
+          }
+        }
+        for (auto lock_addr : info.blocked_on) {
+          info.referenced_locks.erase(lock_addr);
+        }
+      }
+
+      // Determine who holds each lock that a thread is blocked on
+      std::unordered_map<MappedPtr<PyObject>, std::set<uint64_t>> waiters_for_lock;
+      std::unordered_map<MappedPtr<PyObject>, std::set<uint64_t>> holders_for_lock;
+      for (const auto& [thread_id, info] : thread_infos) {
+        for (auto lock_addr : info.blocked_on) {
+          waiters_for_lock[lock_addr].emplace(thread_id);
+        }
+      }
+      for (const auto& [lock_addr, _] : waiters_for_lock) {
+        auto& holders = holders_for_lock[lock_addr];
+        if (shell.env.r.get(lock_addr).ob_type == rlock_type) {
+          holders.emplace(shell.env.r.get(lock_addr.cast<PyThreadRLockObject>()).rlock_owner);
+        } else if (!condition_for_waiter_lock.count(lock_addr)) {
+          for (const auto& [thread_id, info] : thread_infos) {
+            if (info.referenced_locks.count(lock_addr)) {
+              holders.emplace(thread_id);
+            }
+          }
+        }
+      }
+
+      auto t = shell.env.traverse(&args);
+      t.is_short = true;
+      auto describe_lock = [&](MappedPtr<PyObject> lock_addr) -> std::string {
+        auto cond_it = condition_for_waiter_lock.find(lock_addr);
+        if (cond_it != condition_for_waiter_lock.end()) {
+          return std::format("a notify on Condition @ {} (waiter lock @ {})", cond_it->second, lock_addr);
+        }
+        return t.repr(lock_addr);
+      };
+      auto format_thread_ids = [](const std::set<uint64_t>& thread_ids) -> std::string {
+        if (thread_ids.empty()) {
+          return "unknown threads";
+        }
+        std::string ret;
+        for (uint64_t thread_id : thread_ids) {
+          ret += ret.empty() ? "" : ", ";
+          ret += std::format("{:X}", thread_id);
+        }
+        return ret;
+      };
+
+      phosg::fwrite_fmt(stdout, "Threads:\n");
+      for (const auto& [thread_id, info] : thread_infos) {
+        phosg::fwrite_fmt(stdout, "  Thread {:X} (state @ {}) in {}\n", thread_id, info.ts_addr, info.location);
+        for (auto lock_addr : info.blocked_on) {
+          const auto& holders = holders_for_lock[lock_addr];
+          if (condition_for_waiter_lock.count(lock_addr)) {
+            phosg::fwrite_fmt(stdout, "    waiting for {}\n", describe_lock(lock_addr));
+          } else {
+            phosg::fwrite_fmt(stdout, "    blocked on {} held by {}\n", describe_lock(lock_addr), format_thread_ids(holders));
+          }
+        }
+      }
+
+      std::vector<std::pair<size_t, MappedPtr<PyObject>>> contended_locks;
+      for (const auto& [lock_addr, waiters] : waiters_for_lock) {
+        contended_locks.emplace_back(waiters.size(), lock_addr);
+      }
+      std::sort(contended_locks.begin(), contended_locks.end());
+      if (contended_locks.size() > max_results) {
+        contended_locks.erase(contended_locks.begin(), contended_locks.end() - max_results);
+      }
+      phosg::fwrite_fmt(stdout, "Most contended locks:\n");
+      for (const auto& [num_waiters, lock_addr] : contended_locks) {
+        phosg::fwrite_fmt(stdout, "  ({} waiting threads: {}) {}\n", num_waiters,
+            format_thread_ids(waiters_for_lock.at(lock_addr)), describe_lock(lock_addr));
+      }
+
+      // Find cycles in the wait-for graph with a DFS from each thread. Each cycle is reported once, starting from its
+      // lowest thread ID.
+      std::map<uint64_t, std::set<uint64_t>> waits_for_threads;
+      for (const auto& [thread_id, info] : thread_infos) {
+        for (auto lock_addr : info.blocked_on) {
+          for (uint64_t holder_id : holders_for_lock[lock_addr]) {
+            if (holder_id != thread_id) {
+              waits_for_threads[thread_id].emplace(holder_id);
+            }
+          }
+        }
+      }
+      std::set<std::vector<uint64_t>> cycles;
+      std::vector<uint64_t> path;
+      std::function<void(uint64_t)> visit = [&](uint64_t thread_id) -> void {
+        auto path_it = std::find(path.begin(), path.end(), thread_id);
+        if (path_it != path.end()) {
+          std::vector<uint64_t> cycle(path_it, path.end());
+          std::rotate(cycle.begin(), std::min_element(cycle.begin(), cycle.end()), cycle.end());
+          cycles.emplace(std::move(cycle));
+          return;
+        }
+        auto edges_it = waits_for_threads.find(thread_id);
+        if (edges_it == waits_for_threads.end()) {
+          return;
+        }
+        path.emplace_back(thread_id);
+        for (uint64_t next_id : edges_it->second) {
+          // Only start cycles at their lowest thread ID, so each is found from one starting point
+          if (next_id >= path.front()) {
+            visit(next_id);
+          }
+        }
+        path.pop_back();
+      };
+      for (const auto& [thread_id, _] : waits_for_threads) {
+        visit(thread_id);
+      }
+
+      if (cycles.empty()) {
+        phosg::fwrite_fmt(stdout, "No deadlock cycles found\n");
+      }
+      for (const auto& cycle : cycles) {
+        phosg::fwrite_fmt(stdout, "Deadlock cycle:\n");
+        for (size_t z = 0; z < cycle.size(); z++) {
+          uint64_t thread_id = cycle[z];
+          uint64_t next_id = cycle[(z + 1) % cycle.size()];
+          const auto& info = thread_infos.at(thread_id);
+          for (auto lock_addr : info.blocked_on) {
+            if (holders_for_lock[lock_addr].count(next_id)) {
+              phosg::fwrite_fmt(stdout, "  Thread {:X} in {} waits for {} held by thread {:X}\n",
+                  thread_id, info.location, describe_lock(lock_addr), next_id);
+            }
+          }
+        }
+      }
+    });
+
 ShellCommand c_find_all_stacks(
     "find-all-stacks", "\
   find-all-stacks [OPTIONS]\n\
@@ -648,6 +1120,3708 @@ ShellCommand c_aggregate_strings(
       }
     });
 
+template <bool IsBytes>
+void fn_find_duplicate_strings(AnalysisShell& shell, phosg::Arguments& args) {
+  size_t num_partitions = std::max<size_t>(args.get<size_t>("partitions", 1), 1);
+  size_t max_results = args.get<size_t>("max-results", 100);
+  size_t max_samples = args.get<size_t>("samples", 4);
+  size_t min_count = std::max<size_t>(args.get<size_t>("min-count", 2), 2);
+
+  const char* type_name = IsBytes ? "bytes" : "str";
+  auto type_addr = shell.env.get_type(type_name);
+
+  struct DuplicateGroup {
+    size_t count = 0;
+    size_t total_bytes = 0;
+    std::vector<MappedPtr<PyObject>> sample_addrs;
+  };
+  struct DuplicateGroupResult {
+    uint64_t hash;
+    size_t count;
+    size_t total_bytes;
+    size_t wasted_bytes;
+    std::vector<MappedPtr<PyObject>> sample_addrs;
+  };
+
+  // Only the groups with the most wasted bytes from each partition are kept, so that memory usage doesn't scale with
+  // the number of distinct strings when using multiple partitions
+  std::vector<DuplicateGroupResult> results;
+  size_t total_objects = 0;
+  size_t total_wasted_bytes = 0;
+  size_t total_duplicate_groups = 0;
+
+  for (size_t partition = 0; partition < num_partitions; partition++) {
+    if (num_partitions > 1) {
+      phosg::fwrite_fmt(stderr, CLEAR_LINE "Scanning partition {}/{}\n", partition + 1, num_partitions);
+    }
+
+    // Payloads are identified only by their 64-bit hashes (with the string kind mixed in for str objects). Collisions
+    // are possible but extremely unlikely at realistic heap sizes.
+    std::vector<std::unordered_map<uint64_t, DuplicateGroup>> groups_for_thread;
+    groups_for_thread.resize(shell.max_threads);
+    shell.env.r.map_all_addresses<PyObject>(
+        [&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+          if ((obj.ob_type != type_addr) || obj.invalid_reason(shell.env)) {
+            return;
+          }
+          try {
+            uint64_t hash;
+            if constexpr (IsBytes) {
+              const auto& bytes = shell.env.r.get(addr.cast<PyBytesObject>());
+              if (bytes.invalid_reason(shell.env)) {
+                return;
+              }
+              auto data_r = bytes.read_contents();
+              hash = std::hash<std::string_view>{}(std::string_view(
+                  reinterpret_cast<const char*>(data_r.getv(data_r.size())), data_r.size()));
+            } else {
+              const auto& str = shell.env.r.get(addr.cast<PyASCIIStringObject>());
+              if (str.invalid_reason(shell.env)) {
+                return;
+              }
+              auto data_r = read_string_data(shell.env.r, addr);
+              hash = std::hash<std::string_view>{}(std::string_view(
+                  reinterpret_cast<const char*>(data_r.getv(data_r.size())), data_r.size()));
+              hash ^= static_cast<uint64_t>(str.is_ascii() ? 1 : str.char_kind()) * 0x9E3779B97F4A7C15;
+            }
+            if ((hash % num_partitions) != partition) {
+              return;
+            }
+
+            auto& group = groups_for_thread[thread_index][hash];
+            group.count++;
+            group.total_bytes += shell.env.shallow_size(addr);
+            if (group.sample_addrs.size() < max_samples) {
+              group.sample_addrs.emplace_back(addr);
+            }
+          } catch (const std::out_of_range&) {
+          } catch (const invalid_object&) {
+          }
+        },
+        8, shell.max_threads);
+    phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+    auto& merged_groups = groups_for_thread[0];
+    for (size_t z = 1; z < groups_for_thread.size(); z++) {
+      for (auto& [hash, group] : groups_for_thread[z]) {
+        auto& merged_group = merged_groups[hash];
+        merged_group.count += group.count;
+        merged_group.total_bytes += group.total_bytes;
+        for (auto sample_addr : group.sample_addrs) {
+          if (merged_group.sample_addrs.size() < max_samples) {
+            merged_group.sample_addrs.emplace_back(sample_addr);
+          }
+        }
+      }
+      groups_for_thread[z].clear();
+    }
+
+    for (auto& [hash, group] : merged_groups) {
+      total_objects += group.count;
+      if (group.count < min_count) {
+        continue;
+      }
+      // All copies have the same size, except for cached UTF-8 or wchar_t representations on some of them
+      size_t wasted_bytes = group.total_bytes - (group.total_bytes / group.count);
+      total_wasted_bytes += wasted_bytes;
+      total_duplicate_groups++;
+      results.emplace_back(DuplicateGroupResult{
+          .hash = hash,
+          .count = group.count,
+          .total_bytes = group.total_bytes,
+          .wasted_bytes = wasted_bytes,
+          .sample_addrs = std::move(group.sample_addrs),
+      });
+    }
+    std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) -> bool {
+      return a.wasted_bytes > b.wasted_bytes;
+    });
+    if (results.size() > max_results) {
+      results.resize(max_results);
+    }
+  }
+
+  // Print the largest groups last, so they're closest to the prompt
+  for (auto it = results.rbegin(); it != results.rend(); it++) {
+    auto t = shell.env.traverse(&args);
+    std::vector<std::string> sample_strs;
+    for (auto sample_addr : it->sample_addrs) {
+      sample_strs.emplace_back(std::format("@{}", sample_addr));
+    }
+    phosg::fwrite_fmt(stdout, "({} copies) {} wasted of {}: {}\n  samples: {}\n",
+        it->count, phosg::format_size(it->wasted_bytes), phosg::format_size(it->total_bytes),
+        t.repr(it->sample_addrs.at(0)), phosg::join(sample_strs, " "));
+  }
+  phosg::fwrite_fmt(stdout, "Found {} {} objects; {} duplicate groups waste {} ({} bytes) overall\n",
+      total_objects, type_name, total_duplicate_groups, phosg::format_size(total_wasted_bytes), total_wasted_bytes);
+}
+
+ShellCommand c_find_duplicate_strings(
+    "find-duplicate-strings", "\
+  find-duplicate-strings [OPTIONS]\n\
+    Finds all str objects with the same contents as other str objects, and\n\
+    shows the groups of identical strings that waste the most memory (that is,\n\
+    that would save the most memory if they were interned or cached). Options:\n\
+      --bytes: Find duplicate bytes objects instead of strings.\n\
+      --max-results=N: Show this many groups (default 100).\n\
+      --samples=N: Show this many object addresses for each group (default 4).\n\
+      --min-count=N: Only show groups with at least N copies (default 2).\n\
+      --partitions=N: Split the hash space into N partitions and scan the\n\
+          snapshot once for each. This uses less memory when there are very\n\
+          many distinct strings, at the cost of taking N times as long.\n\
+    The formatting options to the repr command are also valid here.\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      if (args.get<bool>("bytes")) {
+        fn_find_duplicate_strings<true>(shell, args);
+      } else {
+        fn_find_duplicate_strings<false>(shell, args);
+      }
+    });
+
+template <bool IsBytes>
+void fn_aggregate_string_prefixes(AnalysisShell& shell, phosg::Arguments& args) {
+  size_t max_prefix_length = args.get<size_t>("max-prefix-length", 64);
+  size_t max_results = args.get<size_t>("max-results", 50);
+  size_t min_count = args.get<size_t>("min-count", 2);
+  size_t max_entries = args.get<size_t>("max-entries", 0x100000);
+  bool sort_by_count = args.get<bool>("sort-by-count");
+  std::string delimiters = args.get<std::string>("delimiters", false);
+  if (delimiters.empty()) {
+    delimiters = "/:. _-=?&,;#|@\\";
+  }
+
+  const char* type_name = IsBytes ? "bytes" : "str";
+  auto type_addr = shell.env.get_type(type_name);
+
+  struct PrefixStats {
+    size_t count = 0;
+    size_t bytes = 0;
+    size_t max_error = 0;
+  };
+  struct ThreadState {
+    std::unordered_map<std::string, PrefixStats> stats_for_prefix;
+    size_t num_insertions = 0;
+    size_t epoch = 1;
+  };
+  std::vector<ThreadState> thread_states;
+  thread_states.resize(shell.max_threads);
+
+  shell.env.r.map_all_addresses<PyObject>([&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+    if ((obj.ob_type != type_addr) || obj.invalid_reason(shell.env)) {
+      return;
+    }
+
+    std::string data;
+    size_t object_size;
+    try {
+      if constexpr (IsBytes) {
+        const auto& bytes = shell.env.r.get(addr.cast<PyBytesObject>());
+        if (bytes.invalid_reason(shell.env)) {
+          return;
+        }
+        auto data_r = bytes.read_contents();
+        data = data_r.read(std::min<size_t>(data_r.size(), max_prefix_length));
+      } else {
+        if (shell.env.r.get(addr.cast<PyASCIIStringObject>()).invalid_reason(shell.env)) {
+          return;
+        }
+        data = decode_string_types(shell.env.r, addr, max_prefix_length);
+        if (data.size() > max_prefix_length) {
+          data.resize(max_prefix_length);
+        }
+      }
+      object_size = shell.env.shallow_size(addr);
+    } catch (const std::exception&) {
+      return;
+    }
+
+    // Every prefix that ends just after a delimiter is a node in the trie, as is the (possibly truncated) string itself
+    auto& state = thread_states[thread_index];
+    for (size_t z = 1; z <= data.size(); z++) {
+      if ((z == data.size()) || (delimiters.find(data[z - 1]) != std::string::npos)) {
+        auto [stats_it, inserted] = state.stats_for_prefix.try_emplace(data.substr(0, z));
+        if (inserted) {
+          stats_it->second.max_error = state.epoch - 1;
+        }
+        stats_it->second.count++;
+        stats_it->second.bytes += object_size;
+
+        // Keep the trie bounded with lossy counting: every max_entries insertions, start a new epoch and discard
+        // prefixes whose count (plus the number of occurrences they may have missed before being inserted) is no
+        // greater than the epoch number. A prefix's count is then underestimated by at most the number of insertions
+        // divided by max_entries, and any prefix more frequent than that is never discarded.
+        if (++state.num_insertions >= max_entries) {
+          std::erase_if(state.stats_for_prefix, [&](const auto& it) -> bool {
+            return it.second.count + it.second.max_error <= state.epoch;
+          });
+          state.num_insertions = 0;
+          state.epoch++;
+        }
+      }
+    }
+  },
+      8, shell.max_threads);
+  phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+  auto& stats_for_prefix = thread_states[0].stats_for_prefix;
+  for (size_t z = 1; z < thread_states.size(); z++) {
+    for (const auto& [prefix, stats] : thread_states[z].stats_for_prefix) {
+      auto& merged_stats = stats_for_prefix[prefix];
+      merged_stats.count += stats.count;
+      merged_stats.bytes += stats.bytes;
+    }
+    thread_states[z].stats_for_prefix.clear();
+  }
+
+  // A prefix is redundant if one of its extensions accounts for nearly all of its strings; in that case, we only show
+  // the longer (more informative) prefix
+  std::unordered_set<std::string> redundant_prefixes;
+  for (const auto& [prefix, stats] : stats_for_prefix) {
+    for (size_t z = prefix.size() - 1; z > 0; z--) {
+      if (delimiters.find(prefix[z - 1]) == std::string::npos) {
+        continue;
+      }
+      auto parent_it = stats_for_prefix.find(prefix.substr(0, z));
+      if (parent_it != stats_for_prefix.end()) {
+        if (stats.count * 10 >= parent_it->second.count * 9) {
+          redundant_prefixes.emplace(parent_it->first);
+        }
+        break;
+      }
+    }
+  }
+
+  std::vector<std::pair<const std::string*, const PrefixStats*>> entries;
+  for (const auto& [prefix, stats] : stats_for_prefix) {
+    if ((stats.count >= min_count) && !redundant_prefixes.count(prefix)) {
+      entries.emplace_back(&prefix, &stats);
+    }
+  }
+  std::sort(entries.begin(), entries.end(), [&](const auto& a, const auto& b) -> bool {
+    return sort_by_count ? (a.second->count > b.second->count) : (a.second->bytes > b.second->bytes);
+  });
+  if (entries.size() > max_results) {
+    entries.resize(max_results);
+  }
+
+  for (auto it = entries.rbegin(); it != entries.rend(); it++) {
+    phosg::fwrite_fmt(stdout, "{}...: {} objects, {}\n",
+        escape_string(phosg::StringReader(*it->first), !IsBytes), it->second->count, phosg::format_size(it->second->bytes));
+  }
+  phosg::fwrite_fmt(stderr, "{} distinct prefixes found\n", stats_for_prefix.size());
+}
+
+ShellCommand c_aggregate_string_prefixes(
+    "aggregate-string-prefixes", "\
+  aggregate-string-prefixes [OPTIONS]\n\
+    Finds all strings and groups them by common prefixes, showing the prefixes\n\
+    that account for the most objects or bytes. Prefixes are split after\n\
+    delimiter characters, so strings like URLs, cache keys, and log lines are\n\
+    grouped by their meaningful parts. When a prefix\'s strings almost all\n\
+    share a longer prefix, only the longer prefix is shown. Options:\n\
+      --bytes: Aggregate over bytes objects instead of strings.\n\
+      --sort-by-count: Rank prefixes by object count instead of total size.\n\
+      --max-results=N: Show this many prefixes (default 50).\n\
+      --min-count=N: Only show prefixes shared by at least N objects\n\
+          (default 2).\n\
+      --max-prefix-length=N: Only look at the first N characters of each\n\
+          string (default 64).\n\
+      --delimiters=CHARS: Split prefixes after these characters (default\n\
+          \"/:. _-=?&,;#|@\\\").\n\
+      --max-entries=N: Discard infrequent prefixes once every N prefix\n\
+          insertions in each thread (default 1048576), using lossy counting.\n\
+          This bounds memory usage; each prefix's count may be underestimated\n\
+          by at most the number of insertions divided by N.\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      if (args.get<bool>("bytes")) {
+        fn_aggregate_string_prefixes<true>(shell, args);
+      } else {
+        fn_aggregate_string_prefixes<false>(shell, args);
+      }
+    });
+
+ShellCommand c_string_representations(
+    "string-representations", "\
+  string-representations [OPTIONS]\n\
+    Counts the memory used by cached secondary representations of str objects:\n\
+    the UTF-8 copy created by PyUnicode_AsUTF8 and similar functions, and the\n\
+    wchar_t copy created by the legacy Py_UNICODE APIs. Results are grouped by\n\
+    string kind and by length (in code points). Only object headers are read,\n\
+    so this is about as fast as count-by-type. Options:\n\
+      --all: Show all groups, not only those with cached representations.\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      bool show_all = args.get<bool>("all");
+
+      struct GroupStats {
+        size_t count = 0;
+        size_t object_bytes = 0;
+        size_t num_utf8 = 0;
+        size_t utf8_bytes = 0;
+        size_t num_wstr = 0;
+        size_t wstr_bytes = 0;
+
+        void merge(const GroupStats& other) {
+          this->count += other.count;
+          this->object_bytes += other.object_bytes;
+          this->num_utf8 += other.num_utf8;
+          this->utf8_bytes += other.utf8_bytes;
+          this->num_wstr += other.num_wstr;
+          this->wstr_bytes += other.wstr_bytes;
+        }
+      };
+      // Kinds are 0 = ASCII, 1 = UCS1 (Latin-1), 2 = UCS2, 3 = UCS4, 4 = legacy (not compact); length buckets are as
+      // in hash-quality (bucket N contains lengths in [2^(N-1), 2^N), and bucket 0 is the empty string)
+      static const std::array<const char*, 5> kind_names = {"ascii", "latin1", "ucs2", "ucs4", "legacy"};
+      static constexpr size_t NUM_LENGTH_BUCKETS = 65;
+      using GroupTable = std::array<std::array<GroupStats, NUM_LENGTH_BUCKETS>, 5>;
+
+      auto str_type = shell.env.get_type("str");
+      std::vector<GroupTable> thread_tables;
+      thread_tables.resize(shell.max_threads);
+      shell.env.r.map_all_addresses<PyObject>(
+          [&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+            if ((obj.ob_type != str_type) || shell.env.invalid_reason(addr)) {
+              return;
+            }
+            try {
+              const auto& str = shell.env.r.get(addr.cast<PyASCIIStringObject>());
+              size_t kind_index;
+              if (!str.is_compact()) {
+                kind_index = 4;
+              } else if (str.is_ascii()) {
+                kind_index = 0;
+              } else if (str.char_kind() == 1) {
+                kind_index = 1;
+              } else if (str.char_kind() == 2) {
+                kind_index = 2;
+              } else if (str.char_kind() == 4) {
+                kind_index = 3;
+              } else {
+                return;
+              }
+              auto sizes = get_string_representation_sizes(shell.env.r, addr);
+              auto& stats = thread_tables[thread_index][kind_index][std::bit_width(str.length)];
+              stats.count++;
+              stats.object_bytes += sizes.object_bytes;
+              if (sizes.utf8_bytes) {
+                stats.num_utf8++;
+                stats.utf8_bytes += sizes.utf8_bytes;
+              }
+              if (sizes.wstr_bytes) {
+                stats.num_wstr++;
+                stats.wstr_bytes += sizes.wstr_bytes;
+              }
+            } catch (const std::out_of_range&) {
+            }
+          },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+      GroupTable table;
+      for (const auto& thread_table : thread_tables) {
+        for (size_t kind_index = 0; kind_index < table.size(); kind_index++) {
+          for (size_t bucket = 0; bucket < NUM_LENGTH_BUCKETS; bucket++) {
+            table[kind_index][bucket].merge(thread_table[kind_index][bucket]);
+          }
+        }
+      }
+
+      auto format_stats = [](const GroupStats& stats) -> std::string {
+        return std::format("{} objects, {} in objects, {} UTF-8 caches ({}), {} wchar_t caches ({})",
+            stats.count, phosg::format_size(stats.object_bytes), stats.num_utf8, phosg::format_size(stats.utf8_bytes),
+            stats.num_wstr, phosg::format_size(stats.wstr_bytes));
+      };
+
+      GroupStats total_stats;
+      for (size_t kind_index = 0; kind_index < table.size(); kind_index++) {
+        GroupStats kind_stats;
+        for (const auto& stats : table[kind_index]) {
+          kind_stats.merge(stats);
+        }
+        total_stats.merge(kind_stats);
+        if (!show_all && !kind_stats.num_utf8 && !kind_stats.num_wstr) {
+          continue;
+        }
+        phosg::fwrite_fmt(stdout, "{}: {}\n", kind_names[kind_index], format_stats(kind_stats));
+        for (size_t bucket = 0; bucket < NUM_LENGTH_BUCKETS; bucket++) {
+          const auto& stats = table[kind_index][bucket];
+          if (!stats.count || (!show_all && !stats.num_utf8 && !stats.num_wstr)) {
+            continue;
+          }
+          if (bucket == 0) {
+            phosg::fwrite_fmt(stdout, "  length 0: {}\n", format_stats(stats));
+          } else {
+            phosg::fwrite_fmt(stdout, "  length {}-{}: {}\n",
+                1ULL << (bucket - 1), (bucket == 64) ? UINT64_MAX : ((1ULL << bucket) - 1), format_stats(stats));
+          }
+        }
+      }
+      phosg::fwrite_fmt(stdout, "Overall: {}\n", format_stats(total_stats));
+    });
+
+ShellCommand c_dict_shapes(
+    "dict-shapes", "\
+  dict-shapes [OPTIONS]\n\
+    Finds all dicts and groups them by their sets of keys, showing the most\n\
+    common shapes. This is useful for finding families of similar dicts (e.g.\n\
+    parsed JSON objects) that are responsible for a lot of memory usage. Keys\n\
+    are compared by hash, so dicts with the same keys in different orders have\n\
+    the same shape. Options:\n\
+      --max-keys=N: Ignore dicts with more than N keys (default 64).\n\
+      --max-results=N: Show this many shapes (default 30).\n\
+      --samples=N: Show this many dict addresses for each shape (default 4).\n\
+      --sort-by-count: Rank shapes by dict count instead of total size.\n\
+      --retained: Also compute the memory retained by each dict. This is\n\
+          much slower.\n\
+    The formatting options to the repr command are also valid here.\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t max_keys = args.get<size_t>("max-keys", 64);
+      size_t max_results = args.get<size_t>("max-results", 30);
+      size_t max_samples = args.get<size_t>("samples", 4);
+      bool sort_by_count = args.get<bool>("sort-by-count");
+      bool compute_retained = args.get<bool>("retained");
+      auto dict_type = shell.env.get_type("dict");
+
+      struct ShapeStats {
+        size_t num_keys = 0;
+        size_t count = 0;
+        size_t bytes = 0;
+        size_t retained_bytes = 0;
+        std::vector<MappedPtr<PyDictObject>> sample_addrs;
+      };
+      std::vector<std::unordered_map<uint64_t, ShapeStats>> stats_for_shape;
+      stats_for_shape.resize(shell.max_threads);
+      std::atomic<size_t> num_skipped_dicts = 0;
+
+      shell.env.r.map_all_addresses<PyDictObject>(
+          [&](const PyDictObject& dict, MappedPtr<PyDictObject> addr, size_t thread_index) -> void {
+            if ((dict.ob_type != dict_type) || dict.invalid_reason(shell.env)) {
+              return;
+            }
+            if (static_cast<uint64_t>(dict.ma_used) > max_keys) {
+              num_skipped_dicts++;
+              return;
+            }
+            try {
+              // The stored hash of each key (me_hash) is already a content hash, so we don't need to read the keys
+              // themselves. Combining them by addition makes the fingerprint independent of insertion order.
+              uint64_t fingerprint = mix_hash(dict.ma_used);
+              dict.for_each_entry(shell.env.r, [&](const PyDictKeyEntry& entry, MappedPtr<PyObject>) -> void {
+                fingerprint += mix_hash(entry.me_hash);
+              });
+
+              auto& stats = stats_for_shape[thread_index][fingerprint];
+              stats.num_keys = dict.ma_used;
+              stats.count++;
+              stats.bytes += shell.env.shallow_size(addr);
+              if (compute_retained) {
+                stats.retained_bytes += shell.env.retained_size(addr);
+              }
+              if (stats.sample_addrs.size() < max_samples) {
+                stats.sample_addrs.emplace_back(addr);
+              }
+            } catch (const std::out_of_range&) {
+            }
+          },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+      auto& merged_stats_for_shape = stats_for_shape[0];
+      for (size_t z = 1; z < stats_for_shape.size(); z++) {
+        for (auto& [fingerprint, stats] : stats_for_shape[z]) {
+          auto& merged_stats = merged_stats_for_shape[fingerprint];
+          merged_stats.num_keys = stats.num_keys;
+          merged_stats.count += stats.count;
+          merged_stats.bytes += stats.bytes;
+          merged_stats.retained_bytes += stats.retained_bytes;
+          for (auto sample_addr : stats.sample_addrs) {
+            if (merged_stats.sample_addrs.size() < max_samples) {
+              merged_stats.sample_addrs.emplace_back(sample_addr);
+            }
+          }
+        }
+        stats_for_shape[z].clear();
+      }
+
+      std::vector<const ShapeStats*> entries;
+      for (const auto& [fingerprint, stats] : merged_stats_for_shape) {
+        entries.emplace_back(&stats);
+      }
+      std::sort(entries.begin(), entries.end(), [&](const ShapeStats* a, const ShapeStats* b) -> bool {
+        if (sort_by_count) {
+          return a->count > b->count;
+        }
+        return compute_retained ? (a->retained_bytes > b->retained_bytes) : (a->bytes > b->bytes);
+      });
+      if (entries.size() > max_results) {
+        entries.resize(max_results);
+      }
+
+      for (auto it = entries.rbegin(); it != entries.rend(); it++) {
+        const auto* stats = *it;
+        std::vector<std::string> key_strs;
+        try {
+          auto t = shell.env.traverse(&args);
+          t.max_recursion_depth = 0;
+          shell.env.r.get(stats->sample_addrs.at(0)).for_each_entry(shell.env.r,
+              [&](const PyDictKeyEntry& entry, MappedPtr<PyObject>) -> void {
+                key_strs.emplace_back(t.repr(entry.me_key));
+              });
+        } catch (const std::out_of_range&) {
+          key_strs.emplace_back("<!keys_unreadable>");
+        }
+        std::sort(key_strs.begin(), key_strs.end());
+        std::vector<std::string> sample_strs;
+        for (auto sample_addr : stats->sample_addrs) {
+          sample_strs.emplace_back(std::format("@{}", sample_addr));
+        }
+        std::string size_str = phosg::format_size(stats->bytes);
+        if (compute_retained) {
+          size_str += std::format(" ({} retained)", phosg::format_size(stats->retained_bytes));
+        }
+        phosg::fwrite_fmt(stdout, "({} dicts) {}: {} keys {{{}}}\n  samples: {}\n",
+            stats->count, size_str, stats->num_keys, phosg::join(key_strs, ", "), phosg::join(sample_strs, " "));
+      }
+      phosg::fwrite_fmt(stderr, "{} distinct shapes found; {} dicts with more than {} keys skipped\n",
+          merged_stats_for_shape.size(), num_skipped_dicts.load(), max_keys);
+    });
+
+ShellCommand c_attribute_breakdown(
+    "attribute-breakdown", "\
+  attribute-breakdown [OPTIONS]\n\
+    Finds all instances of Python-defined classes and aggregates the contents\n\
+    of their __dict__s by class and attribute name, showing the types of the\n\
+    values and how much memory they use. Shallow sizes count each value once\n\
+    per instance that refers to it; retained sizes only count values (and\n\
+    their referents, recursively) that have no other references. Options:\n\
+      --type-name=NAME: Only look at instances of this class.\n\
+      --min-instances=N: Only show classes with at least N instances.\n\
+      --skip-retained: Don\'t compute retained sizes (this is much faster).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      MappedPtr<PyTypeObject> filter_type_addr;
+      const auto& filter_type_name = args.get<std::string>("type-name", false);
+      if (!filter_type_name.empty()) {
+        filter_type_addr = shell.env.get_type(filter_type_name.c_str());
+      }
+      size_t min_instances = args.get<size_t>("min-instances", 1);
+      bool skip_retained = args.get<bool>("skip-retained");
+
+      struct AttributeStats {
+        size_t count = 0;
+        size_t shallow_bytes = 0;
+        size_t retained_bytes = 0;
+        std::unordered_map<MappedPtr<PyTypeObject>, size_t> count_for_value_type;
+
+        void merge(const AttributeStats& other) {
+          this->count += other.count;
+          this->shallow_bytes += other.shallow_bytes;
+          this->retained_bytes += other.retained_bytes;
+          for (const auto& [type_addr, count] : other.count_for_value_type) {
+            this->count_for_value_type[type_addr] += count;
+          }
+        }
+      };
+      struct ClassStats {
+        size_t instance_count = 0;
+        size_t instance_bytes = 0; // Includes the instances' __dict__ objects
+        // Keyed by the address of the key object, since most attribute names are interned
+        std::unordered_map<MappedPtr<PyObject>, AttributeStats> stats_for_key;
+      };
+
+      auto name_for_type = names_for_types(shell.env);
+      std::vector<std::unordered_map<MappedPtr<PyTypeObject>, ClassStats>> stats_for_class;
+      stats_for_class.resize(shell.max_threads);
+
+      shell.env.r.map_all_addresses<PyObject>(
+          [&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+            if (filter_type_addr.is_null() ? !name_for_type.count(obj.ob_type) : (obj.ob_type != filter_type_addr)) {
+              return;
+            }
+            try {
+              auto dict_addr = heap_instance_dict(shell.env, obj, addr);
+              if (dict_addr.is_null()) {
+                return;
+              }
+              const auto& dict = shell.env.r.get(dict_addr);
+
+              auto& class_stats = stats_for_class[thread_index][obj.ob_type];
+              class_stats.instance_count++;
+              class_stats.instance_bytes += shell.env.shallow_size(addr) + shell.env.shallow_size(dict_addr);
+              for (const auto& [key_addr, value_addr] : dict.get_items(shell.env.r)) {
+                const auto& value = shell.env.r.get(value_addr);
+                auto& attr_stats = class_stats.stats_for_key[key_addr];
+                attr_stats.count++;
+                attr_stats.count_for_value_type[value.ob_type]++;
+                if (!shell.env.invalid_reason(value_addr)) {
+                  attr_stats.shallow_bytes += shell.env.shallow_size(value_addr);
+                  if (!skip_retained && (value.ob_refcnt == 1)) {
+                    attr_stats.retained_bytes += shell.env.retained_size(value_addr);
+                  }
+                }
+              }
+            } catch (const std::out_of_range&) {
+            } catch (const invalid_object&) {
+            }
+          },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+      // Merge the per-thread results, combining attributes with the same name but different key objects
+      struct MergedClassStats {
+        size_t instance_count = 0;
+        size_t instance_bytes = 0;
+        size_t retained_bytes = 0;
+        std::map<std::string, AttributeStats> stats_for_attr;
+      };
+      std::unordered_map<MappedPtr<PyTypeObject>, MergedClassStats> merged_stats_for_class;
+      for (const auto& thread_stats_for_class : stats_for_class) {
+        for (const auto& [type_addr, class_stats] : thread_stats_for_class) {
+          auto& merged = merged_stats_for_class[type_addr];
+          merged.instance_count += class_stats.instance_count;
+          merged.instance_bytes += class_stats.instance_bytes;
+          for (const auto& [key_addr, attr_stats] : class_stats.stats_for_key) {
+            merged.stats_for_attr[attribute_name(shell.env, key_addr)].merge(attr_stats);
+            merged.retained_bytes += attr_stats.retained_bytes;
+          }
+        }
+      }
+
+      std::vector<std::pair<MappedPtr<PyTypeObject>, const MergedClassStats*>> sorted_classes;
+      for (const auto& [type_addr, merged] : merged_stats_for_class) {
+        if (merged.instance_count >= min_instances) {
+          sorted_classes.emplace_back(type_addr, &merged);
+        }
+      }
+      std::sort(sorted_classes.begin(), sorted_classes.end(), [](const auto& a, const auto& b) -> bool {
+        return (a.second->instance_bytes + a.second->retained_bytes) < (b.second->instance_bytes + b.second->retained_bytes);
+      });
+
+      for (const auto& [type_addr, merged] : sorted_classes) {
+        phosg::fwrite_fmt(stdout, "{} @ {}: {} instances, {} in instances and dicts, {} retained by attributes\n",
+            name_for_type.at(type_addr), type_addr, merged->instance_count, phosg::format_size(merged->instance_bytes),
+            phosg::format_size(merged->retained_bytes));
+
+        std::vector<std::pair<std::string, const AttributeStats*>> sorted_attrs;
+        for (const auto& [attr_name, attr_stats] : merged->stats_for_attr) {
+          sorted_attrs.emplace_back(attr_name, &attr_stats);
+        }
+        std::sort(sorted_attrs.begin(), sorted_attrs.end(), [](const auto& a, const auto& b) -> bool {
+          return (a.second->retained_bytes != b.second->retained_bytes)
+              ? (a.second->retained_bytes > b.second->retained_bytes)
+              : (a.second->shallow_bytes > b.second->shallow_bytes);
+        });
+        for (const auto& [attr_name, attr_stats] : sorted_attrs) {
+          std::vector<std::pair<size_t, std::string>> value_types;
+          for (const auto& [value_type_addr, count] : attr_stats->count_for_value_type) {
+            auto name_it = name_for_type.find(value_type_addr);
+            value_types.emplace_back(count,
+                (name_it == name_for_type.end()) ? std::format("@{}", value_type_addr) : name_it->second);
+          }
+          std::sort(value_types.rbegin(), value_types.rend());
+          std::vector<std::string> value_type_strs;
+          for (const auto& [count, name] : value_types) {
+            value_type_strs.emplace_back(std::format("{} ({})", name, count));
+          }
+          phosg::fwrite_fmt(stdout, "  .{}: {} instances; {} shallow, {} retained; {}\n",
+              attr_name, attr_stats->count, phosg::format_size(attr_stats->shallow_bytes),
+              phosg::format_size(attr_stats->retained_bytes), phosg::join(value_type_strs, ", "));
+        }
+      }
+      phosg::fwrite_fmt(stderr, "{} classes found\n", sorted_classes.size());
+    });
+
+ShellCommand c_dict_key_sharing(
+    "dict-key-sharing", "\
+  dict-key-sharing [OPTIONS]\n\
+    Finds all instances of Python-defined classes and, for each class, counts\n\
+    how many instances have split (key-sharing) __dict__s and how many have\n\
+    combined __dict__s with their own keys tables. Instances lose key sharing\n\
+    when attributes are added in a different order than in the first instance,\n\
+    or outside of __init__. Also estimates how much memory would be saved by\n\
+    restoring key sharing for all instances, or by using __slots__ instead of\n\
+    __dict__ (assuming one slot per distinct attribute name). Options:\n\
+      --min-instances=N: Only show classes with at least N instances\n\
+          (default 1).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t min_instances = args.get<size_t>("min-instances", 1);
+
+      struct ClassStats {
+        size_t split_count = 0;
+        size_t combined_count = 0;
+        size_t dict_bytes = 0;
+        size_t private_keys_bytes = 0;
+        size_t sharing_savings_bytes = 0;
+        std::unordered_set<uint64_t> attr_hashes;
+
+        void merge(const ClassStats& other) {
+          this->split_count += other.split_count;
+          this->combined_count += other.combined_count;
+          this->dict_bytes += other.dict_bytes;
+          this->private_keys_bytes += other.private_keys_bytes;
+          this->sharing_savings_bytes += other.sharing_savings_bytes;
+          this->attr_hashes.insert(other.attr_hashes.begin(), other.attr_hashes.end());
+        }
+      };
+
+      auto name_for_type = names_for_types(shell.env);
+      std::vector<std::unordered_map<MappedPtr<PyTypeObject>, ClassStats>> stats_for_class;
+      stats_for_class.resize(shell.max_threads);
+
+      shell.env.r.map_all_addresses<PyObject>(
+          [&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+            if (!name_for_type.count(obj.ob_type)) {
+              return;
+            }
+            try {
+              auto dict_addr = heap_instance_dict(shell.env, obj, addr);
+              if (dict_addr.is_null()) {
+                return;
+              }
+              const auto& dict = shell.env.r.get(dict_addr);
+              const auto& keys = shell.env.r.get(dict.ma_keys);
+
+              auto& stats = stats_for_class[thread_index][obj.ob_type];
+              stats.dict_bytes += shell.env.shallow_size(dict_addr);
+              if (!dict.ma_values.is_null()) {
+                stats.split_count++;
+              } else {
+                stats.combined_count++;
+                if (keys.dk_refcnt == 1) {
+                  // With a shared keys table, this dict would only need a values array instead of its own keys table
+                  size_t keys_bytes = keys.allocated_size();
+                  size_t values_bytes = keys.usable_fraction() * sizeof(MappedPtr<PyObject>);
+                  stats.private_keys_bytes += keys_bytes;
+                  stats.sharing_savings_bytes += (keys_bytes > values_bytes) ? (keys_bytes - values_bytes) : 0;
+                }
+              }
+              dict.for_each_entry(shell.env.r, [&](const PyDictKeyEntry& entry, MappedPtr<PyObject>) -> void {
+                stats.attr_hashes.emplace(entry.me_hash);
+              });
+            } catch (const std::out_of_range&) {
+            }
+          },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+      std::unordered_map<MappedPtr<PyTypeObject>, ClassStats> merged_stats_for_class;
+      for (const auto& thread_stats_for_class : stats_for_class) {
+        for (const auto& [type_addr, stats] : thread_stats_for_class) {
+          merged_stats_for_class[type_addr].merge(stats);
+        }
+      }
+
+      struct Entry {
+        MappedPtr<PyTypeObject> type_addr;
+        const ClassStats* stats;
+        size_t slots_savings_bytes;
+      };
+      std::vector<Entry> entries;
+      size_t total_sharing_savings_bytes = 0;
+      size_t total_slots_savings_bytes = 0;
+      for (const auto& [type_addr, stats] : merged_stats_for_class) {
+        size_t instance_count = stats.split_count + stats.combined_count;
+        if (instance_count < min_instances) {
+          continue;
+        }
+        // With __slots__, each instance would have one pointer per attribute instead of a dict (the dict pointer in
+        // the instance would also go away, but the weakref pointer typically stays, so we ignore both)
+        size_t slots_bytes = instance_count * stats.attr_hashes.size() * sizeof(MappedPtr<PyObject>);
+        size_t slots_savings_bytes = (stats.dict_bytes > slots_bytes) ? (stats.dict_bytes - slots_bytes) : 0;
+        entries.emplace_back(Entry{type_addr, &stats, slots_savings_bytes});
+        total_sharing_savings_bytes += stats.sharing_savings_bytes;
+        total_slots_savings_bytes += slots_savings_bytes;
+      }
+      std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) -> bool {
+        return (a.stats->sharing_savings_bytes != b.stats->sharing_savings_bytes)
+            ? (a.stats->sharing_savings_bytes < b.stats->sharing_savings_bytes)
+            : (a.slots_savings_bytes < b.slots_savings_bytes);
+      });
+
+      for (const auto& e : entries) {
+        phosg::fwrite_fmt(stdout, "{} @ {}: {} instances ({} split, {} combined), {} in dicts ({} in per-instance keys tables); sharing would save {}; __slots__ ({} attributes) would save {}\n",
+            name_for_type.at(e.type_addr), e.type_addr, e.stats->split_count + e.stats->combined_count,
+            e.stats->split_count, e.stats->combined_count, phosg::format_size(e.stats->dict_bytes),
+            phosg::format_size(e.stats->private_keys_bytes), phosg::format_size(e.stats->sharing_savings_bytes),
+            e.stats->attr_hashes.size(), phosg::format_size(e.slots_savings_bytes));
+      }
+      phosg::fwrite_fmt(stdout, "{} classes; restoring key sharing would save {}; __slots__ would save {}\n",
+          entries.size(), phosg::format_size(total_sharing_savings_bytes), phosg::format_size(total_slots_savings_bytes));
+    });
+
+// Aggregates the results of measuring containers during a parallel scan in three ways: by container type, by the
+// attribute of a Python-defined class that holds the container (Class.attr, or Class.__dict__ for instance dicts
+// themselves), and as a list of the individual containers with the highest scores. StatsT accumulates ResultTs; it
+// must have a count field and add(const ResultT&), merge(const StatsT&), and score() methods.
+template <typename StatsT, typename ResultT>
+struct ContainerReport {
+  struct TopEntry {
+    size_t score;
+    MappedPtr<PyObject> addr;
+    ResultT result;
+
+    bool operator<(const TopEntry& other) const {
+      return this->score < other.score;
+    }
+    bool operator>(const TopEntry& other) const {
+      return this->score > other.score;
+    }
+  };
+  struct ThreadState {
+    std::unordered_map<MappedPtr<PyTypeObject>, StatsT> stats_for_type;
+    // Keyed by (class, attribute name key object); a null key means the instance's __dict__ itself
+    std::map<std::pair<MappedPtr<PyTypeObject>, MappedPtr<PyObject>>, StatsT> stats_for_owner;
+    std::priority_queue<TopEntry, std::vector<TopEntry>, std::greater<TopEntry>> top_containers;
+  };
+
+  const Environment& env;
+  const std::unordered_map<MappedPtr<PyTypeObject>, std::string>& name_for_type;
+  size_t max_results;
+  std::vector<ThreadState> thread_states;
+  // These are only populated by merge()
+  std::unordered_map<MappedPtr<PyTypeObject>, StatsT> stats_for_type;
+  std::map<std::string, StatsT> stats_for_owner;
+  std::vector<TopEntry> top_containers;
+
+  ContainerReport(const Environment& env, const std::unordered_map<MappedPtr<PyTypeObject>, std::string>& name_for_type,
+      size_t max_results, size_t num_threads)
+      : env(env),
+        name_for_type(name_for_type),
+        max_results(max_results),
+        thread_states(num_threads) {}
+
+  // Records a measured container. Containers with a score of zero aren't considered for the top list.
+  void add_container(
+      size_t thread_index, MappedPtr<PyTypeObject> type, MappedPtr<PyObject> addr, const ResultT& result, size_t score) {
+    auto& state = this->thread_states[thread_index];
+    state.stats_for_type[type].add(result);
+    if (score > 0) {
+      state.top_containers.emplace(TopEntry{.score = score, .addr = addr, .result = result});
+      if (state.top_containers.size() > this->max_results) {
+        state.top_containers.pop();
+      }
+    }
+  }
+
+  // If the object is an instance of a Python-defined class, measures its __dict__ and the values in it, and attributes
+  // them to the owning attributes. compute_fn(addr, result) must return false if the object at addr isn't a container
+  // that should be measured.
+  template <typename ComputeFnT>
+  void add_instance_attributes(size_t thread_index, const PyObject& obj, MappedPtr<PyObject> addr, ComputeFnT&& compute_fn) {
+    auto dict_addr = heap_instance_dict(this->env, obj, addr);
+    if (dict_addr.is_null()) {
+      return;
+    }
+    auto& state = this->thread_states[thread_index];
+    ResultT dict_result;
+    if (compute_fn(dict_addr.cast<PyObject>(), dict_result)) {
+      state.stats_for_owner[std::make_pair(obj.ob_type, MappedPtr<PyObject>())].add(dict_result);
+    }
+    this->env.r.get(dict_addr).for_each_entry(this->env.r,
+        [&](const PyDictKeyEntry& entry, MappedPtr<PyObject> value_addr) -> void {
+          ResultT value_result;
+          if (this->env.r.obj_valid(value_addr) && compute_fn(value_addr, value_result)) {
+            state.stats_for_owner[std::make_pair(obj.ob_type, entry.me_key)].add(value_result);
+          }
+        });
+  }
+
+  // Combines the per-thread results, merging attributes with the same name but different key objects
+  void merge() {
+    for (auto& state : this->thread_states) {
+      for (const auto& [type_addr, stats] : state.stats_for_type) {
+        this->stats_for_type[type_addr].merge(stats);
+      }
+      for (const auto& [owner, stats] : state.stats_for_owner) {
+        std::string attr_name = owner.second.is_null() ? "__dict__" : attribute_name(this->env, owner.second);
+        this->stats_for_owner[std::format("{}.{}", this->name_for_type.at(owner.first), attr_name)].merge(stats);
+      }
+      for (; !state.top_containers.empty(); state.top_containers.pop()) {
+        this->top_containers.emplace_back(state.top_containers.top());
+      }
+    }
+    this->thread_states.clear();
+  }
+
+  // Prints the merged results. format_stats(stats) returns the summary for a type or owner, and format_top(entry)
+  // returns the description of one of the top containers (its repr is appended).
+  template <typename FormatStatsFnT, typename FormatTopFnT>
+  void print(phosg::Arguments& args, const char* top_title, FormatStatsFnT&& format_stats, FormatTopFnT&& format_top) {
+    phosg::fwrite_fmt(stdout, "By container type:\n");
+    for (const auto& [type_addr, stats] : this->stats_for_type) {
+      phosg::fwrite_fmt(stdout, "  ({} objects) {}: {}\n", stats.count, this->name_for_type.at(type_addr), format_stats(stats));
+    }
+
+    std::vector<std::pair<std::string, const StatsT*>> sorted_owners;
+    for (const auto& [owner_name, stats] : this->stats_for_owner) {
+      sorted_owners.emplace_back(owner_name, &stats);
+    }
+    std::sort(sorted_owners.begin(), sorted_owners.end(), [](const auto& a, const auto& b) -> bool {
+      return a.second->score() > b.second->score();
+    });
+    if (sorted_owners.size() > this->max_results) {
+      sorted_owners.resize(this->max_results);
+    }
+    phosg::fwrite_fmt(stdout, "By owning attribute:\n");
+    for (auto it = sorted_owners.rbegin(); it != sorted_owners.rend(); it++) {
+      phosg::fwrite_fmt(stdout, "  ({} objects) {}: {}\n", it->second->count, it->first, format_stats(*it->second));
+    }
+
+    std::sort(this->top_containers.begin(), this->top_containers.end());
+    if (this->top_containers.size() > this->max_results) {
+      this->top_containers.erase(this->top_containers.begin(), this->top_containers.end() - this->max_results);
+    }
+    phosg::fwrite_fmt(stdout, "{}:\n", top_title);
+    for (const auto& entry : this->top_containers) {
+      auto t = this->env.traverse(&args);
+      t.max_recursion_depth = 0;
+      phosg::fwrite_fmt(stdout, "  {}: {}\n", format_top(entry), t.repr(entry.addr));
+    }
+  }
+};
+
+struct ContainerSlack {
+  size_t total_bytes = 0; // Shallow size of the container
+  size_t unused_bytes = 0; // Allocated capacity that has never been used
+  size_t dummy_bytes = 0; // Slots occupied by deleted entries
+  size_t reclaimable_bytes = 0; // How much smaller the container would be if it were rebuilt at its current size
+
+  void merge(const ContainerSlack& other) {
+    this->total_bytes += other.total_bytes;
+    this->unused_bytes += other.unused_bytes;
+    this->dummy_bytes += other.dummy_bytes;
+    this->reclaimable_bytes += other.reclaimable_bytes;
+  }
+};
+
+// Returns false if the object isn't a valid list, dict, or set
+static bool compute_container_slack(const Environment& env, MappedPtr<PyObject> addr, ContainerSlack& ret) {
+  const auto& obj = env.r.get(addr);
+  if (obj.ob_type == env.get_type_if_exists("list")) {
+    const auto& list = env.r.get(addr.cast<PyListObject>());
+    if (list.invalid_reason(env)) {
+      return false;
+    }
+    ret.unused_bytes = (list.allocated - list.ob_size) * sizeof(MappedPtr<PyObject>);
+    ret.reclaimable_bytes = ret.unused_bytes;
+
+  } else if (obj.ob_type == env.get_type_if_exists("dict")) {
+    const auto& dict = env.r.get(addr.cast<PyDictObject>());
+    if (dict.invalid_reason(env)) {
+      return false;
+    }
+    const auto& keys = env.r.get(dict.ma_keys);
+    // Split dicts use their class' shared keys table, and their values arrays are sized to match it, so there's
+    // nothing to reclaim by rebuilding them. The same is true for the shared empty keys table.
+    if (dict.ma_values.is_null() && (keys.dk_refcnt == 1)) {
+      ret.unused_bytes = keys.dk_usable * sizeof(PyDictKeyEntry);
+      ret.dummy_bytes = (keys.dk_nentries - dict.ma_used) * sizeof(PyDictKeyEntry);
+      size_t min_bytes = PyDictKeysObject::allocated_size_for_size(PyDictKeysObject::min_size_for_items(dict.ma_used));
+      size_t current_bytes = keys.allocated_size();
+      ret.reclaimable_bytes = (current_bytes > min_bytes) ? (current_bytes - min_bytes) : 0;
+    }
+
+  } else if ((obj.ob_type == env.get_type_if_exists("set")) || (obj.ob_type == env.get_type_if_exists("frozenset"))) {
+    const auto& set = env.r.get(addr.cast<PySetObject>());
+    if (set.invalid_reason(env)) {
+      return false;
+    }
+    ret.dummy_bytes = (set.fill - set.used) * sizeof(PySetObject::Entry);
+    // Small sets use a table embedded in the set object, which can't be reclaimed
+    if (set.table != addr.offset_bytes(sizeof(PySetObject)).cast<PySetObject::Entry>()) {
+      ret.unused_bytes = (set.mask + 1 - set.fill) * sizeof(PySetObject::Entry);
+      uint64_t min_table_size = PySetObject::min_table_size_for_items(set.used);
+      size_t min_bytes = (min_table_size > 8) ? (min_table_size * sizeof(PySetObject::Entry)) : 0;
+      size_t current_bytes = (set.mask + 1) * sizeof(PySetObject::Entry);
+      ret.reclaimable_bytes = (current_bytes > min_bytes) ? (current_bytes - min_bytes) : 0;
+    }
+
+  } else {
+    return false;
+  }
+
+  ret.total_bytes = env.shallow_size(addr);
+  return true;
+}
+
+ShellCommand c_container_slack(
+    "container-slack", "\
+  container-slack [OPTIONS]\n\
+    Finds all lists, dicts, and sets, and computes how much of their memory is\n\
+    unused capacity or occupied by deleted entries. Shows totals per container\n\
+    type, per attribute of Python-defined classes that hold containers, and\n\
+    the individual containers that would shrink the most if rebuilt (e.g. with\n\
+    list(x), dict(x), or set(x)). Options:\n\
+      --max-results=N: Show this many owners and containers (default 20).\n\
+    The formatting options to the repr command are also valid here.\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t max_results = args.get<size_t>("max-results", 20);
+
+      struct SlackStats {
+        size_t count = 0;
+        ContainerSlack slack;
+
+        void add(const ContainerSlack& other) {
+          this->count++;
+          this->slack.merge(other);
+        }
+        void merge(const SlackStats& other) {
+          this->count += other.count;
+          this->slack.merge(other.slack);
+        }
+        size_t score() const {
+          return this->slack.reclaimable_bytes;
+        }
+      };
+
+      auto name_for_type = names_for_types(shell.env);
+      ContainerReport<SlackStats, ContainerSlack> report(shell.env, name_for_type, max_results, shell.max_threads);
+      auto compute_slack = [&](MappedPtr<PyObject> addr, ContainerSlack& slack) -> bool {
+        return compute_container_slack(shell.env, addr, slack);
+      };
+
+      shell.env.r.map_all_addresses<PyObject>(
+          [&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+            if (!name_for_type.count(obj.ob_type) || obj.invalid_reason(shell.env)) {
+              return;
+            }
+            try {
+              ContainerSlack slack;
+              if (compute_slack(addr, slack)) {
+                report.add_container(thread_index, obj.ob_type, addr, slack, slack.reclaimable_bytes);
+              } else {
+                report.add_instance_attributes(thread_index, obj, addr, compute_slack);
+              }
+            } catch (const std::out_of_range&) {
+            }
+          },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+      auto format_stats = [](const SlackStats& stats) -> std::string {
+        return std::format("{} total, {} unused, {} deleted entries, {} reclaimable",
+            phosg::format_size(stats.slack.total_bytes), phosg::format_size(stats.slack.unused_bytes),
+            phosg::format_size(stats.slack.dummy_bytes), phosg::format_size(stats.slack.reclaimable_bytes));
+      };
+      auto format_top = [](const auto& entry) -> std::string {
+        return std::format("{} reclaimable", phosg::format_size(entry.score));
+      };
+      report.merge();
+      report.print(args, "Containers with the most reclaimable memory", format_stats, format_top);
+    });
+
+ShellCommand c_hash_quality(
+    "hash-quality", "\
+  hash-quality [OPTIONS]\n\
+    Finds all dicts and sets and computes, for each key they contain, how many\n\
+    table slots a lookup for that key has to examine. Shows the distribution of\n\
+    probe lengths, probe statistics by key type, and the dicts and sets with\n\
+    the worst clustering (which usually indicates a poorly-distributed\n\
+    __hash__ implementation) or the most deleted entries. Options:\n\
+      --min-entries=N: Only flag containers with at least this many entries\n\
+        (default 8).\n\
+      --min-max-probes=N: Flag containers where any key takes at least this\n\
+        many probes to find (default 8).\n\
+      --min-dummy-percent=N: Flag containers where at least this percentage of\n\
+        the table is occupied by deleted entries (default 25).\n\
+      --max-results=N: Show at most this many flagged containers (default 20).\n\
+    The formatting options to the repr command are also valid here.\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t min_entries = args.get<size_t>("min-entries", 8);
+      size_t min_max_probes = args.get<size_t>("min-max-probes", 8);
+      size_t min_dummy_percent = args.get<size_t>("min-dummy-percent", 25);
+      size_t max_results = args.get<size_t>("max-results", 20);
+
+      struct ProbeStats {
+        size_t num_containers = 0;
+        size_t num_entries = 0;
+        size_t total_probes = 0;
+        size_t max_probes = 0;
+
+        void add(size_t probes) {
+          this->num_entries++;
+          this->total_probes += probes;
+          this->max_probes = std::max<size_t>(this->max_probes, probes);
+        }
+        void merge(const ProbeStats& other) {
+          this->num_containers += other.num_containers;
+          this->num_entries += other.num_entries;
+          this->total_probes += other.total_probes;
+          this->max_probes = std::max<size_t>(this->max_probes, other.max_probes);
+        }
+      };
+      struct FlaggedContainer {
+        // Probes beyond the first, summed over all entries; this is how much lookup work is caused by collisions
+        size_t excess_probes;
+        MappedPtr<PyObject> addr;
+        size_t num_entries;
+        size_t max_probes;
+        size_t dummy_percent;
+
+        bool operator>(const FlaggedContainer& other) const {
+          return this->excess_probes > other.excess_probes;
+        }
+      };
+      using FlaggedHeap = std::priority_queue<FlaggedContainer, std::vector<FlaggedContainer>, std::greater<FlaggedContainer>>;
+      struct ThreadState {
+        // Bucket N contains entries with probe lengths in [2^(N-1), 2^N)
+        std::vector<size_t> probe_length_histogram;
+        std::unordered_map<MappedPtr<PyTypeObject>, ProbeStats> stats_for_container_type;
+        std::unordered_map<MappedPtr<PyTypeObject>, ProbeStats> stats_for_key_type;
+        FlaggedHeap flagged;
+      };
+
+      auto dict_type = shell.env.get_type_if_exists("dict");
+      auto set_type = shell.env.get_type_if_exists("set");
+      auto frozenset_type = shell.env.get_type_if_exists("frozenset");
+      auto name_for_type = names_for_types(shell.env);
+
+      std::vector<ThreadState> thread_states;
+      thread_states.resize(shell.max_threads);
+      shell.env.r.map_all_addresses<PyObject>(
+          [&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+            if ((obj.ob_type != dict_type) && (obj.ob_type != set_type) && (obj.ob_type != frozenset_type)) {
+              return;
+            }
+            auto& state = thread_states[thread_index];
+            try {
+              std::vector<std::pair<MappedPtr<PyObject>, size_t>> probe_lengths;
+              size_t table_size, num_dummies;
+              if (obj.ob_type == dict_type) {
+                const auto& dict = shell.env.r.get(addr.cast<PyDictObject>());
+                if (dict.invalid_reason(shell.env)) {
+                  return;
+                }
+                const auto& keys = shell.env.r.get(dict.ma_keys);
+                // Split dicts share one keys table with all other instances of the same class, and their keys are
+                // always attribute name strings, so they aren't interesting here
+                if (!dict.ma_values.is_null()) {
+                  return;
+                }
+                probe_lengths = dict.get_probe_lengths(shell.env.r);
+                table_size = keys.dk_size;
+                num_dummies = 0;
+                for (int64_t table_v : dict.get_table(shell.env.r)) {
+                  num_dummies += (table_v == -2); // DKIX_DUMMY
+                }
+              } else {
+                const auto& set = shell.env.r.get(addr.cast<PySetObject>());
+                if (set.invalid_reason(shell.env)) {
+                  return;
+                }
+                probe_lengths = set.get_probe_lengths(shell.env.r);
+                table_size = set.mask + 1;
+                num_dummies = set.fill - set.used;
+              }
+
+              ProbeStats container_stats;
+              for (const auto& [key_addr, probes] : probe_lengths) {
+                container_stats.add(probes);
+                size_t bucket = std::bit_width(probes);
+                if (state.probe_length_histogram.size() <= bucket) {
+                  state.probe_length_histogram.resize(bucket + 1, 0);
+                }
+                state.probe_length_histogram[bucket]++;
+                if (shell.env.r.obj_valid(key_addr)) {
+                  auto& key_stats = state.stats_for_key_type[shell.env.r.get(key_addr).ob_type];
+                  key_stats.add(probes);
+                }
+              }
+              container_stats.num_containers = 1;
+              state.stats_for_container_type[obj.ob_type].merge(container_stats);
+
+              size_t dummy_percent = table_size ? ((num_dummies * 100) / table_size) : 0;
+              if ((container_stats.num_entries >= min_entries) &&
+                  ((container_stats.max_probes >= min_max_probes) || (dummy_percent >= min_dummy_percent))) {
+                state.flagged.emplace(FlaggedContainer{
+                    .excess_probes = container_stats.total_probes - container_stats.num_entries,
+                    .addr = addr,
+                    .num_entries = container_stats.num_entries,
+                    .max_probes = container_stats.max_probes,
+                    .dummy_percent = dummy_percent});
+                if (state.flagged.size() > max_results) {
+                  state.flagged.pop();
+                }
+              }
+            } catch (const std::out_of_range&) {
+            }
+          },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+      std::vector<size_t> probe_length_histogram;
+      std::unordered_map<MappedPtr<PyTypeObject>, ProbeStats> stats_for_container_type;
+      std::unordered_map<MappedPtr<PyTypeObject>, ProbeStats> stats_for_key_type;
+      std::vector<FlaggedContainer> flagged;
+      for (auto& state : thread_states) {
+        if (probe_length_histogram.size() < state.probe_length_histogram.size()) {
+          probe_length_histogram.resize(state.probe_length_histogram.size(), 0);
+        }
+        for (size_t z = 0; z < state.probe_length_histogram.size(); z++) {
+          probe_length_histogram[z] += state.probe_length_histogram[z];
+        }
+        for (const auto& [type_addr, stats] : state.stats_for_container_type) {
+          stats_for_container_type[type_addr].merge(stats);
+        }
+        for (const auto& [type_addr, stats] : state.stats_for_key_type) {
+          stats_for_key_type[type_addr].merge(stats);
+        }
+        for (; !state.flagged.empty(); state.flagged.pop()) {
+          flagged.emplace_back(state.flagged.top());
+        }
+      }
+
+      auto type_name = [&](MappedPtr<PyTypeObject> type_addr) -> std::string {
+        try {
+          return name_for_type.at(type_addr);
+        } catch (const std::out_of_range&) {
+          return std::format("<type@{}>", type_addr);
+        }
+      };
+      auto format_stats = [](const ProbeStats& stats) -> std::string {
+        return std::format("{} entries, {:.2f} probes per lookup, {} max",
+            stats.num_entries, stats.num_entries ? (static_cast<double>(stats.total_probes) / stats.num_entries) : 0.0,
+            stats.max_probes);
+      };
+
+      phosg::fwrite_fmt(stdout, "Probe length distribution:\n");
+      for (size_t z = 1; z < probe_length_histogram.size(); z++) {
+        size_t low = 1ULL << (z - 1);
+        size_t high = (1ULL << z) - 1;
+        if (low == high) {
+          phosg::fwrite_fmt(stdout, "  {}: {}\n", low, probe_length_histogram[z]);
+        } else {
+          phosg::fwrite_fmt(stdout, "  {}-{}: {}\n", low, high, probe_length_histogram[z]);
+        }
+      }
+
+      phosg::fwrite_fmt(stdout, "By container type:\n");
+      for (const auto& [type_addr, stats] : stats_for_container_type) {
+        phosg::fwrite_fmt(stdout, "  ({} objects) {}: {}\n", stats.num_containers, type_name(type_addr), format_stats(stats));
+      }
+
+      std::vector<std::pair<MappedPtr<PyTypeObject>, ProbeStats>> sorted_key_types(
+          stats_for_key_type.begin(), stats_for_key_type.end());
+      std::sort(sorted_key_types.begin(), sorted_key_types.end(), [](const auto& a, const auto& b) -> bool {
+        return (a.second.total_probes - a.second.num_entries) < (b.second.total_probes - b.second.num_entries);
+      });
+      phosg::fwrite_fmt(stdout, "By key type:\n");
+      for (const auto& [type_addr, stats] : sorted_key_types) {
+        phosg::fwrite_fmt(stdout, "  {}: {}\n", type_name(type_addr), format_stats(stats));
+      }
+
+      std::sort(flagged.begin(), flagged.end(), [](const auto& a, const auto& b) -> bool {
+        return a.excess_probes < b.excess_probes;
+      });
+      if (flagged.size() > max_results) {
+        flagged.erase(flagged.begin(), flagged.end() - max_results);
+      }
+      phosg::fwrite_fmt(stdout, "Containers with poor hash distribution or many deleted entries:\n");
+      for (const auto& c : flagged) {
+        auto t = shell.env.traverse(&args);
+        t.max_recursion_depth = 0;
+        phosg::fwrite_fmt(stdout, "  {} entries, {} excess probes, {} max, {}% deleted: {}\n",
+            c.num_entries, c.excess_probes, c.max_probes, c.dummy_percent, t.repr(c.addr));
+      }
+    });
+
+struct BoxedNumericCost {
+  size_t length = 0;
+  size_t num_ints = 0;
+  size_t num_floats = 0;
+  size_t boxed_bytes = 0; // Container slots plus all numeric objects referenced only by this container
+  size_t packed_bytes = 0; // Size of the equivalent array.array or numpy array's data
+  char typecode = 0; // array.array typecode that would hold all the values
+
+  size_t savings() const {
+    return (this->boxed_bytes > this->packed_bytes) ? (this->boxed_bytes - this->packed_bytes) : 0;
+  }
+};
+
+// Returns false if the object isn't a list or tuple, is shorter than min_length, or has less than min_percent of its
+// elements as ints or floats
+static bool compute_boxed_numeric_cost(
+    const Environment& env, MappedPtr<PyObject> addr, size_t min_length, size_t min_percent, BoxedNumericCost& ret) {
+  const auto& obj = env.r.get(addr);
+  std::vector<MappedPtr<PyObject>> items;
+  if (obj.ob_type == env.get_type_if_exists("list")) {
+    const auto& list = env.r.get(addr.cast<PyListObject>());
+    if ((static_cast<size_t>(list.ob_size) < min_length) || list.invalid_reason(env)) {
+      return false;
+    }
+    items = list.get_items(env.r);
+  } else if (obj.ob_type == env.get_type_if_exists("tuple")) {
+    const auto& tuple = env.r.get(addr.cast<PyTupleObject>());
+    if ((static_cast<size_t>(tuple.ob_size) < min_length) || tuple.invalid_reason(env)) {
+      return false;
+    }
+    items = tuple.get_items();
+  } else {
+    return false;
+  }
+
+  auto int_type = env.get_type_if_exists("int");
+  auto float_type = env.get_type_if_exists("float");
+  size_t max_int_digits = 0;
+  ret.length = items.size();
+  ret.boxed_bytes = items.size() * sizeof(MappedPtr<PyObject>);
+  for (auto item_addr : items) {
+    if (!env.r.obj_valid(item_addr)) {
+      continue;
+    }
+    const auto& item = env.r.get(item_addr);
+    if (item.ob_type == int_type) {
+      ret.num_ints++;
+      max_int_digits = std::max<size_t>(max_int_digits, std::abs(env.r.get(item_addr.cast<PyLongObject>()).ob_size));
+    } else if (item.ob_type == float_type) {
+      ret.num_floats++;
+    } else {
+      continue;
+    }
+    // Small ints and other shared values would exist anyway, so they don't count toward the boxing cost
+    if (item.ob_refcnt == 1) {
+      ret.boxed_bytes += env.shallow_size(item_addr);
+    }
+  }
+  if ((ret.num_ints + ret.num_floats) * 100 < ret.length * min_percent) {
+    return false;
+  }
+
+  // Ints are stored in 30-bit digits, so one digit fits in a 32-bit int and two fit in a 64-bit int. Anything larger
+  // can't be packed without loss (unless it's converted to a double).
+  size_t item_size;
+  if (ret.num_floats || (max_int_digits > 2)) {
+    ret.typecode = 'd';
+    item_size = sizeof(double);
+  } else if (max_int_digits > 1) {
+    ret.typecode = 'q';
+    item_size = sizeof(int64_t);
+  } else {
+    ret.typecode = 'i';
+    item_size = sizeof(int32_t);
+  }
+  ret.packed_bytes = ret.length * item_size;
+  return true;
+}
+
+ShellCommand c_boxed_numerics(
+    "boxed-numerics", "\
+  boxed-numerics [OPTIONS]\n\
+    Finds all lists and tuples that contain mostly ints and floats, and\n\
+    estimates how much memory would be saved by storing them in an array.array\n\
+    or numpy array instead. The boxed cost includes the container's item slots\n\
+    and all int and float objects that aren't referenced from anywhere else.\n\
+    Shows totals by the attribute of Python-defined classes that holds them,\n\
+    and the individual containers with the largest potential savings. Options:\n\
+      --min-length=N: Ignore containers with fewer than N items (default 16).\n\
+      --min-percent=N: Ignore containers where less than N% of the items are\n\
+        ints or floats (default 90).\n\
+      --max-results=N: Show this many owners and containers (default 20).\n\
+    The formatting options to the repr command are also valid here.\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t min_length = args.get<size_t>("min-length", 16);
+      size_t min_percent = args.get<size_t>("min-percent", 90);
+      size_t max_results = args.get<size_t>("max-results", 20);
+
+      struct BoxedStats {
+        size_t count = 0;
+        size_t num_items = 0;
+        size_t boxed_bytes = 0;
+        size_t packed_bytes = 0;
+
+        void add(const BoxedNumericCost& cost) {
+          this->count++;
+          this->num_items += cost.length;
+          this->boxed_bytes += cost.boxed_bytes;
+          this->packed_bytes += cost.packed_bytes;
+        }
+        void merge(const BoxedStats& other) {
+          this->count += other.count;
+          this->num_items += other.num_items;
+          this->boxed_bytes += other.boxed_bytes;
+          this->packed_bytes += other.packed_bytes;
+        }
+        size_t score() const {
+          return (this->boxed_bytes > this->packed_bytes) ? (this->boxed_bytes - this->packed_bytes) : 0;
+        }
+      };
+
+      auto name_for_type = names_for_types(shell.env);
+      ContainerReport<BoxedStats, BoxedNumericCost> report(shell.env, name_for_type, max_results, shell.max_threads);
+      auto compute_cost = [&](MappedPtr<PyObject> addr, BoxedNumericCost& cost) -> bool {
+        return compute_boxed_numeric_cost(shell.env, addr, min_length, min_percent, cost);
+      };
+
+      shell.env.r.map_all_addresses<PyObject>(
+          [&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+            if (!name_for_type.count(obj.ob_type) || obj.invalid_reason(shell.env)) {
+              return;
+            }
+            try {
+              BoxedNumericCost cost;
+              if (compute_cost(addr, cost)) {
+                report.add_container(thread_index, obj.ob_type, addr, cost, cost.savings());
+              } else {
+                report.add_instance_attributes(thread_index, obj, addr, compute_cost);
+              }
+            } catch (const std::out_of_range&) {
+            }
+          },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+      auto format_stats = [](const BoxedStats& stats) -> std::string {
+        return std::format("{} items, {} boxed, {} packed, {} savings", stats.num_items,
+            phosg::format_size(stats.boxed_bytes), phosg::format_size(stats.packed_bytes),
+            phosg::format_size(stats.score()));
+      };
+      auto format_top = [](const auto& entry) -> std::string {
+        return std::format("{} savings ({} items: {} int, {} float; {} boxed, array('{}') {})",
+            phosg::format_size(entry.score), entry.result.length, entry.result.num_ints, entry.result.num_floats,
+            phosg::format_size(entry.result.boxed_bytes), entry.result.typecode,
+            phosg::format_size(entry.result.packed_bytes));
+      };
+      report.merge();
+      report.print(args, "Containers with the largest potential savings", format_stats, format_top);
+    });
+
+ShellCommand c_duplicate_definitions(
+    "duplicate-definitions", "\
+  duplicate-definitions [OPTIONS]\n\
+    Finds classes and code objects that exist in multiple copies, which\n\
+    usually means they're being created repeatedly at runtime (e.g. classes\n\
+    defined inside functions, namedtuple or type() calls in a loop, or code\n\
+    compiled with exec or compile) and never freed. Classes are grouped by\n\
+    module and qualified name, and code objects by filename, line, and name.\n\
+    For each group that has multiple copies, shows the number of copies and\n\
+    the memory they use: for classes, the type objects and the memory\n\
+    retained by their dicts, MROs, and bases tuples; for code objects, the\n\
+    code objects and the memory retained by them (bytecode, line tables,\n\
+    constants, and names). Requires find-all-types to have been run. Options:\n\
+      --min-copies=N: Only show groups with at least this many copies\n\
+        (default 2).\n\
+      --max-results=N: Show at most this many groups of each kind\n\
+        (default 30).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t min_copies = args.get<size_t>("min-copies", 2);
+      size_t max_results = args.get<size_t>("max-results", 30);
+
+      struct GroupStats {
+        size_t num_copies = 0;
+        size_t bytes = 0;
+      };
+      auto print_groups = [&](const std::unordered_map<std::string, GroupStats>& stats_for_name, const char* kind) -> void {
+        std::vector<std::tuple<size_t, size_t, std::string>> sorted_groups;
+        size_t total_copies = 0, total_bytes = 0;
+        for (const auto& [name, stats] : stats_for_name) {
+          if (stats.num_copies >= min_copies) {
+            sorted_groups.emplace_back(stats.bytes, stats.num_copies, name);
+            total_copies += stats.num_copies;
+            total_bytes += stats.bytes;
+          }
+        }
+        std::sort(sorted_groups.begin(), sorted_groups.end());
+        phosg::fwrite_fmt(stdout, "{} {} groups have at least {} copies ({} copies, {} overall)\n",
+            sorted_groups.size(), kind, min_copies, total_copies, phosg::format_size(total_bytes));
+        if (sorted_groups.size() > max_results) {
+          sorted_groups.erase(sorted_groups.begin(), sorted_groups.end() - max_results);
+        }
+        for (const auto& [bytes, num_copies, name] : sorted_groups) {
+          phosg::fwrite_fmt(stdout, "  ({} copies, {}) {}\n", num_copies, phosg::format_size(bytes), name);
+        }
+      };
+
+      // Duplicate type names are recorded as name+addr by find-all-types, so every type object is in type_objects
+      std::unordered_set<MappedPtr<PyTypeObject>> type_addrs;
+      for (const auto& [_, type_addr] : shell.env.type_objects) {
+        type_addrs.emplace(type_addr);
+      }
+      std::unordered_map<std::string, GroupStats> stats_for_class;
+      for (auto type_addr : type_addrs) {
+        try {
+          const auto& type_obj = shell.env.r.get(type_addr);
+          auto& stats = stats_for_class[type_obj.qualified_name(shell.env)];
+          stats.num_copies++;
+          stats.bytes += shell.env.shallow_size(type_addr.cast<PyObject>());
+          for (auto addr : {type_obj.tp_dict.cast<PyObject>(), type_obj.tp_mro, type_obj.tp_bases.cast<PyObject>()}) {
+            if (!addr.is_null() && !shell.env.invalid_reason(addr)) {
+              stats.bytes += shell.env.retained_size(addr);
+            }
+          }
+        } catch (const std::out_of_range&) {
+        }
+      }
+      print_groups(stats_for_class, "Class");
+
+      auto code_type = shell.env.get_type("code");
+      std::vector<std::unordered_map<std::string, GroupStats>> thread_stats_for_code;
+      thread_stats_for_code.resize(shell.max_threads);
+      shell.env.r.map_all_addresses<PyObject>([&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+        if ((obj.ob_type != code_type) || shell.env.invalid_reason(addr)) {
+          return;
+        }
+        try {
+          const auto& code = shell.env.r.get(addr.cast<PyCodeObject>());
+          std::string key = std::format("{} ({}:{})", decode_string_types(shell.env.r, code.co_name, 0x100),
+              decode_string_types(shell.env.r, code.co_filename, 0x400), code.co_firstlineno);
+          auto& stats = thread_stats_for_code[thread_index][key];
+          stats.num_copies++;
+          stats.bytes += shell.env.retained_size(addr);
+        } catch (const std::out_of_range&) {
+        } catch (const invalid_object&) {
+        }
+      },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+      std::unordered_map<std::string, GroupStats> stats_for_code;
+      for (const auto& thread_stats : thread_stats_for_code) {
+        for (const auto& [key, stats] : thread_stats) {
+          auto& total_stats = stats_for_code[key];
+          total_stats.num_copies += stats.num_copies;
+          total_stats.bytes += stats.bytes;
+        }
+      }
+      print_groups(stats_for_code, "Code object");
+    });
+
+ShellCommand c_cache_census(
+    "cache-census", "\
+  cache-census [OPTIONS]\n\
+    Finds caches that may be growing without bound. Reports all functions\n\
+    wrapped with functools.lru_cache (or functools.cache), with their entry\n\
+    counts, maxsize, hit and miss counts, and the memory retained by their\n\
+    cached keys and results. Also reports dicts and sets stored directly in\n\
+    module globals that have many entries. Caches found in module globals are\n\
+    named by module and global name; other lru_cache wrappers (e.g. decorated\n\
+    methods) are named by the function they wrap. Options:\n\
+      --min-entries=N: Only report module-level dicts and sets with at least\n\
+        this many entries (default 1000). lru_cache wrappers are always\n\
+        reported.\n\
+      --max-results=N: Show at most this many caches of each kind (default\n\
+        30).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t min_entries = args.get<size_t>("min-entries", 1000);
+      size_t max_results = args.get<size_t>("max-results", 30);
+
+      auto module_type = shell.env.get_type("module");
+      auto dict_type = shell.env.get_type("dict");
+      auto set_type = shell.env.get_type_if_exists("set");
+      auto lru_cache_type = shell.env.get_type_if_exists("functools._lru_cache_wrapper");
+
+      std::vector<std::vector<MappedPtr<PyObject>>> thread_module_addrs;
+      std::vector<std::vector<MappedPtr<PyObject>>> thread_lru_cache_addrs;
+      thread_module_addrs.resize(shell.max_threads);
+      thread_lru_cache_addrs.resize(shell.max_threads);
+      shell.env.r.map_all_addresses<PyObject>([&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+        if (obj.ob_type == module_type) {
+          if (!shell.env.invalid_reason(addr)) {
+            thread_module_addrs[thread_index].emplace_back(addr);
+          }
+        } else if (!lru_cache_type.is_null() && (obj.ob_type == lru_cache_type)) {
+          if (!shell.env.invalid_reason(addr)) {
+            thread_lru_cache_addrs[thread_index].emplace_back(addr);
+          }
+        }
+      },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+      std::unordered_set<MappedPtr<PyObject>> lru_cache_addrs;
+      for (const auto& addrs : thread_lru_cache_addrs) {
+        lru_cache_addrs.insert(addrs.begin(), addrs.end());
+      }
+
+      // A single pass over all module dicts finds both the large containers and the names of the lru_cache wrappers
+      // that are stored in module globals
+      struct ContainerInfo {
+        size_t retained_bytes;
+        size_t num_entries;
+        std::string name;
+        const char* kind;
+
+        bool operator<(const ContainerInfo& other) const {
+          return this->retained_bytes < other.retained_bytes;
+        }
+      };
+      std::vector<ContainerInfo> containers;
+      std::unordered_map<MappedPtr<PyObject>, std::string> name_for_lru_cache;
+      for (const auto& addrs : thread_module_addrs) {
+        for (auto module_addr : addrs) {
+          try {
+            auto dict_addr = shell.env.r.get(module_addr.offset_bytes(0x10).cast<MappedPtr<PyDictObject>>());
+            const auto& dict_obj = shell.env.r.get(dict_addr);
+            if ((dict_obj.ob_type != dict_type) || dict_obj.invalid_reason(shell.env)) {
+              continue;
+            }
+            std::string module_name = decode_string_types(
+                shell.env.r, dict_obj.value_for_key<PyObject>(shell.env.r, "__name__"));
+            dict_obj.for_each_entry(shell.env.r, [&](const PyDictKeyEntry& entry, MappedPtr<PyObject> value_addr) -> void {
+              try {
+                const auto& value = shell.env.r.get(value_addr);
+                size_t num_entries;
+                const char* kind;
+                if (lru_cache_addrs.count(value_addr)) {
+                  name_for_lru_cache.emplace(value_addr, module_name + "." + decode_string_types(shell.env.r, entry.me_key));
+                  return;
+                } else if (value.ob_type == dict_type) {
+                  num_entries = shell.env.r.get(value_addr.cast<PyDictObject>()).ma_used;
+                  kind = "dict";
+                } else if (!set_type.is_null() && (value.ob_type == set_type)) {
+                  num_entries = shell.env.r.get(value_addr.cast<PySetObject>()).used;
+                  kind = "set";
+                } else {
+                  return;
+                }
+                if ((num_entries < min_entries) || shell.env.invalid_reason(value_addr)) {
+                  return;
+                }
+                containers.emplace_back(ContainerInfo{
+                    .retained_bytes = shell.env.retained_size(value_addr),
+                    .num_entries = num_entries,
+                    .name = module_name + "." + decode_string_types(shell.env.r, entry.me_key),
+                    .kind = kind});
+              } catch (const std::out_of_range&) {
+              } catch (const invalid_object&) {
+              }
+            });
+          } catch (const std::out_of_range&) {
+          } catch (const invalid_object&) {
+          }
+        }
+      }
+
+      struct LruCacheInfo {
+        size_t retained_bytes;
+        MappedPtr<PyObject> addr;
+        std::string name;
+
+        bool operator<(const LruCacheInfo& other) const {
+          return this->retained_bytes < other.retained_bytes;
+        }
+      };
+      std::vector<LruCacheInfo> lru_caches;
+
+      // Unbounded caches map keys directly to results, so the dict's retained size is accurate for them. In bounded
+      // caches, each key is referenced both by the dict and by its list element (whose key field points back to it),
+      // so retained_size would skip it; instead, we walk the entries and count a key as owned by the cache if those
+      // are its only two references. The list links don't hold references, so each element is owned by the dict.
+      auto lru_list_elem_type = shell.env.get_type_if_exists("functools._lru_list_elem");
+      auto lru_cache_retained_size = [&](const PyLruCacheObject& cache) -> size_t {
+        const auto& dict_obj = shell.env.r.get(cache.cache.cast<PyDictObject>());
+        if ((dict_obj.ob_type != dict_type) || dict_obj.invalid_reason(shell.env)) {
+          return 0;
+        }
+        if ((cache.maxsize < 0) || lru_list_elem_type.is_null()) {
+          return shell.env.retained_size(cache.cache);
+        }
+        auto owned_retained_size = [&](MappedPtr<PyObject> addr, size_t num_internal_refs) -> size_t {
+          if (addr.is_null() || !shell.env.r.obj_valid(addr) || (shell.env.r.get(addr).ob_refcnt > num_internal_refs) ||
+              shell.env.invalid_reason(addr)) {
+            return 0;
+          }
+          return shell.env.retained_size(addr);
+        };
+        size_t ret = shell.env.shallow_size(cache.cache);
+        dict_obj.for_each_entry(shell.env.r, [&](const PyDictKeyEntry& entry, MappedPtr<PyObject> value_addr) -> void {
+          try {
+            const auto& value = shell.env.r.get(value_addr);
+            if ((value.ob_type != lru_list_elem_type) || (value.ob_refcnt != 1)) {
+              ret += owned_retained_size(entry.me_key, 1) + owned_retained_size(value_addr, 1);
+              return;
+            }
+            const auto& elem = shell.env.r.get(value_addr.cast<PyLruListElemObject>());
+            ret += shell.env.shallow_size(value_addr);
+            ret += owned_retained_size(entry.me_key, (elem.key == entry.me_key) ? 2 : 1);
+            ret += owned_retained_size(elem.result, 1);
+          } catch (const std::out_of_range&) {
+          } catch (const invalid_object&) {
+          }
+        });
+        return ret;
+      };
+
+      size_t lru_total_bytes = 0;
+      size_t num_unbounded = 0;
+      for (auto addr : lru_cache_addrs) {
+        try {
+          const auto& cache = shell.env.r.get(addr.cast<PyLruCacheObject>());
+          auto& info = lru_caches.emplace_back();
+          info.addr = addr;
+          info.retained_bytes = lru_cache_retained_size(cache);
+          auto name_it = name_for_lru_cache.find(addr);
+          info.name = (name_it == name_for_lru_cache.end()) ? describe_callable(shell.env, cache.func) : name_it->second;
+          lru_total_bytes += info.retained_bytes;
+          num_unbounded += (cache.maxsize < 0);
+        } catch (const std::out_of_range&) {
+        } catch (const invalid_object&) {
+        }
+      }
+      std::sort(lru_caches.begin(), lru_caches.end());
+      phosg::fwrite_fmt(stdout, "{} lru_cache wrappers ({} unbounded) retain {} in their caches\n",
+          lru_caches.size(), num_unbounded, phosg::format_size(lru_total_bytes));
+      if (lru_caches.size() > max_results) {
+        lru_caches.erase(lru_caches.begin(), lru_caches.end() - max_results);
+      }
+      for (const auto& info : lru_caches) {
+        const auto& cache = shell.env.r.get(info.addr.cast<PyLruCacheObject>());
+        size_t num_entries = shell.env.r.get(cache.cache.cast<PyDictObject>()).ma_used;
+        std::string maxsize_str = (cache.maxsize < 0) ? "unbounded" : std::format("maxsize={}", cache.maxsize);
+        phosg::fwrite_fmt(stdout, "  {} ({} entries, {}, {} hits, {} misses) @ {}: {}\n",
+            phosg::format_size(info.retained_bytes), num_entries, maxsize_str, cache.hits, cache.misses, info.addr, info.name);
+      }
+
+      std::sort(containers.begin(), containers.end());
+      size_t containers_total_bytes = 0;
+      for (const auto& info : containers) {
+        containers_total_bytes += info.retained_bytes;
+      }
+      phosg::fwrite_fmt(stdout, "{} module-level dicts and sets have at least {} entries ({} overall)\n",
+          containers.size(), min_entries, phosg::format_size(containers_total_bytes));
+      if (containers.size() > max_results) {
+        containers.erase(containers.begin(), containers.end() - max_results);
+      }
+      for (const auto& info : containers) {
+        phosg::fwrite_fmt(stdout, "  {} ({} {} entries): {}\n",
+            phosg::format_size(info.retained_bytes), info.num_entries, info.kind, info.name);
+      }
+    });
+
+ShellCommand c_memory_by_module(
+    "memory-by-module", "\
+  memory-by-module [OPTIONS]\n\
+    Counts all objects and their sizes, grouped by the module that defines\n\
+    each object\'s type (and by top-level package). Types defined in C are\n\
+    attributed to the module in their names (e.g. _asyncio.Task is in the\n\
+    _asyncio module); types with no module in their names are attributed to\n\
+    builtins. Options:\n\
+      --retained: Also compute retained sizes. An object\'s retained size\n\
+          includes the objects it refers to (recursively) that have no other\n\
+          references; objects retained by other objects of the same module are\n\
+          counted more than once. This is much slower.\n\
+      --packages-only: Don\'t show the per-module breakdown.\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      bool compute_retained = args.get<bool>("retained");
+      bool packages_only = args.get<bool>("packages-only");
+
+      struct SizeStats {
+        size_t count = 0;
+        size_t shallow_bytes = 0;
+        size_t retained_bytes = 0;
+
+        void merge(const SizeStats& other) {
+          this->count += other.count;
+          this->shallow_bytes += other.shallow_bytes;
+          this->retained_bytes += other.retained_bytes;
+        }
+      };
+
+      auto name_for_type = names_for_types(shell.env);
+      std::vector<std::unordered_map<MappedPtr<PyTypeObject>, SizeStats>> stats_for_type;
+      stats_for_type.resize(shell.max_threads);
+
+      shell.env.r.map_all_addresses<PyObject>(
+          [&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+            if (!name_for_type.count(obj.ob_type) || shell.env.invalid_reason(addr)) {
+              return;
+            }
+            try {
+              auto& stats = stats_for_type[thread_index][obj.ob_type];
+              stats.count++;
+              stats.shallow_bytes += shell.env.shallow_size(addr);
+              if (compute_retained) {
+                stats.retained_bytes += shell.env.retained_size(addr);
+              }
+            } catch (const std::out_of_range&) {
+            }
+          },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+      std::unordered_map<MappedPtr<PyTypeObject>, SizeStats> overall_stats_for_type;
+      for (const auto& thread_stats_for_type : stats_for_type) {
+        for (const auto& [type_addr, stats] : thread_stats_for_type) {
+          overall_stats_for_type[type_addr].merge(stats);
+        }
+      }
+
+      std::unordered_map<std::string, SizeStats> stats_for_module;
+      std::unordered_map<std::string, SizeStats> stats_for_package;
+      for (const auto& [type_addr, stats] : overall_stats_for_type) {
+        std::string module_name = shell.env.r.get(type_addr).module_name(shell.env);
+        std::string package_name = module_name.substr(0, module_name.find('.'));
+        stats_for_module[module_name].merge(stats);
+        stats_for_package[package_name].merge(stats);
+      }
+
+      auto print_stats = [&](const char* title, const std::unordered_map<std::string, SizeStats>& stats_for_name) -> void {
+        std::vector<std::pair<std::string, const SizeStats*>> entries;
+        for (const auto& [name, stats] : stats_for_name) {
+          entries.emplace_back(name, &stats);
+        }
+        std::sort(entries.begin(), entries.end(), [&](const auto& a, const auto& b) -> bool {
+          return compute_retained
+              ? (a.second->retained_bytes < b.second->retained_bytes)
+              : (a.second->shallow_bytes < b.second->shallow_bytes);
+        });
+        phosg::fwrite_fmt(stdout, "{}:\n", title);
+        for (const auto& [name, stats] : entries) {
+          if (compute_retained) {
+            phosg::fwrite_fmt(stdout, "  ({} objects) {} shallow, {} retained: {}\n",
+                stats->count, phosg::format_size(stats->shallow_bytes), phosg::format_size(stats->retained_bytes), name);
+          } else {
+            phosg::fwrite_fmt(stdout, "  ({} objects) {}: {}\n", stats->count, phosg::format_size(stats->shallow_bytes), name);
+          }
+        }
+      };
+      if (!packages_only) {
+        print_stats("Modules", stats_for_module);
+      }
+      print_stats("Packages", stats_for_package);
+    });
+
+ShellCommand c_pymalloc_fragmentation(
+    "pymalloc-fragmentation", "\
+  pymalloc-fragmentation [OPTIONS]\n\
+    Finds all pymalloc pools and reports utilization per size class and per\n\
+    arena. pymalloc can only return an arena's memory to the OS when every\n\
+    block in it is free, so a few long-lived objects in an otherwise empty\n\
+    arena keep the whole arena resident (1MB on most 64-bit builds, or 256KB\n\
+    on others). For arenas below the utilization threshold, shows the types\n\
+    of the objects pinning them. Options:\n\
+      --max-utilization=N: Report arenas with at most this percentage of their\n\
+        memory in use (default 10).\n\
+      --max-results=N: Show at most this many low-utilization arenas (default\n\
+        20). Pinning objects are counted for all of them regardless.\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t max_utilization = args.get<size_t>("max-utilization", 10);
+      size_t max_results = args.get<size_t>("max-results", 20);
+      using Pool = PymallocPoolHeader;
+
+      std::vector<std::vector<MappedPtr<Pool>>> thread_pools;
+      thread_pools.resize(shell.max_threads);
+      shell.env.r.map_all_addresses<Pool>(
+          [&](const Pool& pool, MappedPtr<Pool> addr, size_t thread_index) -> void {
+            if (!pool.invalid_reason(shell.env.r, addr)) {
+              thread_pools[thread_index].emplace_back(addr);
+            }
+          },
+          Pool::MIN_POOL_SIZE, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+      struct SizeClassStats {
+        size_t num_pools = 0;
+        size_t num_empty_pools = 0;
+        size_t num_blocks = 0;
+        size_t capacity = 0;
+      };
+      struct ArenaStats {
+        MappedPtr<Pool> first_pool;
+        size_t arena_size = 0;
+        size_t num_pools = 0;
+        size_t allocated_bytes = 0;
+        std::vector<MappedPtr<Pool>> pools;
+      };
+      std::array<SizeClassStats, Pool::NUM_SIZE_CLASSES> size_class_stats;
+      std::map<uint32_t, ArenaStats> arena_stats;
+      for (const auto& pools : thread_pools) {
+        for (auto addr : pools) {
+          const auto& pool = shell.env.r.get(addr);
+          auto& sc_stats = size_class_stats[pool.szidx];
+          sc_stats.num_pools++;
+          sc_stats.num_empty_pools += (pool.ref.count == 0);
+          sc_stats.num_blocks += pool.ref.count;
+          sc_stats.capacity += pool.capacity();
+
+          auto& a_stats = arena_stats[pool.arenaindex];
+          if (a_stats.first_pool.is_null() || (addr < a_stats.first_pool)) {
+            a_stats.first_pool = addr;
+          }
+          a_stats.arena_size = pool.arena_size();
+          a_stats.num_pools++;
+          a_stats.allocated_bytes += pool.ref.count * pool.block_size();
+          a_stats.pools.emplace_back(addr);
+        }
+      }
+
+      phosg::fwrite_fmt(stdout, "By size class:\n");
+      size_t total_allocated_bytes = 0;
+      for (size_t z = 0; z < size_class_stats.size(); z++) {
+        const auto& stats = size_class_stats[z];
+        if (!stats.num_pools) {
+          continue;
+        }
+        size_t block_size = (z + 1) * Pool::ALIGNMENT;
+        total_allocated_bytes += stats.num_blocks * block_size;
+        phosg::fwrite_fmt(stdout, "  {} bytes: {} pools ({} empty), {}/{} blocks used ({}%), {} allocated\n",
+            block_size, stats.num_pools, stats.num_empty_pools, stats.num_blocks, stats.capacity,
+            stats.capacity ? ((stats.num_blocks * 100) / stats.capacity) : 0,
+            phosg::format_size(stats.num_blocks * block_size));
+      }
+
+      // Bucket N contains arenas with utilization in [10N%, 10(N+1)%)
+      std::array<size_t, 11> utilization_histogram{};
+      std::vector<std::pair<size_t, uint32_t>> low_utilization_arenas;
+      for (const auto& [arena_index, stats] : arena_stats) {
+        size_t utilization = (stats.allocated_bytes * 100) / stats.arena_size;
+        utilization_histogram[std::min<size_t>(utilization / 10, 10)]++;
+        if (utilization <= max_utilization) {
+          low_utilization_arenas.emplace_back(stats.allocated_bytes, arena_index);
+        }
+      }
+      phosg::fwrite_fmt(stdout, "By arena utilization:\n");
+      for (size_t z = 0; z < utilization_histogram.size(); z++) {
+        if (z == 10) {
+          phosg::fwrite_fmt(stdout, "  100%: {} arenas\n", utilization_histogram[z]);
+        } else {
+          phosg::fwrite_fmt(stdout, "  {}-{}%: {} arenas\n", z * 10, z * 10 + 9, utilization_histogram[z]);
+        }
+      }
+      size_t arenas_bytes = 0;
+      for (const auto& [_, stats] : arena_stats) {
+        arenas_bytes += stats.arena_size;
+      }
+      phosg::fwrite_fmt(stdout, "{} arenas ({}), {} allocated in pymalloc blocks ({}%)\n",
+          arena_stats.size(), phosg::format_size(arenas_bytes), phosg::format_size(total_allocated_bytes),
+          arenas_bytes ? ((total_allocated_bytes * 100) / arenas_bytes) : 0);
+
+      // Find the objects in the low-utilization arenas. Blocks for GC-tracked objects begin with a PyGC_Head, so the
+      // object may be at the beginning of the block or 0x10 bytes after it.
+      auto name_for_type = names_for_types(shell.env);
+      auto find_block_object = [&](MappedPtr<void> block_addr, size_t block_size) -> MappedPtr<PyObject> {
+        for (size_t offset : {0, 0x10}) {
+          if (offset + sizeof(PyObject) > block_size) {
+            continue;
+          }
+          auto obj_addr = block_addr.offset_bytes(offset).cast<PyObject>();
+          const auto& obj = shell.env.r.get(obj_addr);
+          if (name_for_type.count(obj.ob_type) && (shell.env.r.get(obj.ob_type).is_gc() == (offset != 0))) {
+            return obj_addr;
+          }
+        }
+        return MappedPtr<PyObject>();
+      };
+
+      std::unordered_map<std::string, std::pair<size_t, size_t>> pinning_count_bytes_for_type;
+      std::vector<std::pair<size_t, std::string>> arena_lines;
+      std::sort(low_utilization_arenas.begin(), low_utilization_arenas.end());
+      for (const auto& [allocated_bytes, arena_index] : low_utilization_arenas) {
+        const auto& stats = arena_stats.at(arena_index);
+        std::unordered_map<std::string, size_t> count_for_type;
+        for (auto pool_addr : stats.pools) {
+          const auto& pool = shell.env.r.get(pool_addr);
+          size_t block_size = pool.block_size();
+          try {
+            for (size_t offset : pool.allocated_block_offsets(shell.env.r, pool_addr)) {
+              auto obj_addr = find_block_object(pool_addr.offset_bytes(offset), block_size);
+              const std::string& type_name = obj_addr.is_null()
+                  ? "<non-object>"
+                  : name_for_type.at(shell.env.r.get(obj_addr).ob_type);
+              count_for_type[type_name]++;
+              auto& type_count_bytes = pinning_count_bytes_for_type[type_name];
+              type_count_bytes.first++;
+              type_count_bytes.second += block_size;
+            }
+          } catch (const std::out_of_range&) {
+          }
+        }
+
+        if (arena_lines.size() < max_results) {
+          std::vector<std::pair<size_t, std::string>> sorted_types;
+          for (const auto& [type_name, count] : count_for_type) {
+            sorted_types.emplace_back(count, type_name);
+          }
+          std::sort(sorted_types.rbegin(), sorted_types.rend());
+          std::vector<std::string> type_strs;
+          for (const auto& [count, type_name] : sorted_types) {
+            type_strs.emplace_back(std::format("{} {}", count, type_name));
+          }
+          arena_lines.emplace_back(allocated_bytes, std::format("  arena {} (first pool @ {}; {} pools): {} used ({})\n",
+              arena_index, stats.first_pool, stats.num_pools, phosg::format_size(allocated_bytes),
+              phosg::join(type_strs, ", ")));
+        }
+      }
+
+      phosg::fwrite_fmt(stdout, "{} arenas at or below {}% utilization; least utilized:\n",
+          low_utilization_arenas.size(), max_utilization);
+      for (auto it = arena_lines.rbegin(); it != arena_lines.rend(); it++) {
+        phosg::fwrite_fmt(stdout, "{}", it->second);
+      }
+
+      std::vector<std::tuple<size_t, size_t, std::string>> sorted_pinning_types;
+      for (const auto& [type_name, count_bytes] : pinning_count_bytes_for_type) {
+        sorted_pinning_types.emplace_back(count_bytes.second, count_bytes.first, type_name);
+      }
+      std::sort(sorted_pinning_types.begin(), sorted_pinning_types.end());
+      phosg::fwrite_fmt(stdout, "Objects pinning low-utilization arenas, by type:\n");
+      for (const auto& [bytes, count, type_name] : sorted_pinning_types) {
+        phosg::fwrite_fmt(stdout, "  ({} objects, {}) {}\n", count, phosg::format_size(bytes), type_name);
+      }
+    });
+
+ShellCommand c_malloc_heaps(
+    "malloc-heaps", "\
+  malloc-heaps [OPTIONS]\n\
+    Finds and walks all glibc malloc heaps (the main heap, the heaps of other\n\
+    arenas, and chunks allocated directly with mmap), and attributes each\n\
+    in-use chunk to the Python object that owns it, where possible. This covers\n\
+    memory that pymalloc doesn't manage: objects and buffers larger than 512\n\
+    bytes (e.g. list item arrays and large dict key tables), and memory\n\
+    allocated by extension modules. Options:\n\
+      --max-results=N: Show at most this many owner types (default 40).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t max_results = args.get<size_t>("max-results", 40);
+      using Heap = GlibcMallocHeap;
+      using ChunkState = Heap::ChunkState;
+
+      auto heaps = find_glibc_malloc_heaps(shell.env.r);
+      std::vector<const Heap::Chunk*> in_use_chunks;
+      for (const auto& heap : heaps) {
+        for (const auto& chunk : heap.chunks) {
+          if (chunk.state == ChunkState::IN_USE) {
+            in_use_chunks.emplace_back(&chunk);
+          }
+        }
+      }
+      // Heaps are sorted by address and chunks are in address order within each heap, so this is already sorted
+      auto find_in_use_chunk = [&](MappedPtr<void> user_addr) -> ssize_t {
+        auto it = std::lower_bound(in_use_chunks.begin(), in_use_chunks.end(), user_addr, [](const auto* chunk, const auto& addr) -> bool {
+          return chunk->user_addr() < addr;
+        });
+        return ((it != in_use_chunks.end()) && ((*it)->user_addr() == user_addr)) ? (it - in_use_chunks.begin()) : -1;
+      };
+
+      // Find the owner of each chunk. The owner is either an object allocated in the chunk (GC-tracked objects are
+      // preceded by a PyGC_Head, so the object is 0x10 bytes after the chunk's user data), or an object that owns an
+      // out-of-line allocation there.
+      using Owner = std::pair<MappedPtr<PyTypeObject>, const char*>;
+      auto name_for_type = names_for_types(shell.env);
+      std::vector<std::vector<std::pair<size_t, Owner>>> thread_owners;
+      thread_owners.resize(shell.max_threads);
+      if (!in_use_chunks.empty()) {
+        shell.env.r.map_all_addresses<PyObject>(
+            [&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+              if (!name_for_type.count(obj.ob_type) || shell.env.invalid_reason(addr)) {
+                return;
+              }
+              try {
+                auto& owners = thread_owners[thread_index];
+                size_t gc_header_size = shell.env.r.get(obj.ob_type).is_gc() ? 0x10 : 0;
+                ssize_t chunk_index = find_in_use_chunk(addr.offset_bytes(-static_cast<ssize_t>(gc_header_size)));
+                if (chunk_index >= 0) {
+                  owners.emplace_back(chunk_index, Owner(obj.ob_type, nullptr));
+                }
+                for (const auto& [field_name, alloc_addr] : shell.env.owned_allocations(addr)) {
+                  chunk_index = find_in_use_chunk(alloc_addr);
+                  if (chunk_index >= 0) {
+                    owners.emplace_back(chunk_index, Owner(obj.ob_type, field_name));
+                  }
+                }
+              } catch (const std::out_of_range&) {
+              }
+            },
+            8, shell.max_threads);
+        phosg::fwrite_fmt(stderr, CLEAR_LINE);
+      }
+
+      std::vector<Owner> chunk_owners(in_use_chunks.size(), Owner(MappedPtr<PyTypeObject>(), nullptr));
+      for (const auto& owners : thread_owners) {
+        for (const auto& [chunk_index, owner] : owners) {
+          if (chunk_owners[chunk_index].first.is_null()) {
+            chunk_owners[chunk_index] = owner;
+          }
+        }
+      }
+
+      static const std::array<const char*, 3> kind_names = {"main heap", "arena heap", "mmapped chunks"};
+      std::array<size_t, 5> total_bytes_for_state{};
+      size_t total_bytes = 0;
+      phosg::fwrite_fmt(stdout, "Heaps:\n");
+      for (const auto& heap : heaps) {
+        std::array<size_t, 5> bytes_for_state{};
+        for (const auto& chunk : heap.chunks) {
+          bytes_for_state[static_cast<size_t>(chunk.state)] += chunk.size;
+        }
+        for (size_t z = 0; z < bytes_for_state.size(); z++) {
+          total_bytes_for_state[z] += bytes_for_state[z];
+        }
+        total_bytes += heap.size;
+        std::string arena_str = heap.arena.is_null() ? "" : std::format(" (arena @ {})", heap.arena);
+        phosg::fwrite_fmt(stdout, "  {} @ {}{}: {}, {} chunks; {} in use, {} free, {} in tcache/fastbins, {} top{}\n",
+            kind_names[static_cast<size_t>(heap.kind)], heap.start, arena_str, phosg::format_size(heap.size),
+            heap.chunks.size(), phosg::format_size(bytes_for_state[static_cast<size_t>(ChunkState::IN_USE)]),
+            phosg::format_size(bytes_for_state[static_cast<size_t>(ChunkState::FREE)]),
+            phosg::format_size(bytes_for_state[static_cast<size_t>(ChunkState::CACHED)]),
+            phosg::format_size(bytes_for_state[static_cast<size_t>(ChunkState::TOP)]),
+            heap.walk_complete ? "" : " (walk incomplete)");
+      }
+      // Free chunks other than the top chunk are fragmentation: malloc can't return them to the OS
+      size_t fragmented_bytes = total_bytes_for_state[static_cast<size_t>(ChunkState::FREE)] +
+          total_bytes_for_state[static_cast<size_t>(ChunkState::CACHED)];
+      phosg::fwrite_fmt(stdout, "{} heaps, {}: {} in use, {} fragmented ({}%), {} top\n",
+          heaps.size(), phosg::format_size(total_bytes),
+          phosg::format_size(total_bytes_for_state[static_cast<size_t>(ChunkState::IN_USE)]),
+          phosg::format_size(fragmented_bytes), total_bytes ? ((fragmented_bytes * 100) / total_bytes) : 0,
+          phosg::format_size(total_bytes_for_state[static_cast<size_t>(ChunkState::TOP)]));
+
+      std::map<std::string, std::pair<size_t, size_t>> count_bytes_for_owner;
+      // Bucket N contains unattributed chunks with sizes in [2^(N-1), 2^N)
+      std::vector<std::pair<size_t, size_t>> unattributed_count_bytes_for_bucket;
+      for (size_t z = 0; z < in_use_chunks.size(); z++) {
+        const auto& [type_addr, field_name] = chunk_owners[z];
+        size_t size = in_use_chunks[z]->size;
+        if (type_addr.is_null()) {
+          size_t bucket = std::bit_width(size);
+          if (unattributed_count_bytes_for_bucket.size() <= bucket) {
+            unattributed_count_bytes_for_bucket.resize(bucket + 1, std::make_pair(0, 0));
+          }
+          unattributed_count_bytes_for_bucket[bucket].first++;
+          unattributed_count_bytes_for_bucket[bucket].second += size;
+        } else {
+          const std::string& type_name = name_for_type.at(type_addr);
+          auto& count_bytes = count_bytes_for_owner[field_name ? std::format("{}.{}", type_name, field_name) : type_name];
+          count_bytes.first++;
+          count_bytes.second += size;
+        }
+      }
+
+      std::vector<std::tuple<size_t, size_t, std::string>> sorted_owners;
+      for (const auto& [owner_name, count_bytes] : count_bytes_for_owner) {
+        sorted_owners.emplace_back(count_bytes.second, count_bytes.first, owner_name);
+      }
+      std::sort(sorted_owners.begin(), sorted_owners.end());
+      if (sorted_owners.size() > max_results) {
+        sorted_owners.erase(sorted_owners.begin(), sorted_owners.end() - max_results);
+      }
+      phosg::fwrite_fmt(stdout, "In-use chunks by owner:\n");
+      for (const auto& [bytes, count, owner_name] : sorted_owners) {
+        phosg::fwrite_fmt(stdout, "  ({} chunks, {}) {}\n", count, phosg::format_size(bytes), owner_name);
+      }
+
+      size_t unattributed_count = 0, unattributed_bytes = 0;
+      phosg::fwrite_fmt(stdout, "Unattributed in-use chunks by size:\n");
+      for (size_t z = 1; z < unattributed_count_bytes_for_bucket.size(); z++) {
+        const auto& [count, bytes] = unattributed_count_bytes_for_bucket[z];
+        if (count) {
+          phosg::fwrite_fmt(stdout, "  {}-{} bytes: {} chunks, {}\n",
+              1ULL << (z - 1), (1ULL << z) - 1, count, phosg::format_size(bytes));
+          unattributed_count += count;
+          unattributed_bytes += bytes;
+        }
+      }
+      phosg::fwrite_fmt(stdout, "Unattributed: {} chunks, {}\n", unattributed_count, phosg::format_size(unattributed_bytes));
+    });
+
+ShellCommand c_tracemalloc_traces(
+    "tracemalloc-traces", "\
+  tracemalloc-traces [OPTIONS]\n\
+    If tracemalloc was running in the target process, finds its trace tables\n\
+    and groups all traced memory blocks, and the objects allocated in them, by\n\
+    the source location that allocated them. This is equivalent to calling\n\
+    tracemalloc.take_snapshot() in the target process, but works on snapshots\n\
+    taken without any cooperation from the process. Options:\n\
+      --frames=N: Group by the N most recent frames of each allocation's\n\
+        traceback (default 1). Tracebacks only include as many frames as\n\
+        tracemalloc was configured to record.\n\
+      --max-results=N: Show this many locations (default 30).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t num_frames = args.get<size_t>("frames", 1);
+      size_t max_results = args.get<size_t>("max-results", 30);
+      auto str_type = shell.env.get_type("str");
+
+      // tracemalloc's tables are static variables, so we can't find them directly without symbols. Instead, we find
+      // all hashtables and look at their entries to determine which ones are trace tables.
+      std::vector<std::vector<MappedPtr<PyHashtable>>> thread_tables;
+      thread_tables.resize(shell.max_threads);
+      shell.env.r.map_all_addresses<PyHashtable>(
+          [&](const PyHashtable& table, MappedPtr<PyHashtable> addr, size_t thread_index) -> void {
+            if (!table.invalid_reason(shell.env.r)) {
+              thread_tables[thread_index].emplace_back(addr);
+            }
+          },
+          0x10, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+
+      auto is_traces_table = [&](const PyHashtable& table) -> bool {
+        if (table.nentries == 0) {
+          return false;
+        }
+        size_t num_checked = 0;
+        bool all_valid = true;
+        try {
+          table.for_each_entry(shell.env.r, [&](MappedPtr<void>, MappedPtr<void> value) -> void {
+            if (!all_valid || (num_checked >= 0x10)) {
+              return;
+            }
+            num_checked++;
+            const auto& trace = shell.env.r.get(value.cast<TracemallocTrace>());
+            all_valid = !trace.invalid_reason(shell.env.r) &&
+                (shell.env.r.get(get_tracemalloc_frames(shell.env.r, trace.traceback).at(0).filename).ob_type == str_type);
+          });
+        } catch (const std::out_of_range&) {
+          return false;
+        }
+        return all_valid;
+      };
+
+      std::unordered_set<MappedPtr<PyHashtable>> traces_tables;
+      for (const auto& tables : thread_tables) {
+        for (auto table_addr : tables) {
+          if (is_traces_table(shell.env.r.get(table_addr))) {
+            traces_tables.emplace(table_addr);
+          }
+        }
+      }
+      // tracemalloc_domains maps each domain other than 0 to its traces table. Blocks traced in other domains
+      // (e.g. by numpy, via PyTraceMalloc_Track) don't correspond to Python objects, but we still count them.
+      std::unordered_map<MappedPtr<PyHashtable>, uint64_t> domain_for_table;
+      for (const auto& tables : thread_tables) {
+        for (auto table_addr : tables) {
+          if (traces_tables.count(table_addr)) {
+            continue;
+          }
+          try {
+            std::unordered_map<MappedPtr<PyHashtable>, uint64_t> table_domains;
+            bool all_traces_tables = true;
+            shell.env.r.get(table_addr).for_each_entry(shell.env.r, [&](MappedPtr<void> key, MappedPtr<void> value) -> void {
+              if (traces_tables.count(value.cast<PyHashtable>())) {
+                table_domains.emplace(value.cast<PyHashtable>(), key.addr);
+              } else {
+                all_traces_tables = false;
+              }
+            });
+            if (all_traces_tables) {
+              domain_for_table.insert(table_domains.begin(), table_domains.end());
+            }
+          } catch (const std::out_of_range&) {
+          }
+        }
+      }
+      if (traces_tables.empty()) {
+        throw std::runtime_error("No tracemalloc traces were found; tracemalloc may not have been running");
+      }
+
+      struct TraceInfo {
+        uint64_t domain;
+        uint64_t size;
+        MappedPtr<void> traceback;
+      };
+      std::unordered_map<MappedPtr<void>, TraceInfo> trace_for_block;
+      for (auto table_addr : traces_tables) {
+        auto domain_it = domain_for_table.find(table_addr);
+        uint64_t domain = (domain_it == domain_for_table.end()) ? 0 : domain_it->second;
+        try {
+          shell.env.r.get(table_addr).for_each_entry(shell.env.r, [&](MappedPtr<void> key, MappedPtr<void> value) -> void {
+            const auto& trace = shell.env.r.get(value.cast<TracemallocTrace>());
+            if (!trace.invalid_reason(shell.env.r)) {
+              trace_for_block.emplace(key, TraceInfo{.domain = domain, .size = trace.size, .traceback = trace.traceback});
+            }
+          });
+        } catch (const std::out_of_range&) {
+          phosg::fwrite_fmt(stderr, "Warning: traces table at {} is corrupt\n", table_addr);
+        }
+      }
+      phosg::fwrite_fmt(stderr, "Found {} traces in {} tables\n", trace_for_block.size(), traces_tables.size());
+
+      // Find the object allocated in each traced block, if any (GC-tracked objects are preceded by a PyGC_Head)
+      auto name_for_type = names_for_types(shell.env);
+      std::vector<std::unordered_map<MappedPtr<void>, MappedPtr<PyTypeObject>>> thread_object_types;
+      thread_object_types.resize(shell.max_threads);
+      shell.env.r.map_all_addresses<PyObject>(
+          [&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+            if (!name_for_type.count(obj.ob_type)) {
+              return;
+            }
+            try {
+              size_t gc_header_size = shell.env.r.get(obj.ob_type).is_gc() ? 0x10 : 0;
+              auto block_addr = addr.offset_bytes(-static_cast<ssize_t>(gc_header_size)).cast<void>();
+              if (trace_for_block.count(block_addr) && !shell.env.invalid_reason(addr)) {
+                thread_object_types[thread_index].emplace(block_addr, obj.ob_type);
+              }
+            } catch (const std::out_of_range&) {
+            }
+          },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+      std::unordered_map<MappedPtr<void>, MappedPtr<PyTypeObject>> object_type_for_block;
+      for (const auto& object_types : thread_object_types) {
+        object_type_for_block.insert(object_types.begin(), object_types.end());
+      }
+
+      struct LocationStats {
+        size_t num_blocks = 0;
+        size_t bytes = 0;
+        size_t num_objects = 0;
+        size_t object_bytes = 0;
+        std::unordered_map<MappedPtr<PyTypeObject>, size_t> count_for_type;
+      };
+      std::unordered_map<MappedPtr<PyObject>, std::string> filename_for_str;
+      std::unordered_map<MappedPtr<void>, std::string> location_for_traceback;
+      std::unordered_map<std::string, LocationStats> stats_for_location;
+      for (const auto& [block_addr, trace] : trace_for_block) {
+        auto location_it = location_for_traceback.find(trace.traceback);
+        if (location_it == location_for_traceback.end()) {
+          std::vector<std::string> frame_strs;
+          for (const auto& frame : get_tracemalloc_frames(shell.env.r, trace.traceback)) {
+            if (frame_strs.size() >= num_frames) {
+              break;
+            }
+            auto filename_it = filename_for_str.find(frame.filename);
+            if (filename_it == filename_for_str.end()) {
+              std::string filename;
+              try {
+                filename = decode_string_types(shell.env.r, frame.filename);
+              } catch (const std::exception&) {
+                filename = std::format("<filename@{}>", frame.filename);
+              }
+              filename_it = filename_for_str.emplace(frame.filename, std::move(filename)).first;
+            }
+            frame_strs.emplace_back(std::format("{}:{}", filename_it->second, frame.lineno));
+          }
+          std::string location = phosg::join(frame_strs, " <- ");
+          if (trace.domain != 0) {
+            location = std::format("[domain {}] {}", trace.domain, location);
+          }
+          location_it = location_for_traceback.emplace(trace.traceback, std::move(location)).first;
+        }
+
+        auto& stats = stats_for_location[location_it->second];
+        stats.num_blocks++;
+        stats.bytes += trace.size;
+        auto type_it = object_type_for_block.find(block_addr);
+        if ((trace.domain == 0) && (type_it != object_type_for_block.end())) {
+          stats.num_objects++;
+          stats.object_bytes += trace.size;
+          stats.count_for_type[type_it->second]++;
+        }
+      }
+
+      std::vector<std::pair<size_t, const std::string*>> sorted_locations;
+      size_t total_bytes = 0, total_object_bytes = 0;
+      for (const auto& [location, stats] : stats_for_location) {
+        sorted_locations.emplace_back(stats.bytes, &location);
+        total_bytes += stats.bytes;
+        total_object_bytes += stats.object_bytes;
+      }
+      std::sort(sorted_locations.begin(), sorted_locations.end());
+      if (sorted_locations.size() > max_results) {
+        sorted_locations.erase(sorted_locations.begin(), sorted_locations.end() - max_results);
+      }
+      for (const auto& [bytes, location] : sorted_locations) {
+        const auto& stats = stats_for_location.at(*location);
+        std::vector<std::pair<size_t, MappedPtr<PyTypeObject>>> sorted_types;
+        for (const auto& [type_addr, count] : stats.count_for_type) {
+          sorted_types.emplace_back(count, type_addr);
+        }
+        std::sort(sorted_types.rbegin(), sorted_types.rend());
+        std::vector<std::string> type_strs;
+        for (const auto& [count, type_addr] : sorted_types) {
+          if (type_strs.size() >= 4) {
+            type_strs.emplace_back("...");
+            break;
+          }
+          type_strs.emplace_back(std::format("{} {}", count, name_for_type.at(type_addr)));
+        }
+        phosg::fwrite_fmt(stdout, "({} blocks, {}; {} objects, {}) {}{}{}\n",
+            stats.num_blocks, phosg::format_size(stats.bytes), stats.num_objects, phosg::format_size(stats.object_bytes),
+            *location, type_strs.empty() ? "" : ": ", phosg::join(type_strs, ", "));
+      }
+      phosg::fwrite_fmt(stdout, "{} traced blocks, {} ({} in objects) from {} locations\n",
+          trace_for_block.size(), phosg::format_size(total_bytes), phosg::format_size(total_object_bytes),
+          stats_for_location.size());
+    });
+
+ShellCommand c_gc_generations(
+    "gc-generations", "\
+  gc-generations [OPTIONS]\n\
+    Finds the garbage collector state of each interpreter and walks its\n\
+    generation lists. Shows each generation's object count, size, threshold\n\
+    and count state, and the types with the most objects, and estimates how\n\
+    many objects the next collection of each generation will traverse. This can\n\
+    help with tuning gc.set_threshold or deciding whether to use gc.freeze.\n\
+    Options:\n\
+      --max-types=N: Show this many types per generation (default 10).\n\
+      --max-objects=N: Stop walking each generation after this many objects\n\
+        (default 100000000).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t max_types = args.get<size_t>("max-types", 10);
+      size_t max_objects = args.get<size_t>("max-objects", 100000000);
+
+      std::mutex results_lock;
+      std::vector<MappedPtr<PyGCRuntimeState>> gc_states;
+      shell.env.r.map_all_addresses<PyGCRuntimeState>(
+          [&](const PyGCRuntimeState& gc, MappedPtr<PyGCRuntimeState> addr, size_t) -> void {
+            if (!gc.invalid_reason(shell.env, addr)) {
+              std::lock_guard<std::mutex> g(results_lock);
+              gc_states.emplace_back(addr);
+            }
+          },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+      if (gc_states.empty()) {
+        throw std::runtime_error("No GC state was found");
+      }
+      std::sort(gc_states.begin(), gc_states.end());
+
+      struct GenerationStats {
+        size_t num_objects = 0;
+        size_t bytes = 0;
+        bool walk_complete = false;
+        std::unordered_map<MappedPtr<PyTypeObject>, std::pair<size_t, size_t>> count_bytes_for_type;
+      };
+      auto name_for_type = names_for_types(shell.env);
+      auto walk_generation = [&](const PyGCGeneration& gen, MappedPtr<PyGCHead> head_addr) -> GenerationStats {
+        GenerationStats ret;
+        try {
+          for (auto node_addr = gen.head.next(); ret.num_objects < max_objects; ret.num_objects++) {
+            if (node_addr == head_addr) {
+              ret.walk_complete = true;
+              break;
+            }
+            auto obj_addr = PyGCHead::object_for_head(node_addr);
+            const auto& obj = shell.env.r.get(obj_addr);
+            size_t size = 0;
+            if (name_for_type.count(obj.ob_type) && !obj.invalid_reason(shell.env)) {
+              try {
+                size = shell.env.shallow_size(obj_addr);
+              } catch (const std::out_of_range&) {
+                size = shell.env.r.get(obj.ob_type).tp_basicsize + sizeof(PyGCHead);
+              }
+            }
+            auto& type_count_bytes = ret.count_bytes_for_type[obj.ob_type];
+            type_count_bytes.first++;
+            type_count_bytes.second += size;
+            ret.bytes += size;
+            node_addr = shell.env.r.get(node_addr).next();
+          }
+        } catch (const std::out_of_range&) {
+        }
+        return ret;
+      };
+
+      for (auto gc_addr : gc_states) {
+        const auto& gc = shell.env.r.get(gc_addr);
+        phosg::fwrite_fmt(stdout, "GC state @ {}: {}{}\n", gc_addr, gc.enabled ? "enabled" : "disabled",
+            gc.collecting ? " (a collection was in progress; lists may be inconsistent)" : "");
+
+        std::array<GenerationStats, PyGCRuntimeState::NUM_GENERATIONS + 1> gen_stats;
+        for (size_t z = 0; z <= PyGCRuntimeState::NUM_GENERATIONS; z++) {
+          bool is_permanent = (z == PyGCRuntimeState::NUM_GENERATIONS);
+          const auto& gen = is_permanent ? gc.permanent_generation : gc.generations[z];
+          auto head_addr = gc_addr.offset_bytes(is_permanent
+                  ? offsetof(PyGCRuntimeState, permanent_generation)
+                  : (offsetof(PyGCRuntimeState, generations) + z * sizeof(PyGCGeneration)))
+                               .cast<PyGCHead>();
+          auto& stats = gen_stats[z];
+          stats = walk_generation(gen, head_addr);
+
+          if (is_permanent) {
+            phosg::fwrite_fmt(stdout, "  permanent generation (gc.freeze): {} objects, {}{}\n",
+                stats.num_objects, phosg::format_size(stats.bytes), stats.walk_complete ? "" : " (walk incomplete)");
+          } else {
+            const auto& gen_stats_z = gc.generation_stats[z];
+            phosg::fwrite_fmt(stdout, "  generation {}: {} objects, {}{}; count={} threshold={}; {} collections, {} collected, {} uncollectable\n",
+                z, stats.num_objects, phosg::format_size(stats.bytes), stats.walk_complete ? "" : " (walk incomplete)",
+                gen.count, gen.threshold, gen_stats_z.collections, gen_stats_z.collected, gen_stats_z.uncollectable);
+          }
+
+          std::vector<std::tuple<size_t, size_t, MappedPtr<PyTypeObject>>> sorted_types;
+          for (const auto& [type_addr, count_bytes] : stats.count_bytes_for_type) {
+            sorted_types.emplace_back(count_bytes.first, count_bytes.second, type_addr);
+          }
+          std::sort(sorted_types.begin(), sorted_types.end());
+          if (sorted_types.size() > max_types) {
+            sorted_types.erase(sorted_types.begin(), sorted_types.end() - max_types);
+          }
+          for (const auto& [count, bytes, type_addr] : sorted_types) {
+            auto name_it = name_for_type.find(type_addr);
+            phosg::fwrite_fmt(stdout, "    ({} objects, {}) {}\n", count, phosg::format_size(bytes),
+                (name_it == name_for_type.end()) ? std::format("<type@{}>", type_addr) : name_it->second);
+          }
+        }
+
+        // Collecting generation N also collects all younger generations, so it traverses all of their objects. A
+        // collection of generation N happens at the next generation-0 collection after generations[N].count exceeds
+        // its threshold; full collections additionally require long_lived_pending to be at least 25% of
+        // long_lived_total (see collect_generations in gcmodule.c).
+        phosg::fwrite_fmt(stdout, "  Next collections:\n");
+        size_t objects_to_traverse = 0;
+        for (size_t z = 0; z < PyGCRuntimeState::NUM_GENERATIONS; z++) {
+          const auto& gen = gc.generations[z];
+          objects_to_traverse += gen_stats[z].num_objects;
+          int64_t remaining = std::max<int64_t>(static_cast<int64_t>(gen.threshold) - gen.count, 0) + 1;
+          std::string trigger_str;
+          if (z == 0) {
+            trigger_str = std::format("after about {} more net container allocations", remaining);
+          } else {
+            trigger_str = std::format("after {} more generation {} collections", remaining, z - 1);
+          }
+          if (z == PyGCRuntimeState::NUM_GENERATIONS - 1) {
+            bool pending_ok = (gc.long_lived_pending >= gc.long_lived_total / 4);
+            trigger_str += std::format(" ({}: long_lived_pending={}, long_lived_total={})",
+                pending_ok ? "not deferred" : "deferred until long_lived_pending reaches 25% of long_lived_total",
+                gc.long_lived_pending, gc.long_lived_total);
+          }
+          phosg::fwrite_fmt(stdout, "    generation {}: {}; will traverse {} objects\n", z, trigger_str, objects_to_traverse);
+        }
+      }
+    });
+
+ShellCommand c_event_loop_backlog(
+    "event-loop-backlog", "\
+  event-loop-backlog [OPTIONS]\n\
+    Finds all asyncio event loops (instances of subclasses of BaseEventLoop)\n\
+    and decodes their ready queues (the _ready deque of Handles) and timer\n\
+    heaps (the _scheduled list of TimerHandles). Shows the depth of each, how\n\
+    many handles are cancelled, the callbacks that appear most often, and when\n\
+    the timers are due. A deep ready queue means the loop is saturated; many\n\
+    cancelled timers mean they're being cancelled faster than they're cleaned\n\
+    up. The loop's clock isn't stored in the loop, so timer due times are shown\n\
+    relative to the earliest timer unless --now is given. Options:\n\
+      --now=SECONDS: The loop clock's value (time.monotonic() in the target\n\
+        process, for the default loop) at the time the snapshot was taken.\n\
+      --max-callbacks=N: Show this many callbacks per queue (default 10).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t max_callbacks = args.get<size_t>("max-callbacks", 10);
+      std::string now_str = args.get<std::string>("now", false);
+      std::optional<double> now;
+      if (!now_str.empty()) {
+        now = std::stod(now_str);
+      }
+
+      auto loop_types = subclasses_of(shell.env, {"BaseEventLoop"}, "asyncio.");
+      if (loop_types.empty()) {
+        throw std::runtime_error("No event loop types were found; run find-all-types first");
+      }
+      auto loop_addrs = find_instances_of_types(shell, loop_types);
+      auto float_type = shell.env.get_type_if_exists("float");
+      auto list_type = shell.env.get_type_if_exists("list");
+      auto deque_type = shell.env.get_type_if_exists("collections.deque");
+
+      // Cancelled handles have their callbacks cleared, so they're grouped together instead of by callback
+      auto callback_name_for_handle = [&](MappedPtr<PyObject> handle_addr, bool* is_cancelled) -> std::string {
+        *is_cancelled = is_truthy_int(shell.env, shell.env.get_attribute(handle_addr, "_cancelled"));
+        return *is_cancelled ? "<cancelled>" : describe_callable(shell.env, shell.env.get_attribute(handle_addr, "_callback"));
+      };
+      auto print_top_callbacks = [&](const std::unordered_map<std::string, size_t>& count_for_callback) -> void {
+        std::vector<std::pair<size_t, std::string>> sorted_callbacks;
+        for (const auto& [name, count] : count_for_callback) {
+          sorted_callbacks.emplace_back(count, name);
+        }
+        std::sort(sorted_callbacks.begin(), sorted_callbacks.end());
+        if (sorted_callbacks.size() > max_callbacks) {
+          sorted_callbacks.erase(sorted_callbacks.begin(), sorted_callbacks.end() - max_callbacks);
+        }
+        for (const auto& [count, name] : sorted_callbacks) {
+          phosg::fwrite_fmt(stdout, "    ({} handles) {}\n", count, name);
+        }
+      };
+
+      size_t num_loops = 0;
+      for (auto loop_addr : loop_addrs) {
+        auto ready_addr = shell.env.get_attribute(loop_addr, "_ready");
+        auto scheduled_addr = shell.env.get_attribute(loop_addr, "_scheduled");
+        if (ready_addr.is_null() || scheduled_addr.is_null() ||
+            shell.env.invalid_reason(ready_addr, deque_type) || shell.env.invalid_reason(scheduled_addr, list_type)) {
+          continue;
+        }
+        num_loops++;
+
+        const auto& loop_obj = shell.env.r.get(loop_addr);
+        phosg::fwrite_fmt(stdout, "Event loop @ {} ({}){}{}\n", loop_addr,
+            shell.env.r.get(loop_obj.ob_type).name(shell.env.r),
+            is_truthy_int(shell.env, shell.env.get_attribute(loop_addr, "_closed")) ? " closed" : "",
+            is_truthy_int(shell.env, shell.env.get_attribute(loop_addr, "_stopping")) ? " stopping" : "");
+
+        const auto& ready = shell.env.r.get(ready_addr.cast<PyDequeObject>());
+        std::unordered_map<std::string, size_t> ready_count_for_callback;
+        size_t ready_cancelled = 0;
+        for (auto handle_addr : ready.get_items(shell.env.r)) {
+          bool is_cancelled;
+          ready_count_for_callback[callback_name_for_handle(handle_addr, &is_cancelled)]++;
+          ready_cancelled += is_cancelled;
+        }
+        phosg::fwrite_fmt(stdout, "  Ready queue @ {}: {} handles ({} cancelled)\n", ready_addr, ready.ob_size, ready_cancelled);
+        print_top_callbacks(ready_count_for_callback);
+
+        const auto& scheduled = shell.env.r.get(scheduled_addr.cast<PyListObject>());
+        std::unordered_map<std::string, size_t> timer_count_for_callback;
+        std::vector<double> when_values;
+        size_t timers_cancelled = 0;
+        for (auto handle_addr : scheduled.get_items(shell.env.r)) {
+          bool is_cancelled;
+          timer_count_for_callback[callback_name_for_handle(handle_addr, &is_cancelled)]++;
+          timers_cancelled += is_cancelled;
+          auto when_addr = shell.env.get_attribute(handle_addr, "_when");
+          if (!when_addr.is_null() && !is_cancelled && !shell.env.invalid_reason(when_addr, float_type)) {
+            when_values.emplace_back(shell.env.r.get(when_addr.cast<PyFloatObject>()).ob_fval);
+          }
+        }
+        phosg::fwrite_fmt(stdout, "  Timer heap @ {}: {} timers ({} cancelled; _timer_cancelled_count={})\n",
+            scheduled_addr, scheduled.ob_size, timers_cancelled,
+            int_attribute_str(shell.env, loop_addr, "_timer_cancelled_count"));
+        print_top_callbacks(timer_count_for_callback);
+
+        if (!when_values.empty()) {
+          auto [min_it, max_it] = std::minmax_element(when_values.begin(), when_values.end());
+          double reference = now.value_or(*min_it);
+          phosg::fwrite_fmt(stdout, "  Uncancelled timers are due from {:+.3f}s to {:+.3f}s relative to {} (loop time {:.3f}):\n",
+              *min_it - reference, *max_it - reference, now.has_value() ? "--now" : "the earliest timer", reference);
+          // Bucket 0 is for overdue timers; bucket N (N >= 1) is for timers due in [2^(N-2), 2^(N-1)) milliseconds
+          std::vector<size_t> bucket_counts;
+          for (double when : when_values) {
+            size_t bucket = (when < reference) ? 0 : (std::bit_width(static_cast<uint64_t>((when - reference) * 1000.0)) + 1);
+            if (bucket_counts.size() <= bucket) {
+              bucket_counts.resize(bucket + 1, 0);
+            }
+            bucket_counts[bucket]++;
+          }
+          for (size_t z = 0; z < bucket_counts.size(); z++) {
+            if (!bucket_counts[z]) {
+              continue;
+            }
+            if (z == 0) {
+              phosg::fwrite_fmt(stdout, "    overdue: {}\n", bucket_counts[z]);
+            } else if (z == 1) {
+              phosg::fwrite_fmt(stdout, "    due in [0ms, 1ms): {}\n", bucket_counts[z]);
+            } else {
+              phosg::fwrite_fmt(stdout, "    due in [{}ms, {}ms): {}\n", 1ULL << (z - 2), 1ULL << (z - 1), bucket_counts[z]);
+            }
+          }
+        }
+      }
+      phosg::fwrite_fmt(stderr, "{} event loops found\n", num_loops);
+    });
+
+ShellCommand c_async_contention(
+    "async-contention", "\
+  async-contention [OPTIONS]\n\
+    Finds all asyncio synchronization primitives (Lock, Semaphore, Event,\n\
+    Condition, and Queue, and their subclasses) and decodes their waiter\n\
+    queues. Each waiter future is linked back to the task awaiting it, and the\n\
+    waiting tasks are grouped by where they're suspended. Queues also show how\n\
+    many items they contain and their maximum size. The primitives with the\n\
+    most waiters are shown last. Options:\n\
+      --min-waiters=N: Only show primitives with at least this many waiters\n\
+        (default 1). Queues are shown if they have at least this many waiters\n\
+        or items.\n\
+      --max-results=N: Show at most this many primitives (default 20).\n\
+      --max-locations=N: Show at most this many await locations per primitive\n\
+        (default 5).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t min_waiters = args.get<size_t>("min-waiters", 1);
+      size_t max_results = args.get<size_t>("max-results", 20);
+      size_t max_locations = args.get<size_t>("max-locations", 5);
+
+      static const std::vector<std::string> kind_names = {"Lock", "Semaphore", "Event", "Condition", "Queue"};
+      auto primitive_types = subclasses_of(shell.env, kind_names, "asyncio.");
+      if (primitive_types.empty()) {
+        throw std::runtime_error("No asyncio synchronization types were found; run find-all-types first");
+      }
+      auto primitive_addrs = find_instances_of_types(shell, primitive_types);
+      auto task_for_future = tasks_by_awaited_future(shell);
+      auto deque_type = shell.env.get_type_if_exists("collections.deque");
+      auto list_type = shell.env.get_type_if_exists("list");
+
+      // Waiter queues are None until first used in some Python versions, so a missing deque just means no waiters
+      auto deque_items = [&](MappedPtr<PyObject> addr) -> std::vector<MappedPtr<PyObject>> {
+        if (addr.is_null() || shell.env.invalid_reason(addr, deque_type)) {
+          return {};
+        }
+        return shell.env.r.get(addr.cast<PyDequeObject>()).get_items(shell.env.r);
+      };
+
+      struct PrimitiveInfo {
+        MappedPtr<PyObject> addr;
+        std::string kind;
+        std::string state;
+        size_t num_waiters = 0;
+        size_t num_items = 0;
+        size_t num_orphan_waiters = 0; // Waiters with no task awaiting them (e.g. already cancelled)
+        std::unordered_map<std::string, size_t> count_for_location;
+      };
+      std::vector<PrimitiveInfo> results;
+      for (auto addr : primitive_addrs) {
+        const auto& type_obj = shell.env.r.get(shell.env.r.get(addr).ob_type);
+        PrimitiveInfo info;
+        info.addr = addr;
+        for (const auto& kind_name : kind_names) {
+          if (!type_obj.find_in_mro(shell.env, kind_name, "asyncio.").is_null()) {
+            info.kind = kind_name;
+            break;
+          }
+        }
+
+        std::vector<MappedPtr<PyObject>> waiters;
+        if (info.kind == "Queue") {
+          waiters = deque_items(shell.env.get_attribute(addr, "_getters"));
+          size_t num_getters = waiters.size();
+          auto putters = deque_items(shell.env.get_attribute(addr, "_putters"));
+          waiters.insert(waiters.end(), putters.begin(), putters.end());
+          // Queue and LifoQueue use a deque and a list respectively; PriorityQueue uses a list as a heap
+          auto items_addr = shell.env.get_attribute(addr, "_queue");
+          if (!items_addr.is_null() && !shell.env.invalid_reason(items_addr, deque_type)) {
+            info.num_items = shell.env.r.get(items_addr.cast<PyDequeObject>()).ob_size;
+          } else if (!items_addr.is_null() && !shell.env.invalid_reason(items_addr, list_type)) {
+            info.num_items = shell.env.r.get(items_addr.cast<PyListObject>()).ob_size;
+          }
+          info.state = std::format("{} items, maxsize={}, {} getters, {} putters, unfinished_tasks={}",
+              info.num_items, int_attribute_str(shell.env, addr, "_maxsize"), num_getters, putters.size(),
+              int_attribute_str(shell.env, addr, "_unfinished_tasks"));
+        } else {
+          waiters = deque_items(shell.env.get_attribute(addr, "_waiters"));
+          if (info.kind == "Lock") {
+            info.state = is_truthy_int(shell.env, shell.env.get_attribute(addr, "_locked")) ? "locked" : "unlocked";
+          } else if (info.kind == "Event") {
+            info.state = is_truthy_int(shell.env, shell.env.get_attribute(addr, "_value")) ? "set" : "clear";
+          } else if (info.kind == "Semaphore") {
+            info.state = std::format("value={}", int_attribute_str(shell.env, addr, "_value"));
+          } else if (info.kind == "Condition") {
+            auto lock_addr = shell.env.get_attribute(addr, "_lock");
+            info.state = std::format("lock={}{}", lock_addr,
+                is_truthy_int(shell.env, shell.env.get_attribute(lock_addr, "_locked")) ? " (locked)" : "");
+          }
+        }
+        info.num_waiters = waiters.size();
+        if ((info.num_waiters < min_waiters) && (info.num_items < min_waiters)) {
+          continue;
+        }
+
+        for (auto waiter_addr : waiters) {
+          auto task_it = task_for_future.find(waiter_addr);
+          if (task_it == task_for_future.end()) {
+            info.num_orphan_waiters++;
+          } else {
+            info.count_for_location[task_await_location(shell.env, task_it->second)]++;
+          }
+        }
+        results.emplace_back(std::move(info));
+      }
+
+      std::sort(results.begin(), results.end(), [](const PrimitiveInfo& a, const PrimitiveInfo& b) -> bool {
+        return (a.num_waiters != b.num_waiters) ? (a.num_waiters < b.num_waiters) : (a.num_items < b.num_items);
+      });
+      if (results.size() > max_results) {
+        results.erase(results.begin(), results.end() - max_results);
+      }
+      for (const auto& info : results) {
+        phosg::fwrite_fmt(stdout, "{} @ {} ({}): {} waiters ({} not awaited by any task); {}\n", info.kind, info.addr,
+            shell.env.r.get(shell.env.r.get(info.addr).ob_type).name(shell.env.r), info.num_waiters,
+            info.num_orphan_waiters, info.state);
+        std::vector<std::pair<size_t, std::string>> sorted_locations;
+        for (const auto& [location, count] : info.count_for_location) {
+          sorted_locations.emplace_back(count, location);
+        }
+        std::sort(sorted_locations.begin(), sorted_locations.end());
+        if (sorted_locations.size() > max_locations) {
+          sorted_locations.erase(sorted_locations.begin(), sorted_locations.end() - max_locations);
+        }
+        for (const auto& [count, location] : sorted_locations) {
+          phosg::fwrite_fmt(stdout, "  ({} tasks) {}\n", count, location);
+        }
+      }
+      phosg::fwrite_fmt(stderr, "{} asyncio synchronization primitives found\n", primitive_addrs.size());
+    });
+
+ShellCommand c_executors(
+    "executors", "\
+  executors [OPTIONS]\n\
+    Finds all concurrent.futures ThreadPoolExecutor and ProcessPoolExecutor\n\
+    objects (including subclasses) and decodes their pending work: the work\n\
+    queue of each ThreadPoolExecutor (a queue.SimpleQueue of work items) and\n\
+    the pending work item dict of each ProcessPoolExecutor. Shows the queue\n\
+    depth, worker count, and idle worker count of each executor, and the\n\
+    callables that appear most often in the queue. A deep queue with no idle\n\
+    workers means the executor is saturated. Options:\n\
+      --max-callables=N: Show this many callables per executor, and overall\n\
+        (default 10).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t max_callables = args.get<size_t>("max-callables", 10);
+
+      auto executor_types = subclasses_of(shell.env, {"ThreadPoolExecutor", "ProcessPoolExecutor"}, "concurrent.futures");
+      if (executor_types.empty()) {
+        throw std::runtime_error("No executor types were found; run find-all-types first");
+      }
+      auto simple_queue_type = shell.env.get_type_if_exists("_queue.SimpleQueue");
+      auto dict_type = shell.env.get_type_if_exists("dict");
+      auto set_type = shell.env.get_type_if_exists("set");
+      auto none_type = shell.env.get_type_if_exists("NoneType");
+
+      auto container_size_str = [&](MappedPtr<PyObject> addr) -> std::string {
+        if (addr.is_null()) {
+          return "?";
+        } else if (!shell.env.invalid_reason(addr, set_type)) {
+          return std::format("{}", shell.env.r.get(addr.cast<PySetObject>()).used);
+        } else if (!shell.env.invalid_reason(addr, dict_type)) {
+          return std::format("{}", shell.env.r.get(addr.cast<PyDictObject>()).ma_used);
+        }
+        return "?";
+      };
+      auto print_top_callables = [&](const std::unordered_map<std::string, size_t>& count_for_callable, const char* indent) {
+        std::vector<std::pair<size_t, std::string>> sorted_callables;
+        for (const auto& [name, count] : count_for_callable) {
+          sorted_callables.emplace_back(count, name);
+        }
+        std::sort(sorted_callables.begin(), sorted_callables.end());
+        if (sorted_callables.size() > max_callables) {
+          sorted_callables.erase(sorted_callables.begin(), sorted_callables.end() - max_callables);
+        }
+        for (const auto& [count, name] : sorted_callables) {
+          phosg::fwrite_fmt(stdout, "{}({} work items) {}\n", indent, count, name);
+        }
+      };
+
+      struct ExecutorInfo {
+        MappedPtr<PyObject> addr;
+        bool is_process_pool;
+        std::string summary;
+        size_t queue_depth = 0;
+        std::unordered_map<std::string, size_t> count_for_callable;
+      };
+      std::vector<ExecutorInfo> infos;
+      std::unordered_map<std::string, size_t> overall_count_for_callable;
+      for (auto addr : find_instances_of_types(shell, executor_types)) {
+        const auto& type_obj = shell.env.r.get(shell.env.r.get(addr).ob_type);
+        auto& info = infos.emplace_back();
+        info.addr = addr;
+        info.is_process_pool = !type_obj.find_in_mro(shell.env, "ProcessPoolExecutor").is_null();
+
+        // Work items are _WorkItem objects (with fn and future attributes) in both executor types. The thread pool's
+        // queue also contains None for each worker that should exit.
+        std::vector<MappedPtr<PyObject>> work_items;
+        std::string workers_str;
+        if (info.is_process_pool) {
+          auto pending_addr = shell.env.get_attribute(addr, "_pending_work_items");
+          if (!pending_addr.is_null() && !shell.env.invalid_reason(pending_addr, dict_type)) {
+            for (const auto& [_, item_addr] : shell.env.r.get(pending_addr.cast<PyDictObject>()).get_items(shell.env.r)) {
+              work_items.emplace_back(item_addr);
+            }
+          }
+          workers_str = std::format("{} processes", container_size_str(shell.env.get_attribute(addr, "_processes")));
+        } else {
+          auto queue_addr = shell.env.get_attribute(addr, "_work_queue");
+          if (!queue_addr.is_null() && !shell.env.invalid_reason(queue_addr, simple_queue_type)) {
+            for (auto item_addr : shell.env.r.get(queue_addr.cast<PySimpleQueueObject>()).get_items(shell.env.r)) {
+              if (shell.env.r.obj_valid(item_addr) && (shell.env.r.get(item_addr).ob_type != none_type)) {
+                work_items.emplace_back(item_addr);
+              }
+            }
+          }
+          workers_str = std::format("{} threads ({} idle)", container_size_str(shell.env.get_attribute(addr, "_threads")),
+              int_attribute_str(shell.env, shell.env.get_attribute(addr, "_idle_semaphore"), "_value"));
+        }
+
+        std::unordered_map<std::string, size_t> count_for_state;
+        for (auto item_addr : work_items) {
+          std::string callable_name = describe_callable(shell.env, shell.env.get_attribute(item_addr, "fn"));
+          info.count_for_callable[callable_name]++;
+          overall_count_for_callable[callable_name]++;
+          std::string state = str_attribute(shell.env, shell.env.get_attribute(item_addr, "future"), "_state");
+          count_for_state[state.empty() ? "?" : state]++;
+        }
+        info.queue_depth = work_items.size();
+
+        std::string states_str;
+        for (const auto& [state, count] : count_for_state) {
+          states_str += std::format(", {} {}", count, state);
+        }
+        // _broken is False, or a message (or exception) describing why the pool broke
+        auto broken_addr = shell.env.get_attribute(addr, "_broken");
+        bool is_broken = shell.env.r.obj_valid(broken_addr) && (shell.env.r.get(broken_addr).ob_type != none_type) &&
+            ((shell.env.r.get(broken_addr).ob_type != shell.env.get_type_if_exists("bool")) ||
+                is_truthy_int(shell.env, broken_addr));
+        bool is_shut_down = is_truthy_int(
+            shell.env, shell.env.get_attribute(addr, info.is_process_pool ? "_shutdown_thread" : "_shutdown"));
+        info.summary = std::format("{} pending work items{}; {}, max_workers={}{}{}", info.queue_depth, states_str,
+            workers_str, int_attribute_str(shell.env, addr, "_max_workers"), is_shut_down ? ", shut down" : "",
+            is_broken ? ", broken" : "");
+      }
+
+      std::sort(infos.begin(), infos.end(), [](const ExecutorInfo& a, const ExecutorInfo& b) -> bool {
+        return a.queue_depth < b.queue_depth;
+      });
+      for (const auto& info : infos) {
+        phosg::fwrite_fmt(stdout, "{} @ {}: {}\n", info.is_process_pool ? "ProcessPoolExecutor" : "ThreadPoolExecutor",
+            info.addr, info.summary);
+        print_top_callables(info.count_for_callable, "  ");
+      }
+      if (infos.size() > 1) {
+        phosg::fwrite_fmt(stdout, "Pending callables across all executors:\n");
+        print_top_callables(overall_count_for_callable, "  ");
+      }
+      phosg::fwrite_fmt(stderr, "{} executors found\n", infos.size());
+    });
+
+ShellCommand c_stream_buffers(
+    "stream-buffers", "\
+  stream-buffers [OPTIONS]\n\
+    Finds all asyncio StreamReaders and selector transports (TCP and Unix\n\
+    socket connections) and reports how much data each connection has\n\
+    buffered: the reader's unconsumed input (StreamReader._buffer) and the\n\
+    transport's unsent output (the transport's _buffer). Also shows the\n\
+    reader's limit, whether reading or writing is paused, the peer address,\n\
+    and the task waiting on the connection, if any. When peers are slow or\n\
+    backpressure isn't respected, these buffers grow without bound. The\n\
+    connections with the most buffered data are shown last, followed by\n\
+    totals for each peer host. Options:\n\
+      --max-results=N: Show at most this many connections (default 30).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t max_results = args.get<size_t>("max-results", 30);
+
+      auto reader_types = subclasses_of(shell.env, {"StreamReader"}, "asyncio.");
+      auto transport_types = subclasses_of(shell.env, {"_SelectorTransport"}, "asyncio.");
+      if (reader_types.empty() && transport_types.empty()) {
+        throw std::runtime_error("No asyncio stream or transport types were found; run find-all-types first");
+      }
+      auto task_for_future = tasks_by_awaited_future(shell);
+      auto bytes_type = shell.env.get_type_if_exists("bytes");
+      auto bytearray_type = shell.env.get_type_if_exists("bytearray");
+      auto deque_type = shell.env.get_type_if_exists("collections.deque");
+      auto tuple_type = shell.env.get_type_if_exists("tuple");
+      auto dict_type = shell.env.get_type_if_exists("dict");
+
+      // Read buffers are always bytearrays; write buffers are bytearrays in older versions and deques of bytes objects
+      // in newer ones
+      std::function<size_t(MappedPtr<PyObject>)> buffered_bytes = [&](MappedPtr<PyObject> addr) -> size_t {
+        if (addr.is_null() || !shell.env.r.obj_valid(addr)) {
+          return 0;
+        }
+        auto type_addr = shell.env.r.get(addr).ob_type;
+        if ((type_addr == bytes_type) || (type_addr == bytearray_type)) {
+          return shell.env.r.get(addr.cast<PyVarObject>()).ob_size;
+        } else if ((type_addr == deque_type) && !shell.env.invalid_reason(addr)) {
+          size_t ret = 0;
+          for (auto item_addr : shell.env.r.get(addr.cast<PyDequeObject>()).get_items(shell.env.r)) {
+            if (shell.env.r.obj_valid(item_addr) && (shell.env.r.get(item_addr).ob_type != deque_type)) {
+              ret += buffered_bytes(item_addr);
+            }
+          }
+          return ret;
+        }
+        return 0;
+      };
+      auto task_str_for_future = [&](MappedPtr<PyObject> future_addr) -> std::string {
+        auto task_it = task_for_future.find(future_addr);
+        if (future_addr.is_null() || (task_it == task_for_future.end())) {
+          return "";
+        }
+        const auto& task = shell.env.r.get(task_it->second.cast<PyAsyncTaskObject>());
+        std::string name;
+        try {
+          name = decode_string_types(shell.env.r, task.task_name, 0x100);
+        } catch (const std::exception&) {
+          name = "Task";
+        }
+        return std::format("{} @ {} in {}", name, task_it->second, task_await_location(shell.env, task_it->second));
+      };
+      auto peer_host_and_str = [&](MappedPtr<PyObject> transport_addr) -> std::pair<std::string, std::string> {
+        auto extra_addr = shell.env.get_attribute(transport_addr, "_extra");
+        if (extra_addr.is_null() || shell.env.invalid_reason(extra_addr, dict_type)) {
+          return {"?", "?"};
+        }
+        MappedPtr<PyObject> peername_addr;
+        try {
+          peername_addr = shell.env.r.get(extra_addr.cast<PyDictObject>()).value_for_key<PyObject>(shell.env.r, "peername");
+        } catch (const std::out_of_range&) {
+          return {"?", "?"};
+        }
+        // IP peer names are (host, port, ...) tuples; Unix socket peer names are strings
+        if (!shell.env.invalid_reason(peername_addr, tuple_type)) {
+          auto items = shell.env.r.get(peername_addr.cast<PyTupleObject>()).get_items();
+          if ((items.size() >= 2) && !shell.env.invalid_reason(items[1], shell.env.get_type_if_exists("int"))) {
+            try {
+              std::string host = decode_string_types(shell.env.r, items[0], 0x100);
+              int64_t port = shell.env.r.get(items[1].cast<PyLongObject>()).as_int64(shell.env.r);
+              return {host, std::format("{}:{}", host, port)};
+            } catch (const std::exception&) {
+            }
+          }
+        }
+        try {
+          std::string name = decode_string_types(shell.env.r, peername_addr, 0x100);
+          return {name, name};
+        } catch (const std::exception&) {
+          return {"?", "?"};
+        }
+      };
+
+      struct ConnectionInfo {
+        MappedPtr<PyObject> transport_addr;
+        MappedPtr<PyObject> reader_addr;
+        size_t read_buffered = 0;
+        size_t write_buffered = 0;
+        std::string peer_host = "?";
+        std::string description;
+      };
+      std::unordered_map<MappedPtr<PyObject>, ConnectionInfo> info_for_transport;
+      std::vector<ConnectionInfo> infos;
+
+      for (auto transport_addr : find_instances_of_types(shell, transport_types)) {
+        auto& info = info_for_transport[transport_addr];
+        info.transport_addr = transport_addr;
+        info.write_buffered = buffered_bytes(shell.env.get_attribute(transport_addr, "_buffer"));
+        auto [host, peer_str] = peer_host_and_str(transport_addr);
+        info.peer_host = host;
+        auto protocol_addr = shell.env.get_attribute(transport_addr, "_protocol");
+        std::string task_str = task_str_for_future(shell.env.get_attribute(protocol_addr, "_drain_waiter"));
+        info.description = std::format("  transport @ {} ({}) peer={}: {} write-buffered (high water {}, low water {}){}{}{}\n",
+            transport_addr, shell.env.r.get(shell.env.r.get(transport_addr).ob_type).name(shell.env.r), peer_str,
+            phosg::format_size(info.write_buffered), int_attribute_str(shell.env, transport_addr, "_high_water"),
+            int_attribute_str(shell.env, transport_addr, "_low_water"),
+            is_truthy_int(shell.env, shell.env.get_attribute(transport_addr, "_protocol_paused")) ? ", writing paused" : "",
+            is_truthy_int(shell.env, shell.env.get_attribute(transport_addr, "_closing")) ? ", closing" : "",
+            task_str.empty() ? "" : (", drain awaited by " + task_str));
+      }
+
+      for (auto reader_addr : find_instances_of_types(shell, reader_types)) {
+        auto transport_addr = shell.env.get_attribute(reader_addr, "_transport");
+        auto transport_it = info_for_transport.find(transport_addr);
+        ConnectionInfo* info;
+        if (transport_it == info_for_transport.end() || !transport_it->second.reader_addr.is_null()) {
+          info = &infos.emplace_back();
+        } else {
+          info = &transport_it->second;
+        }
+        info->reader_addr = reader_addr;
+        info->read_buffered = buffered_bytes(shell.env.get_attribute(reader_addr, "_buffer"));
+        std::string task_str = task_str_for_future(shell.env.get_attribute(reader_addr, "_waiter"));
+        info->description = std::format("  reader @ {}: {} read-buffered (limit {}){}{}{}\n{}", reader_addr,
+            phosg::format_size(info->read_buffered), int_attribute_str(shell.env, reader_addr, "_limit"),
+            is_truthy_int(shell.env, shell.env.get_attribute(reader_addr, "_paused")) ? ", reading paused" : "",
+            is_truthy_int(shell.env, shell.env.get_attribute(reader_addr, "_eof")) ? ", at EOF" : "",
+            task_str.empty() ? "" : (", awaited by " + task_str), info->description);
+      }
+      for (auto& [_, info] : info_for_transport) {
+        infos.emplace_back(std::move(info));
+      }
+
+      std::sort(infos.begin(), infos.end(), [](const ConnectionInfo& a, const ConnectionInfo& b) -> bool {
+        return (a.read_buffered + a.write_buffered) < (b.read_buffered + b.write_buffered);
+      });
+      std::unordered_map<std::string, std::tuple<size_t, size_t, size_t>> totals_for_host;
+      size_t total_read = 0, total_write = 0;
+      for (const auto& info : infos) {
+        auto& [num_connections, read_bytes, write_bytes] = totals_for_host[info.peer_host];
+        num_connections++;
+        read_bytes += info.read_buffered;
+        write_bytes += info.write_buffered;
+        total_read += info.read_buffered;
+        total_write += info.write_buffered;
+      }
+
+      size_t start_index = (infos.size() > max_results) ? (infos.size() - max_results) : 0;
+      for (size_t z = start_index; z < infos.size(); z++) {
+        const auto& info = infos[z];
+        phosg::fwrite_fmt(stdout, "Connection ({} buffered):\n{}",
+            phosg::format_size(info.read_buffered + info.write_buffered), info.description);
+      }
+
+      std::vector<std::tuple<size_t, size_t, size_t, std::string>> sorted_hosts;
+      for (const auto& [host, totals] : totals_for_host) {
+        const auto& [num_connections, read_bytes, write_bytes] = totals;
+        sorted_hosts.emplace_back(read_bytes + write_bytes, read_bytes, num_connections, host);
+      }
+      std::sort(sorted_hosts.begin(), sorted_hosts.end());
+      phosg::fwrite_fmt(stdout, "Totals by peer host:\n");
+      for (const auto& [total_bytes, read_bytes, num_connections, host] : sorted_hosts) {
+        phosg::fwrite_fmt(stdout, "  {}: {} connections, {} read-buffered, {} write-buffered\n", host, num_connections,
+            phosg::format_size(read_bytes), phosg::format_size(total_bytes - read_bytes));
+      }
+      phosg::fwrite_fmt(stdout, "Overall: {} connections, {} read-buffered, {} write-buffered\n", infos.size(),
+          phosg::format_size(total_read), phosg::format_size(total_write));
+    });
+
+ShellCommand c_finished_futures(
+    "finished-futures", "\
+  finished-futures [OPTIONS]\n\
+    Finds all asyncio futures and tasks that are finished or cancelled but\n\
+    still referenced, and measures how much memory they keep alive through\n\
+    their results, exceptions, and exception tracebacks. A field's object is\n\
+    only counted if the future holds all of its references; memory shared\n\
+    with other objects isn't attributed to the future. Results are grouped by\n\
+    task coroutine name (or future type) and by the type of the objects that\n\
+    refer to the future; the groups retaining the most memory are shown last.\n\
+    Referrers are found by scanning all objects whose types python-memtools\n\
+    implements, so futures only referenced from other types (e.g. objects\n\
+    defined in C extensions) have unknown referrers. Options:\n\
+      --max-results=N: Show at most this many groups (default 30).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t max_results = args.get<size_t>("max-results", 30);
+
+      auto future_types = subclasses_of(shell.env, {"_asyncio.Future"});
+      if (future_types.empty()) {
+        throw std::runtime_error("_asyncio.Future type is missing; run find-all-types first");
+      }
+      auto task_type = shell.env.get_type_if_exists("_asyncio.Task");
+      auto name_for_type = names_for_types(shell.env);
+
+      std::unordered_set<MappedPtr<PyObject>> finished_futures;
+      for (auto addr : find_instances_of_types(shell, future_types)) {
+        const auto& fut = shell.env.r.get(addr.cast<PyAsyncFutureObject>());
+        if ((fut.fut_state != PyFutureState::STATE_PENDING) && !fut.invalid_reason(shell.env)) {
+          finished_futures.emplace(addr);
+        }
+      }
+      phosg::fwrite_fmt(stderr, "{} finished or cancelled futures found; looking for referrers\n", finished_futures.size());
+
+      std::vector<std::unordered_map<MappedPtr<PyObject>, std::unordered_set<MappedPtr<PyTypeObject>>>> thread_referrer_types;
+      thread_referrer_types.resize(shell.max_threads);
+      shell.env.r.map_all_addresses<PyObject>([&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+        if (!name_for_type.count(obj.ob_type) || shell.env.invalid_reason(addr)) {
+          return;
+        }
+        try {
+          for (auto referent : shell.env.direct_referents(addr)) {
+            auto referent_addr = referent.cast<PyObject>();
+            if (finished_futures.count(referent_addr) && (referent_addr != addr)) {
+              thread_referrer_types[thread_index][referent_addr].emplace(obj.ob_type);
+            }
+          }
+        } catch (const invalid_object&) {
+        } catch (const std::out_of_range&) {
+        }
+      },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+      std::unordered_map<MappedPtr<PyObject>, std::unordered_set<MappedPtr<PyTypeObject>>> referrer_types_for_future;
+      for (auto& referrer_types : thread_referrer_types) {
+        for (auto& [fut_addr, types] : referrer_types) {
+          referrer_types_for_future[fut_addr].insert(types.begin(), types.end());
+        }
+      }
+
+      struct GroupStats {
+        size_t num_futures = 0;
+        size_t num_cancelled = 0;
+        size_t num_exceptions = 0;
+        size_t result_bytes = 0;
+        size_t exception_bytes = 0; // Includes tracebacks
+      };
+      std::map<std::pair<std::string, std::string>, GroupStats> stats_for_group;
+      for (auto fut_addr : finished_futures) {
+        const auto& fut = shell.env.r.get(fut_addr.cast<PyAsyncFutureObject>());
+
+        // The exception's traceback is usually referenced both by the exception and by fut_exception_tb, so count
+        // references from both when deciding whether the future owns an object
+        std::unordered_map<MappedPtr<PyObject>, size_t> internal_refs;
+        for (auto field_addr : {fut.fut_result, fut.fut_exception, fut.fut_exception_tb}) {
+          if (!field_addr.is_null()) {
+            internal_refs[field_addr]++;
+          }
+        }
+        if (!fut.fut_exception.is_null() && !shell.env.invalid_reason(fut.fut_exception)) {
+          const auto& exc_type = shell.env.r.get(shell.env.r.get(fut.fut_exception).ob_type);
+          if (exc_type.tp_flags & Py_TPFLAGS_BASE_EXC_SUBCLASS) {
+            auto tb_addr = shell.env.r.get(fut.fut_exception.cast<PyBaseExceptionObject>()).traceback;
+            if (internal_refs.count(tb_addr)) {
+              internal_refs[tb_addr]++;
+            }
+          }
+        }
+        auto owned_retained_size = [&](MappedPtr<PyObject> field_addr) -> size_t {
+          if (field_addr.is_null() || !shell.env.r.obj_valid(field_addr) ||
+              (shell.env.r.get(field_addr).ob_refcnt > internal_refs[field_addr]) || shell.env.invalid_reason(field_addr)) {
+            return 0;
+          }
+          return shell.env.retained_size(field_addr);
+        };
+
+        std::string name;
+        if (shell.env.r.get(fut_addr).ob_type == task_type) {
+          const auto& task = shell.env.r.get(fut_addr.cast<PyAsyncTaskObject>());
+          try {
+            name = std::format("Task {}", decode_string_types(
+                shell.env.r, shell.env.r.get(task.task_coro.cast<PyGenObject>()).gi_qualname, 0x100));
+          } catch (const std::exception&) {
+            name = "Task <unknown coroutine>";
+          }
+        } else {
+          auto name_it = name_for_type.find(fut.ob_type);
+          name = (name_it == name_for_type.end()) ? "<unknown type>" : name_it->second;
+        }
+        std::string referrers_str;
+        auto referrers_it = referrer_types_for_future.find(fut_addr);
+        if (referrers_it == referrer_types_for_future.end()) {
+          referrers_str = "<unknown>";
+        } else {
+          std::set<std::string> referrer_names;
+          for (auto type_addr : referrers_it->second) {
+            auto name_it = name_for_type.find(type_addr);
+            referrer_names.emplace((name_it == name_for_type.end()) ? std::format("<type@{}>", type_addr) : name_it->second);
+          }
+          for (const auto& referrer_name : referrer_names) {
+            referrers_str += referrers_str.empty() ? "" : ", ";
+            referrers_str += referrer_name;
+          }
+        }
+
+        auto& stats = stats_for_group[std::make_pair(name, referrers_str)];
+        stats.num_futures++;
+        stats.num_cancelled += (fut.fut_state == PyFutureState::STATE_CANCELLED);
+        stats.num_exceptions += !fut.fut_exception.is_null();
+        stats.result_bytes += owned_retained_size(fut.fut_result);
+        stats.exception_bytes += owned_retained_size(fut.fut_exception);
+        if (fut.fut_exception_tb != fut.fut_exception) {
+          stats.exception_bytes += owned_retained_size(fut.fut_exception_tb);
+        }
+      }
+
+      std::vector<std::pair<size_t, const std::pair<std::string, std::string>*>> sorted_groups;
+      size_t total_bytes = 0;
+      for (const auto& [key, stats] : stats_for_group) {
+        sorted_groups.emplace_back(stats.result_bytes + stats.exception_bytes, &key);
+        total_bytes += stats.result_bytes + stats.exception_bytes;
+      }
+      std::sort(sorted_groups.begin(), sorted_groups.end());
+      if (sorted_groups.size() > max_results) {
+        sorted_groups.erase(sorted_groups.begin(), sorted_groups.end() - max_results);
+      }
+      for (const auto& [bytes, key] : sorted_groups) {
+        const auto& stats = stats_for_group.at(*key);
+        phosg::fwrite_fmt(stdout, "({} retained: {} by results, {} by exceptions) {} finished ({} cancelled, {} with exceptions) {} referenced by {}\n",
+            phosg::format_size(bytes), phosg::format_size(stats.result_bytes), phosg::format_size(stats.exception_bytes),
+            stats.num_futures, stats.num_cancelled, stats.num_exceptions, key->first, key->second);
+      }
+      phosg::fwrite_fmt(stdout, "{} finished futures retain {} overall\n", finished_futures.size(), phosg::format_size(total_bytes));
+    });
+
+ShellCommand c_exception_retention(
+    "exception-retention", "\
+  exception-retention [OPTIONS]\n\
+    Finds all exception objects and measures how many frames and bytes each\n\
+    one keeps alive through its traceback (each traceback entry refers to a\n\
+    frame, which refers to its locals and to its caller's frame). Exceptions\n\
+    are grouped by type and by where they were raised (the last entry in the\n\
+    traceback), and each group shows where its exceptions are held: in a\n\
+    thread's current exception state, in a suspended generator or coroutine's\n\
+    exception state, in an asyncio future, in sys.last_value, or elsewhere.\n\
+    Exceptions chained to another exception (as its __context__ or __cause__,\n\
+    or in its args) are counted as part of that exception rather than on their\n\
+    own, so their frames and memory are only counted once. Tracebacks that\n\
+    aren't attached to any exception (such as those in asyncio futures'\n\
+    _exception_tb fields or in sys.last_traceback) are also reported, as\n\
+    <traceback> groups. The groups retaining the most memory are shown last.\n\
+    Options:\n\
+      --max-results=N: Show at most this many groups (default 30).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t max_results = args.get<size_t>("max-results", 30);
+
+      auto name_for_type = names_for_types(shell.env);
+      auto module_type = shell.env.get_type("module");
+      auto dict_type = shell.env.get_type("dict");
+      auto tuple_type = shell.env.get_type("tuple");
+      auto traceback_type = shell.env.get_type_if_exists("traceback");
+      auto generator_type = shell.env.get_type_if_exists("generator");
+      auto coroutine_type = shell.env.get_type_if_exists("coroutine");
+      auto asyncgen_type = shell.env.get_type_if_exists("asyncgen");
+      auto future_types = subclasses_of(shell.env, {"_asyncio.Future"});
+
+      // Exceptions held by thread states (the exception being handled, and the one being raised, if any)
+      std::unordered_map<MappedPtr<PyObject>, std::string> holder_for_exception;
+      for (auto ts_addr : find_thread_states(shell)) {
+        const auto& ts = shell.env.r.get(ts_addr);
+        std::string holder = std::format("thread {:X}", ts.thread_id);
+        holder_for_exception.emplace(ts.curexc_value, holder);
+        holder_for_exception.emplace(ts.exc_state.exc_value, holder);
+        size_t depth = 0;
+        for (auto item_addr = ts.exc_info; !item_addr.is_null() && (depth < 0x1000); depth++) {
+          if (!shell.env.r.obj_valid(item_addr)) {
+            break;
+          }
+          const auto& item = shell.env.r.get(item_addr);
+          holder_for_exception.emplace(item.exc_value, holder);
+          item_addr = item.exc_prev;
+        }
+      }
+      holder_for_exception.erase(MappedPtr<PyObject>());
+
+      auto is_exception = [&](MappedPtr<PyObject> addr) -> bool {
+        return !addr.is_null() && shell.env.r.obj_valid(addr) &&
+            (shell.env.r.get(shell.env.r.get(addr).ob_type).tp_flags & Py_TPFLAGS_BASE_EXC_SUBCLASS);
+      };
+      // Returns the exceptions that the given exception refers to directly: its context, its cause, and any exceptions
+      // in its args (as in an ExceptionGroup)
+      auto nested_exceptions = [&](const PyBaseExceptionObject& exc) -> std::vector<MappedPtr<PyObject>> {
+        std::vector<MappedPtr<PyObject>> ret;
+        for (auto addr : {exc.context, exc.cause}) {
+          if (is_exception(addr)) {
+            ret.emplace_back(addr);
+          }
+        }
+        if (!exc.args.is_null() && shell.env.r.obj_valid(exc.args) && (shell.env.r.get(exc.args).ob_type == tuple_type)) {
+          const auto& args_tuple = shell.env.r.get(exc.args.cast<PyTupleObject>());
+          if (!args_tuple.invalid_reason(shell.env)) {
+            for (auto item_addr : args_tuple.get_items()) {
+              if (is_exception(item_addr)) {
+                ret.emplace_back(item_addr);
+              }
+            }
+          }
+        }
+        return ret;
+      };
+      // Adds the frames that a traceback keeps alive to frames (each traceback entry's frame keeps its callers' frames
+      // alive too), and returns the location of the last entry, which is where the exception was raised
+      auto add_traceback_frames = [&](MappedPtr<PyObject> tb_addr, std::unordered_set<MappedPtr<PyFrameObject>>& frames) -> std::string {
+        auto tb_chain = shell.env.r.get(tb_addr.cast<PyTracebackObject>()).get_chain(shell.env);
+        for (auto chain_tb_addr : tb_chain) {
+          auto frame_addr = shell.env.r.get(chain_tb_addr).tb_frame;
+          while (shell.env.r.obj_valid(frame_addr) && (frames.size() < 0x10000) && frames.emplace(frame_addr).second) {
+            frame_addr = shell.env.r.get(frame_addr).f_back;
+          }
+        }
+        const auto& last_tb = shell.env.r.get(tb_chain.back());
+        const auto& code = shell.env.r.get(shell.env.r.get(last_tb.tb_frame).f_code);
+        return std::format("{} ({}:{})", decode_string_types(shell.env.r, code.co_name, 0x100),
+            decode_string_types(shell.env.r, code.co_filename, 0x400), last_tb.tb_lineno);
+      };
+
+      struct ExceptionInfo {
+        MappedPtr<PyObject> addr;
+        MappedPtr<PyTypeObject> type;
+        std::string raise_location;
+        size_t num_frames = 0;
+        size_t retained_bytes = 0;
+      };
+      std::vector<std::vector<ExceptionInfo>> thread_infos;
+      std::vector<std::vector<std::pair<MappedPtr<PyObject>, const char*>>> thread_holders;
+      std::vector<std::vector<MappedPtr<PyObject>>> thread_nested_exceptions;
+      // Tracebacks, and the tracebacks that are referred to by an exception or by another traceback's tb_next
+      std::vector<std::vector<MappedPtr<PyObject>>> thread_tracebacks;
+      std::vector<std::vector<MappedPtr<PyObject>>> thread_referenced_tracebacks;
+      thread_infos.resize(shell.max_threads);
+      thread_holders.resize(shell.max_threads);
+      thread_nested_exceptions.resize(shell.max_threads);
+      thread_tracebacks.resize(shell.max_threads);
+      thread_referenced_tracebacks.resize(shell.max_threads);
+      shell.env.r.map_all_addresses<PyObject>([&](const PyObject& obj, MappedPtr<PyObject> addr, size_t thread_index) -> void {
+        if (!name_for_type.count(obj.ob_type)) {
+          return;
+        }
+        try {
+          if ((obj.ob_type == generator_type) || (obj.ob_type == coroutine_type) || (obj.ob_type == asyncgen_type)) {
+            const auto& gen = shell.env.r.get(addr.cast<PyGenObject>());
+            if (!gen.gi_exc_state.exc_value.is_null() && !gen.invalid_reason(shell.env)) {
+              thread_holders[thread_index].emplace_back(gen.gi_exc_state.exc_value, "generator exception state");
+            }
+            return;
+          }
+          if (future_types.count(obj.ob_type)) {
+            const auto& fut = shell.env.r.get(addr.cast<PyAsyncFutureObject>());
+            if (!fut.invalid_reason(shell.env)) {
+              if (!fut.fut_exception.is_null()) {
+                thread_holders[thread_index].emplace_back(fut.fut_exception, "future exception");
+              }
+              if (!fut.fut_exception_tb.is_null()) {
+                thread_holders[thread_index].emplace_back(fut.fut_exception_tb, "future traceback");
+              }
+              if (!fut.fut_cancelled_exc.exc_value.is_null()) {
+                thread_holders[thread_index].emplace_back(fut.fut_cancelled_exc.exc_value, "future cancellation state");
+              }
+            }
+            return;
+          }
+          if (!traceback_type.is_null() && (obj.ob_type == traceback_type)) {
+            const auto& tb = shell.env.r.get(addr.cast<PyTracebackObject>());
+            if (!tb.invalid_reason(shell.env)) {
+              thread_tracebacks[thread_index].emplace_back(addr);
+              if (!tb.tb_next.is_null()) {
+                thread_referenced_tracebacks[thread_index].emplace_back(tb.tb_next.cast<PyObject>());
+              }
+            }
+            return;
+          }
+          if (obj.ob_type == module_type) {
+            auto dict_addr = shell.env.r.get(addr.offset_bytes(0x10).cast<MappedPtr<PyDictObject>>());
+            const auto& dict_obj = shell.env.r.get(dict_addr);
+            if ((dict_obj.ob_type != dict_type) || dict_obj.invalid_reason(shell.env) ||
+                (decode_string_types(shell.env.r, dict_obj.value_for_key<PyObject>(shell.env.r, "__name__")) != "sys")) {
+              return;
+            }
+            dict_obj.for_each_entry(shell.env.r, [&](const PyDictKeyEntry& entry, MappedPtr<PyObject> value_addr) -> void {
+              try {
+                std::string key = decode_string_types(shell.env.r, entry.me_key);
+                if (key == "last_value") {
+                  thread_holders[thread_index].emplace_back(value_addr, "sys.last_value");
+                } else if (key == "last_traceback") {
+                  thread_holders[thread_index].emplace_back(value_addr, "sys.last_traceback");
+                }
+              } catch (const invalid_object&) {
+              }
+            });
+            return;
+          }
+
+          if (!(shell.env.r.get(obj.ob_type).tp_flags & Py_TPFLAGS_BASE_EXC_SUBCLASS) || shell.env.invalid_reason(addr)) {
+            return;
+          }
+          const auto& exc = shell.env.r.get(addr.cast<PyBaseExceptionObject>());
+          ExceptionInfo info;
+          info.addr = addr;
+          info.type = obj.ob_type;
+          info.raise_location = "<no traceback>";
+          if (!exc.traceback.is_null()) {
+            thread_referenced_tracebacks[thread_index].emplace_back(exc.traceback);
+          }
+          for (auto nested_addr : nested_exceptions(exc)) {
+            thread_nested_exceptions[thread_index].emplace_back(nested_addr);
+          }
+
+          // Count the frames kept alive by this exception's traceback and by those of all the exceptions chained to
+          // it, since only unchained exceptions are reported
+          std::unordered_set<MappedPtr<PyFrameObject>> frames;
+          std::unordered_set<MappedPtr<PyObject>> chain{addr};
+          std::vector<MappedPtr<PyObject>> pending{addr};
+          while (!pending.empty() && (chain.size() < 0x1000)) {
+            auto chain_exc_addr = pending.back();
+            pending.pop_back();
+            if ((chain_exc_addr != addr) && shell.env.invalid_reason(chain_exc_addr)) {
+              continue;
+            }
+            const auto& chain_exc = shell.env.r.get(chain_exc_addr.cast<PyBaseExceptionObject>());
+            if (!chain_exc.traceback.is_null() && !shell.env.invalid_reason(chain_exc.traceback)) {
+              std::string raise_location = add_traceback_frames(chain_exc.traceback, frames);
+              if (chain_exc_addr == addr) {
+                info.raise_location = std::move(raise_location);
+              }
+            }
+            for (auto nested_addr : nested_exceptions(chain_exc)) {
+              if (chain.emplace(nested_addr).second) {
+                pending.emplace_back(nested_addr);
+              }
+            }
+          }
+          info.num_frames = frames.size();
+          info.retained_bytes = shell.env.retained_size(addr);
+          thread_infos[thread_index].emplace_back(std::move(info));
+        } catch (const std::out_of_range&) {
+        } catch (const invalid_object&) {
+        }
+      },
+          8, shell.max_threads);
+      phosg::fwrite_fmt(stderr, CLEAR_LINE);
+      for (const auto& holders : thread_holders) {
+        for (const auto& [exc_addr, holder] : holders) {
+          holder_for_exception.emplace(exc_addr, holder);
+        }
+      }
+      std::unordered_set<MappedPtr<PyObject>> nested_exception_addrs;
+      for (const auto& addrs : thread_nested_exceptions) {
+        nested_exception_addrs.insert(addrs.begin(), addrs.end());
+      }
+      std::unordered_set<MappedPtr<PyObject>> referenced_traceback_addrs;
+      for (const auto& addrs : thread_referenced_tracebacks) {
+        referenced_traceback_addrs.insert(addrs.begin(), addrs.end());
+      }
+
+      // Tracebacks that aren't referred to by any exception or other traceback are reported as if they were exceptions
+      // of type <traceback>
+      std::vector<ExceptionInfo> standalone_tb_infos;
+      for (const auto& addrs : thread_tracebacks) {
+        for (auto tb_addr : addrs) {
+          if (referenced_traceback_addrs.count(tb_addr)) {
+            continue;
+          }
+          try {
+            std::unordered_set<MappedPtr<PyFrameObject>> frames;
+            ExceptionInfo info;
+            info.addr = tb_addr;
+            info.raise_location = add_traceback_frames(tb_addr, frames);
+            info.num_frames = frames.size();
+            info.retained_bytes = shell.env.retained_size(tb_addr);
+            standalone_tb_infos.emplace_back(std::move(info));
+          } catch (const std::out_of_range&) {
+          } catch (const invalid_object&) {
+          }
+        }
+      }
+      thread_infos.emplace_back(std::move(standalone_tb_infos));
+
+      struct GroupStats {
+        size_t num_exceptions = 0;
+        size_t num_frames = 0;
+        size_t retained_bytes = 0;
+        std::map<std::string, size_t> count_for_holder;
+      };
+      std::map<std::pair<std::string, std::string>, GroupStats> stats_for_group;
+      size_t total_exceptions = 0;
+      size_t num_chained_exceptions = 0;
+      for (const auto& infos : thread_infos) {
+        for (const auto& info : infos) {
+          if (nested_exception_addrs.count(info.addr)) {
+            num_chained_exceptions++;
+            continue;
+          }
+          std::string type_name;
+          if (info.type.is_null()) {
+            type_name = "<traceback>";
+          } else {
+            auto name_it = name_for_type.find(info.type);
+            type_name = (name_it == name_for_type.end()) ? std::format("<type@{}>", info.type) : name_it->second;
+          }
+          auto& stats = stats_for_group[std::make_pair(std::move(type_name), info.raise_location)];
+          stats.num_exceptions++;
+          stats.num_frames += info.num_frames;
+          stats.retained_bytes += info.retained_bytes;
+          auto holder_it = holder_for_exception.find(info.addr);
+          stats.count_for_holder[(holder_it == holder_for_exception.end()) ? "other" : holder_it->second]++;
+          total_exceptions++;
+        }
+      }
+
+      std::vector<std::pair<size_t, const std::pair<std::string, std::string>*>> sorted_groups;
+      for (const auto& [key, stats] : stats_for_group) {
+        sorted_groups.emplace_back(stats.retained_bytes, &key);
+      }
+      std::sort(sorted_groups.begin(), sorted_groups.end());
+      if (sorted_groups.size() > max_results) {
+        sorted_groups.erase(sorted_groups.begin(), sorted_groups.end() - max_results);
+      }
+      for (const auto& [bytes, key] : sorted_groups) {
+        const auto& stats = stats_for_group.at(*key);
+        std::string holders_str;
+        for (const auto& [holder, count] : stats.count_for_holder) {
+          holders_str += std::format("{}{} in {}", holders_str.empty() ? "" : ", ", count, holder);
+        }
+        phosg::fwrite_fmt(stdout, "({} retained, {} frames) {} x {} raised at {}; held: {}\n",
+            phosg::format_size(bytes), stats.num_frames, stats.num_exceptions, key->first, key->second, holders_str);
+      }
+      phosg::fwrite_fmt(stderr, "{} exceptions and standalone tracebacks found ({} more exceptions chained to them)\n",
+          total_exceptions, num_chained_exceptions);
+    });
+
+ShellCommand c_context_vars(
+    "context-vars", "\
+  context-vars [OPTIONS]\n\
+    Finds all contextvars.Context objects and reports, for each ContextVar, how\n\
+    many contexts hold a value for it (and how many of those belong to asyncio\n\
+    tasks or are current in a thread), how many distinct values it has, and the\n\
+    memory retained by those values. Values shared by multiple contexts are\n\
+    only counted once. Variables with many distinct values held by task\n\
+    contexts are marked as accumulating; these usually hold per-request state\n\
+    that lives as long as the tasks do. Options:\n\
+      --min-values=N: Mark variables with at least this many distinct values in\n\
+        task contexts as accumulating (default 10).\n\
+      --max-results=N: Show at most this many variables (default 30).\n",
+    +[](AnalysisShell& shell, phosg::Arguments& args) -> void {
+      size_t min_values = args.get<size_t>("min-values", 10);
+      size_t max_results = args.get<size_t>("max-results", 30);
+
+      auto context_type = shell.env.get_type_if_exists("Context");
+      if (context_type.is_null()) {
+        throw std::runtime_error("Context type not found");
+      }
+      auto task_types = subclasses_of(shell.env, {"_asyncio.Task"});
+      auto search_types = task_types;
+      search_types.emplace(context_type);
+
+      std::unordered_set<MappedPtr<PyObject>> context_addrs;
+      std::unordered_set<MappedPtr<PyObject>> task_context_addrs;
+      for (auto addr : find_instances_of_types(shell, search_types)) {
+        try {
+          const auto& obj = shell.env.r.get(addr);
+          if (obj.ob_type == context_type) {
+            if (!shell.env.invalid_reason(addr)) {
+              context_addrs.emplace(addr);
+            }
+          } else {
+            const auto& task = shell.env.r.get(addr.cast<PyAsyncTaskObject>());
+            if (!task.invalid_reason(shell.env) && !task.task_context.is_null()) {
+              task_context_addrs.emplace(task.task_context);
+            }
+          }
+        } catch (const std::out_of_range&) {
+        }
+      }
+      std::unordered_set<MappedPtr<PyObject>> thread_context_addrs;
+      for (auto ts_addr : find_thread_states(shell)) {
+        const auto& ts = shell.env.r.get(ts_addr);
+        if (!ts.context.is_null()) {
+          thread_context_addrs.emplace(ts.context);
+        }
+      }
+
+      struct VarStats {
+        size_t num_contexts = 0;
+        size_t num_task_contexts = 0;
+        size_t num_thread_contexts = 0;
+        std::unordered_set<MappedPtr<PyObject>> values;
+        std::unordered_set<MappedPtr<PyObject>> task_values;
+        size_t retained_bytes = 0;
+      };
+      std::unordered_map<MappedPtr<PyObject>, VarStats> stats_for_var;
+      std::unordered_set<MappedPtr<PyObject>> hamt_node_addrs;
+      size_t num_invalid_contexts = 0;
+      for (auto context_addr : context_addrs) {
+        try {
+          const auto& context = shell.env.r.get(context_addr.cast<PyContextObject>());
+          const auto& hamt = shell.env.r.get(context.ctx_vars);
+          // Collect the items first, so a corrupt HAMT doesn't partially count
+          auto items = hamt.get_items(shell.env);
+          for (auto node_addr : hamt.get_nodes(shell.env)) {
+            hamt_node_addrs.emplace(node_addr);
+          }
+          hamt_node_addrs.emplace(context.ctx_vars.cast<PyObject>());
+          bool is_task_context = task_context_addrs.count(context_addr);
+          bool is_thread_context = thread_context_addrs.count(context_addr);
+          for (const auto& [var_addr, value_addr] : items) {
+            auto& stats = stats_for_var[var_addr];
+            stats.num_contexts++;
+            stats.values.emplace(value_addr);
+            if (is_task_context) {
+              stats.num_task_contexts++;
+              stats.task_values.emplace(value_addr);
+            }
+            stats.num_thread_contexts += is_thread_context;
+          }
+        } catch (const std::out_of_range&) {
+          num_invalid_contexts++;
+        } catch (const invalid_object&) {
+          num_invalid_contexts++;
+        }
+      }
+
+      size_t hamt_bytes = 0;
+      for (auto node_addr : hamt_node_addrs) {
+        hamt_bytes += shell.env.shallow_size(node_addr);
+      }
+      phosg::fwrite_fmt(stdout, "{} contexts ({} for tasks, {} current in threads) hold {} variables; HAMTs use {}\n",
+          context_addrs.size(), task_context_addrs.size(), thread_context_addrs.size(), stats_for_var.size(),
+          phosg::format_size(hamt_bytes));
+      if (num_invalid_contexts) {
+        phosg::fwrite_fmt(stdout, "{} contexts were skipped because their HAMTs are invalid\n", num_invalid_contexts);
+      }
+
+      std::vector<std::pair<size_t, MappedPtr<PyObject>>> sorted_vars;
+      size_t num_accumulating = 0;
+      for (auto& [var_addr, stats] : stats_for_var) {
+        for (auto value_addr : stats.values) {
+          if (!shell.env.invalid_reason(value_addr)) {
+            stats.retained_bytes += shell.env.retained_size(value_addr);
+          }
+        }
+        sorted_vars.emplace_back(stats.retained_bytes, var_addr);
+        num_accumulating += (stats.task_values.size() >= min_values);
+      }
+      phosg::fwrite_fmt(stdout, "{} variables have at least {} distinct values in task contexts\n", num_accumulating, min_values);
+      std::sort(sorted_vars.begin(), sorted_vars.end());
+      if (sorted_vars.size() > max_results) {
+        sorted_vars.erase(sorted_vars.begin(), sorted_vars.end() - max_results);
+      }
+      for (const auto& [retained_bytes, var_addr] : sorted_vars) {
+        const auto& stats = stats_for_var.at(var_addr);
+        std::string name;
+        try {
+          const auto& var = shell.env.r.get(var_addr.cast<PyContextVarObject>());
+          name = var.invalid_reason(shell.env) ? "<!invalid_var>" : decode_string_types(shell.env.r, var.var_name, 0x100);
+        } catch (const std::out_of_range&) {
+          name = "<!invalid_addr>";
+        }
+        phosg::fwrite_fmt(stdout, "  {} ({} contexts: {} tasks, {} threads; {} distinct values, {} in tasks){}: {} @ {}\n",
+            phosg::format_size(retained_bytes), stats.num_contexts, stats.num_task_contexts, stats.num_thread_contexts,
+            stats.values.size(), stats.task_values.size(),
+            (stats.task_values.size() >= min_values) ? " [accumulating]" : "", name, var_addr);
+      }
+    });
+
 ShellCommand c_async_task_graph(
     "async-task-graph", "\
   async-task-graph\n\
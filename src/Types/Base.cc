@@ -1,16 +1,23 @@
 #include "Base.hh"
 #include "PyAsyncObjects.hh"
+#include "PyBufferObjects.hh"
 #include "PyCellObject.hh"
 #include "PyCodeObject.hh"
+#include "PyContextObjects.hh"
+#include "PyDequeObject.hh"
 #include "PyDictObject.hh"
+#include "PyExceptionObjects.hh"
 #include "PyFloatObject.hh"
 #include "PyFrameObject.hh"
+#include "PyFunctionObjects.hh"
 #include "PyGeneratorObjects.hh"
 #include "PyIntegerObjects.hh"
 #include "PyListObject.hh"
 #include "PyObject.hh"
 #include "PySetObject.hh"
+#include "PySimpleQueueObject.hh"
 #include "PyStringObjects.hh"
+#include "PyThreadLockObjects.hh"
 #include "PyTupleObject.hh"
 #include "PyTypeObject.hh"
 
@@ -81,6 +88,16 @@ const char* Environment::invalid_reason(MappedPtr<PyObject> addr, MappedPtr<PyTy
       return this->r.get(addr.cast<PyBytesObject>()).invalid_reason(*this);
     } else if (obj.ob_type == this->get_type_if_exists("str")) {
       return this->r.get(addr.cast<PyASCIIStringObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("bytearray")) {
+      return this->r.get(addr.cast<PyByteArrayObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("array.array")) {
+      return this->r.get(addr.cast<PyArrayArrayObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("memoryview")) {
+      return this->r.get(addr.cast<PyMemoryViewObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("managedbuffer")) {
+      return this->r.get(addr.cast<PyManagedBufferObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("numpy.ndarray")) {
+      return this->r.get(addr.cast<NumpyArrayObject>()).invalid_reason(*this);
 
     } else if (obj.ob_type == this->get_type_if_exists("tuple")) {
       return this->r.get(addr.cast<PyTupleObject>()).invalid_reason(*this);
@@ -90,6 +107,8 @@ const char* Environment::invalid_reason(MappedPtr<PyObject> addr, MappedPtr<PyTy
       return this->r.get(addr.cast<PySetObject>()).invalid_reason(*this);
     } else if (obj.ob_type == this->get_type_if_exists("dict")) {
       return this->r.get(addr.cast<PyDictObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("collections.deque")) {
+      return this->r.get(addr.cast<PyDequeObject>()).invalid_reason(*this);
 
     } else if (obj.ob_type == this->get_type_if_exists("code")) {
       return this->r.get(addr.cast<PyCodeObject>()).invalid_reason(*this);
@@ -112,6 +131,34 @@ const char* Environment::invalid_reason(MappedPtr<PyObject> addr, MappedPtr<PyTy
     } else if (obj.ob_type == this->get_type_if_exists("_GatheringFuture")) {
       return this->r.get(addr.cast<PyAsyncGatheringFutureObject>()).invalid_reason(*this);
 
+    } else if (obj.ob_type == this->get_type_if_exists("_thread.lock")) {
+      return this->r.get(addr.cast<PyThreadLockObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("_thread.RLock")) {
+      return this->r.get(addr.cast<PyThreadRLockObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("_queue.SimpleQueue")) {
+      return this->r.get(addr.cast<PySimpleQueueObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("functools._lru_cache_wrapper")) {
+      return this->r.get(addr.cast<PyLruCacheObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("functools._lru_list_elem")) {
+      return this->r.get(addr.cast<PyLruListElemObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("Context")) {
+      return this->r.get(addr.cast<PyContextObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("ContextVar")) {
+      return this->r.get(addr.cast<PyContextVarObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("hamt")) {
+      return this->r.get(addr.cast<PyHamtObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("hamt_bitmap_node")) {
+      return this->r.get(addr.cast<PyHamtNodeBitmapObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("hamt_array_node")) {
+      return this->r.get(addr.cast<PyHamtNodeArrayObject>()).invalid_reason(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("hamt_collision_node")) {
+      return this->r.get(addr.cast<PyHamtNodeCollisionObject>()).invalid_reason(*this);
+
+    } else if (obj.ob_type == this->get_type_if_exists("traceback")) {
+      return this->r.get(addr.cast<PyTracebackObject>()).invalid_reason(*this);
+    } else if (type_obj.tp_flags & Py_TPFLAGS_BASE_EXC_SUBCLASS) {
+      return this->r.get(addr.cast<PyBaseExceptionObject>()).invalid_reason(*this);
+
     } else {
       auto type_name = type_obj.name(this->r);
       if (type_name == "NoneType") {
@@ -160,6 +207,16 @@ std::unordered_set<MappedPtr<void>> Environment::direct_referents(MappedPtr<PyOb
       return this->r.get(addr.cast<PyBytesObject>()).direct_referents(*this);
     } else if (obj.ob_type == this->get_type_if_exists("str")) {
       return this->r.get(addr.cast<PyASCIIStringObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("bytearray")) {
+      return this->r.get(addr.cast<PyByteArrayObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("array.array")) {
+      return this->r.get(addr.cast<PyArrayArrayObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("memoryview")) {
+      return this->r.get(addr.cast<PyMemoryViewObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("managedbuffer")) {
+      return this->r.get(addr.cast<PyManagedBufferObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("numpy.ndarray")) {
+      return this->r.get(addr.cast<NumpyArrayObject>()).direct_referents(*this);
 
     } else if (obj.ob_type == this->get_type_if_exists("tuple")) {
       return this->r.get(addr.cast<PyTupleObject>()).direct_referents(*this);
@@ -169,6 +226,8 @@ std::unordered_set<MappedPtr<void>> Environment::direct_referents(MappedPtr<PyOb
       return this->r.get(addr.cast<PySetObject>()).direct_referents(*this);
     } else if (obj.ob_type == this->get_type_if_exists("dict")) {
       return this->r.get(addr.cast<PyDictObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("collections.deque")) {
+      return this->r.get(addr.cast<PyDequeObject>()).direct_referents(*this);
 
     } else if (obj.ob_type == this->get_type_if_exists("code")) {
       return this->r.get(addr.cast<PyCodeObject>()).direct_referents(*this);
@@ -191,6 +250,34 @@ std::unordered_set<MappedPtr<void>> Environment::direct_referents(MappedPtr<PyOb
     } else if (obj.ob_type == this->get_type_if_exists("_GatheringFuture")) {
       return this->r.get(addr.cast<PyAsyncGatheringFutureObject>()).direct_referents(*this);
 
+    } else if (obj.ob_type == this->get_type_if_exists("_thread.lock")) {
+      return this->r.get(addr.cast<PyThreadLockObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("_thread.RLock")) {
+      return this->r.get(addr.cast<PyThreadRLockObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("_queue.SimpleQueue")) {
+      return this->r.get(addr.cast<PySimpleQueueObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("functools._lru_cache_wrapper")) {
+      return this->r.get(addr.cast<PyLruCacheObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("functools._lru_list_elem")) {
+      return this->r.get(addr.cast<PyLruListElemObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("Context")) {
+      return this->r.get(addr.cast<PyContextObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("ContextVar")) {
+      return this->r.get(addr.cast<PyContextVarObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("hamt")) {
+      return this->r.get(addr.cast<PyHamtObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("hamt_bitmap_node")) {
+      return this->r.get(addr.cast<PyHamtNodeBitmapObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("hamt_array_node")) {
+      return this->r.get(addr.cast<PyHamtNodeArrayObject>()).direct_referents(*this);
+    } else if (obj.ob_type == this->get_type_if_exists("hamt_collision_node")) {
+      return this->r.get(addr.cast<PyHamtNodeCollisionObject>()).direct_referents(*this);
+
+    } else if (obj.ob_type == this->get_type_if_exists("traceback")) {
+      return this->r.get(addr.cast<PyTracebackObject>()).direct_referents(*this);
+    } else if (this->r.get(obj.ob_type).tp_flags & Py_TPFLAGS_BASE_EXC_SUBCLASS) {
+      return this->r.get(addr.cast<PyBaseExceptionObject>()).direct_referents(*this);
+
     } else {
       const auto& type_obj = this->r.get(obj.ob_type);
       if (type_obj.invalid_reason(*this)) {
@@ -223,6 +310,229 @@ std::unordered_set<MappedPtr<void>> Environment::direct_referents(MappedPtr<PyOb
   }
 }
 
+MappedPtr<PyDictObject> Environment::instance_dict(MappedPtr<PyObject> addr) const {
+  try {
+    auto dict_addr = this->r.get(addr.offset_bytes(0x10).cast<MappedPtr<PyDictObject>>());
+    if (!this->r.obj_valid(dict_addr)) {
+      return MappedPtr<PyDictObject>();
+    }
+    const auto& dict_obj = this->r.get(dict_addr);
+    if ((dict_obj.ob_type != this->get_type_if_exists("dict")) || dict_obj.invalid_reason(*this)) {
+      return MappedPtr<PyDictObject>();
+    }
+    return dict_addr;
+  } catch (const std::out_of_range&) {
+    return MappedPtr<PyDictObject>();
+  }
+}
+
+MappedPtr<PyObject> Environment::get_attribute(MappedPtr<PyObject> addr, const std::string& name) const {
+  try {
+    const auto& type_obj = this->r.get(this->r.get(addr).ob_type);
+    try {
+      return this->r.get(addr.offset_bytes(type_obj.member_offset(*this, name)).cast<MappedPtr<PyObject>>());
+    } catch (const std::out_of_range&) {
+    }
+
+    // Negative dict offsets are only used by variable-size types, which we don't need to support here
+    if (type_obj.tp_dictoffset <= 0) {
+      return MappedPtr<PyObject>();
+    }
+    auto dict_addr = this->r.get(addr.offset_bytes(type_obj.tp_dictoffset).cast<MappedPtr<PyDictObject>>());
+    if (!this->r.obj_valid(dict_addr)) {
+      return MappedPtr<PyObject>();
+    }
+    const auto& dict_obj = this->r.get(dict_addr);
+    if ((dict_obj.ob_type != this->get_type_if_exists("dict")) || dict_obj.invalid_reason(*this)) {
+      return MappedPtr<PyObject>();
+    }
+    return dict_obj.value_for_key<PyObject>(this->r, name);
+
+  } catch (const std::out_of_range&) {
+    return MappedPtr<PyObject>();
+  }
+}
+
+size_t Environment::shallow_size(MappedPtr<PyObject> addr) const {
+  // See the various __sizeof__ implementations in https://github.com/python/cpython/tree/3.10/Objects and
+  // sys.getsizeof in https://github.com/python/cpython/blob/3.10/Python/sysmodule.c
+  const auto& obj = this->r.get(addr);
+  const auto& type_obj = this->r.get(obj.ob_type);
+  size_t gc_header_size = type_obj.is_gc() ? 0x10 : 0;
+
+  if (obj.ob_type == this->get_type_if_exists("str")) {
+    return get_string_representation_sizes(this->r, addr).total_bytes();
+
+  } else if (obj.ob_type == this->get_type_if_exists("dict")) {
+    const auto& dict = this->r.get(addr.cast<PyDictObject>());
+    const auto& keys = this->r.get(dict.ma_keys);
+    size_t ret = type_obj.tp_basicsize + gc_header_size;
+    if (!dict.ma_values.is_null()) {
+      ret += keys.usable_fraction() * sizeof(MappedPtr<PyObject>);
+    }
+    if (keys.dk_refcnt == 1) {
+      ret += keys.allocated_size();
+    }
+    return ret;
+
+  } else if (obj.ob_type == this->get_type_if_exists("list")) {
+    const auto& list = this->r.get(addr.cast<PyListObject>());
+    return type_obj.tp_basicsize + list.allocated * sizeof(MappedPtr<PyObject>) + gc_header_size;
+
+  } else if ((obj.ob_type == this->get_type_if_exists("set")) || (obj.ob_type == this->get_type_if_exists("frozenset"))) {
+    const auto& set = this->r.get(addr.cast<PySetObject>());
+    size_t ret = type_obj.tp_basicsize + gc_header_size;
+    if (set.table != addr.offset_bytes(sizeof(PySetObject)).cast<PySetObject::Entry>()) {
+      ret += (set.mask + 1) * sizeof(PySetObject::Entry);
+    }
+    return ret;
+
+  } else if (obj.ob_type == this->get_type_if_exists("collections.deque")) {
+    // deque.__sizeof__ counts the blocks in use, but not the cached free blocks
+    const auto& deque = this->r.get(addr.cast<PyDequeObject>());
+    return type_obj.tp_basicsize + deque.num_blocks() * sizeof(PyDequeObject::Block) + gc_header_size;
+
+  } else if (obj.ob_type == this->get_type_if_exists("bytearray")) {
+    return type_obj.tp_basicsize + this->r.get(addr.cast<PyByteArrayObject>()).ob_alloc + gc_header_size;
+
+  } else if (obj.ob_type == this->get_type_if_exists("array.array")) {
+    const auto& array = this->r.get(addr.cast<PyArrayArrayObject>());
+    return type_obj.tp_basicsize + array.allocated_bytes(this->r) + gc_header_size;
+
+  } else if (obj.ob_type == this->get_type_if_exists("numpy.ndarray")) {
+    // Like ndarray.__sizeof__, this includes the dimensions and strides, and the data only if the array owns it. Views
+    // (including memoryviews) don't count the data they refer to, so each buffer is only counted once.
+    const auto& array = this->r.get(addr.cast<NumpyArrayObject>());
+    size_t ret = type_obj.tp_basicsize + array.nd * 2 * sizeof(int64_t) + gc_header_size;
+    if (array.owns_data()) {
+      ret += array.data_bytes(this->r);
+    }
+    return ret;
+
+  } else {
+    size_t ret = type_obj.tp_basicsize + gc_header_size;
+    if (type_obj.tp_itemsize) {
+      int64_t ob_size = this->r.get(addr.cast<PyVarObject>()).ob_size;
+      ret += ((ob_size < 0) ? -ob_size : ob_size) * type_obj.tp_itemsize;
+    }
+    return ret;
+  }
+}
+
+std::vector<std::pair<const char*, MappedPtr<void>>> Environment::owned_allocations(MappedPtr<PyObject> addr) const {
+  std::vector<std::pair<const char*, MappedPtr<void>>> ret;
+  const auto& obj = this->r.get(addr);
+  if (obj.ob_type == this->get_type_if_exists("str")) {
+    // Compact strings' data is part of the object, so only the caches can be separate allocations
+    const auto& str = this->r.get(addr.cast<PyASCIIStringObject>());
+    MappedPtr<void> data_addr;
+    if (str.is_compact() && str.is_ascii()) {
+      data_addr = addr.offset_bytes(sizeof(PyASCIIStringObject));
+    } else if (str.is_compact()) {
+      data_addr = addr.offset_bytes(sizeof(PyCompactStringObject));
+    } else {
+      data_addr = this->r.get(addr.cast<PyGeneralStringObject>()).data;
+      if (!data_addr.is_null()) {
+        ret.emplace_back("data", data_addr);
+      }
+    }
+    if (!str.wstr.is_null() && (str.wstr != data_addr)) {
+      ret.emplace_back("wstr", str.wstr);
+    }
+    if (!str.is_compact() || !str.is_ascii()) {
+      const auto& compact_str = this->r.get(addr.cast<PyCompactStringObject>());
+      if (!compact_str.utf8.is_null() && (compact_str.utf8 != data_addr)) {
+        ret.emplace_back("utf8", compact_str.utf8);
+      }
+    }
+
+  } else if (obj.ob_type == this->get_type_if_exists("dict")) {
+    const auto& dict = this->r.get(addr.cast<PyDictObject>());
+    if (this->r.get(dict.ma_keys).dk_refcnt == 1) {
+      ret.emplace_back("ma_keys", dict.ma_keys);
+    }
+    if (!dict.ma_values.is_null()) {
+      ret.emplace_back("ma_values", dict.ma_values);
+    }
+
+  } else if (obj.ob_type == this->get_type_if_exists("list")) {
+    const auto& list = this->r.get(addr.cast<PyListObject>());
+    if (!list.ob_item.is_null()) {
+      ret.emplace_back("ob_item", list.ob_item);
+    }
+
+  } else if ((obj.ob_type == this->get_type_if_exists("set")) || (obj.ob_type == this->get_type_if_exists("frozenset"))) {
+    const auto& set = this->r.get(addr.cast<PySetObject>());
+    if (set.table != addr.offset_bytes(sizeof(PySetObject)).cast<PySetObject::Entry>()) {
+      ret.emplace_back("table", set.table);
+    }
+
+  } else if (obj.ob_type == this->get_type_if_exists("collections.deque")) {
+    const auto& deque = this->r.get(addr.cast<PyDequeObject>());
+    for (auto block_addr : deque.get_blocks(this->r)) {
+      ret.emplace_back("block", block_addr);
+    }
+    for (int64_t z = 0; z < deque.numfreeblocks; z++) {
+      ret.emplace_back("freeblock", deque.freeblocks[z]);
+    }
+
+  } else if (obj.ob_type == this->get_type_if_exists("bytearray")) {
+    const auto& bytearray = this->r.get(addr.cast<PyByteArrayObject>());
+    if (!bytearray.ob_bytes.is_null()) {
+      ret.emplace_back("ob_bytes", bytearray.ob_bytes);
+    }
+
+  } else if (obj.ob_type == this->get_type_if_exists("array.array")) {
+    const auto& array = this->r.get(addr.cast<PyArrayArrayObject>());
+    if (!array.ob_item.is_null()) {
+      ret.emplace_back("ob_item", array.ob_item);
+    }
+
+  } else if (obj.ob_type == this->get_type_if_exists("numpy.ndarray")) {
+    const auto& array = this->r.get(addr.cast<NumpyArrayObject>());
+    if (!array.dimensions.is_null()) {
+      ret.emplace_back("dimensions", array.dimensions);
+    }
+    if (array.owns_data()) {
+      ret.emplace_back("data", array.data);
+    }
+  }
+  return ret;
+}
+
+size_t Environment::retained_size(MappedPtr<PyObject> addr, size_t max_objects) const {
+  std::unordered_set<MappedPtr<PyObject>> seen;
+  std::vector<MappedPtr<PyObject>> pending{addr};
+  size_t ret = 0;
+  while (!pending.empty() && (seen.size() < max_objects)) {
+    auto obj_addr = pending.back();
+    pending.pop_back();
+    if (!seen.emplace(obj_addr).second) {
+      continue;
+    }
+    try {
+      ret += this->shallow_size(obj_addr);
+      for (auto referent : this->direct_referents(obj_addr)) {
+        auto referent_addr = referent.cast<PyObject>();
+        if (!this->r.obj_valid(referent_addr) || seen.count(referent_addr)) {
+          continue;
+        }
+        // Type objects are never exclusively owned by their instances, even if their refcounts say otherwise
+        const auto& referent_obj = this->r.get(referent_addr);
+        if ((referent_obj.ob_refcnt != 1) || (referent_obj.ob_type == this->base_type_object)) {
+          continue;
+        }
+        if (!this->invalid_reason(referent_addr)) {
+          pending.emplace_back(referent_addr);
+        }
+      }
+    } catch (const invalid_object&) {
+    } catch (const std::out_of_range&) {
+    }
+  }
+  return ret;
+}
+
 Traversal Environment::traverse(phosg::Arguments* args) const {
   return Traversal(*this, args);
 }
@@ -284,6 +594,16 @@ std::string Traversal::repr(MappedPtr<PyObject> addr) {
     } else if (obj.ob_type == this->env.get_type_if_exists("str")) {
       ret = check_valid_and_repr.template operator()<PyASCIIStringObject>();
       show_address = this->show_all_addresses || this->in_progress.empty();
+    } else if (obj.ob_type == this->env.get_type_if_exists("bytearray")) {
+      ret = check_valid_and_repr.template operator()<PyByteArrayObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("array.array")) {
+      ret = check_valid_and_repr.template operator()<PyArrayArrayObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("memoryview")) {
+      ret = check_valid_and_repr.template operator()<PyMemoryViewObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("managedbuffer")) {
+      ret = check_valid_and_repr.template operator()<PyManagedBufferObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("numpy.ndarray")) {
+      ret = check_valid_and_repr.template operator()<NumpyArrayObject>();
 
     } else if (obj.ob_type == this->env.get_type_if_exists("tuple")) {
       ret = check_valid_and_repr.template operator()<PyTupleObject>();
@@ -297,6 +617,9 @@ std::string Traversal::repr(MappedPtr<PyObject> addr) {
     } else if (obj.ob_type == this->env.get_type_if_exists("dict")) {
       ret = check_valid_and_repr.template operator()<PyDictObject>();
       show_address = this->show_all_addresses || this->in_progress.empty();
+    } else if (obj.ob_type == this->env.get_type_if_exists("collections.deque")) {
+      ret = check_valid_and_repr.template operator()<PyDequeObject>();
+      show_address = this->show_all_addresses || this->in_progress.empty();
 
     } else if (obj.ob_type == this->env.get_type_if_exists("code")) {
       ret = check_valid_and_repr.template operator()<PyCodeObject>();
@@ -319,6 +642,34 @@ std::string Traversal::repr(MappedPtr<PyObject> addr) {
     } else if (obj.ob_type == this->env.get_type_if_exists("_GatheringFuture")) {
       ret = check_valid_and_repr.template operator()<PyAsyncGatheringFutureObject>();
 
+    } else if (obj.ob_type == this->env.get_type_if_exists("_thread.lock")) {
+      ret = check_valid_and_repr.template operator()<PyThreadLockObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("_thread.RLock")) {
+      ret = check_valid_and_repr.template operator()<PyThreadRLockObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("_queue.SimpleQueue")) {
+      ret = check_valid_and_repr.template operator()<PySimpleQueueObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("functools._lru_cache_wrapper")) {
+      ret = check_valid_and_repr.template operator()<PyLruCacheObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("functools._lru_list_elem")) {
+      ret = check_valid_and_repr.template operator()<PyLruListElemObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("Context")) {
+      ret = check_valid_and_repr.template operator()<PyContextObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("ContextVar")) {
+      ret = check_valid_and_repr.template operator()<PyContextVarObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("hamt")) {
+      ret = check_valid_and_repr.template operator()<PyHamtObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("hamt_bitmap_node")) {
+      ret = check_valid_and_repr.template operator()<PyHamtNodeBitmapObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("hamt_array_node")) {
+      ret = check_valid_and_repr.template operator()<PyHamtNodeArrayObject>();
+    } else if (obj.ob_type == this->env.get_type_if_exists("hamt_collision_node")) {
+      ret = check_valid_and_repr.template operator()<PyHamtNodeCollisionObject>();
+
+    } else if (obj.ob_type == this->env.get_type_if_exists("traceback")) {
+      ret = check_valid_and_repr.template operator()<PyTracebackObject>();
+    } else if (type_obj.tp_flags & Py_TPFLAGS_BASE_EXC_SUBCLASS) {
+      ret = check_valid_and_repr.template operator()<PyBaseExceptionObject>();
+
     } else {
       auto type_name = type_obj.name(this->env.r);
       if (type_name == "NoneType") {
@@ -10,6 +10,7 @@
 
 struct PyObject;
 struct PyTypeObject;
+struct PyDictObject;
 struct Traversal;
 
 class invalid_object : public std::runtime_error {
@@ -53,6 +54,30 @@ struct Environment {
       MappedPtr<PyObject> addr, MappedPtr<PyTypeObject> expected_type = MappedPtr<PyTypeObject>{0}) const;
   std::unordered_set<MappedPtr<void>> direct_referents(MappedPtr<PyObject> addr) const;
 
+  // Returns the __dict__ of an instance of a Python-defined class (the same +0x10 dict that invalid_reason and repr
+  // use for types that aren't implemented here), or null if the object doesn't have a valid dict there.
+  MappedPtr<PyDictObject> instance_dict(MappedPtr<PyObject> addr) const;
+
+  // Returns the value of the named attribute of an instance, looking first in the type's object members (which is
+  // where __slots__ attributes are stored) and then in the instance's __dict__ (found via tp_dictoffset). Returns null
+  // if the attribute isn't set on the instance; class attributes and properties aren't considered.
+  MappedPtr<PyObject> get_attribute(MappedPtr<PyObject> addr, const std::string& name) const;
+
+  // Returns the number of bytes used by the object itself, including out-of-line storage that only it owns (e.g. a
+  // list's item array or a dict's keys table) and the GC header, but not any referenced objects. This matches what
+  // sys.getsizeof would return in the target process. The object must be valid (as per invalid_reason).
+  size_t shallow_size(MappedPtr<PyObject> addr) const;
+
+  // Returns the out-of-line allocations that the object owns (e.g. a list's item array or a non-compact string's
+  // data), as (field name, pointer) pairs. The object itself isn't included. The object must be valid.
+  std::vector<std::pair<const char*, MappedPtr<void>>> owned_allocations(MappedPtr<PyObject> addr) const;
+
+  // Returns the shallow size of the object plus that of every object reachable from it only through objects with
+  // refcount 1. This is a lower bound on the memory that would be freed if the object were freed; it doesn't count
+  // objects that have multiple references even if all of them come from within the same subgraph. Stops after
+  // visiting max_objects objects.
+  size_t retained_size(MappedPtr<PyObject> addr, size_t max_objects = 0x10000) const;
+
   Traversal traverse(phosg::Arguments* args = nullptr) const; // Can't be inlined because Traversal is incomplete here
 };
 
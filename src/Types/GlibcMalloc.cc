@@ -0,0 +1,340 @@
+#include "GlibcMalloc.hh"
+
+#include <algorithm>
+
+const char* GlibcMallocState::invalid_reason(const MemoryReader& r) const {
+  if (!r.obj_valid(this->top, GlibcMallocChunk::ALIGNMENT)) {
+    return "invalid_top";
+  }
+  if (!r.obj_valid(this->next)) {
+    return "invalid_next";
+  }
+  if (this->system_mem > this->max_system_mem) {
+    return "invalid_system_mem";
+  }
+  return nullptr;
+}
+
+const char* GlibcHeapInfo::invalid_reason(const MemoryReader& r) const {
+  if (!r.obj_valid(this->ar_ptr)) {
+    return "invalid_ar_ptr";
+  }
+  if (!this->prev.is_null() && (this->prev.addr & (HEAP_MAX_SIZE - 1))) {
+    return "invalid_prev";
+  }
+  // Heap sizes are always multiples of the page size
+  if ((this->size < 0x1000) || (this->size & 0xFFF) || (this->size > this->mprotect_size) ||
+      (this->mprotect_size > HEAP_MAX_SIZE)) {
+    return "invalid_size";
+  }
+  return nullptr;
+}
+
+size_t GlibcHeapInfo::header_size(const MemoryReader& r, MappedPtr<GlibcHeapInfo> addr) const {
+  static constexpr size_t candidate_sizes[2] = {HEADER_SIZE_PRE_2_35, HEADER_SIZE_2_35};
+  // The first heap in each arena is followed immediately by the arena, so its header size is unambiguous
+  for (size_t candidate : candidate_sizes) {
+    if (this->ar_ptr == addr.offset_bytes(candidate).cast<GlibcMallocState>()) {
+      return candidate;
+    }
+  }
+  // For later heaps, the first chunk begins right after the header. It always has PREV_INUSE set and must fit in the
+  // heap. In the 2.35 layout, the word where the older layout's first chunk size would be is padding (and is zero),
+  // so at most one candidate can match.
+  for (size_t candidate : candidate_sizes) {
+    try {
+      const auto& chunk = r.get(addr.offset_bytes(candidate).cast<GlibcMallocChunk>());
+      size_t chunk_size = chunk.size();
+      if (chunk.prev_in_use() && (chunk_size >= GlibcMallocChunk::MIN_SIZE) &&
+          !(chunk_size & (GlibcMallocChunk::ALIGNMENT - 1)) && (candidate + chunk_size <= this->size)) {
+        return candidate;
+      }
+    } catch (const std::out_of_range&) {
+    }
+  }
+  return 0;
+}
+
+const char* GlibcTcachePerthread::invalid_reason(const MemoryReader& r) const {
+  for (size_t z = 0; z < NUM_BINS; z++) {
+    // The default limit is 7 entries per bin; anything much larger than that is probably not a tcache
+    if (this->counts[z] > 0x400) {
+      return "invalid_count";
+    }
+    if ((this->counts[z] == 0) != this->entries[z].is_null()) {
+      return "inconsistent_entry";
+    }
+    if (!this->entries[z].is_null() && !r.obj_valid(this->entries[z], GlibcMallocChunk::ALIGNMENT)) {
+      return "invalid_entry";
+    }
+  }
+  return nullptr;
+}
+
+// glibc 2.32 and later mangle free list pointers with the address they're stored at ("safe-linking"); earlier
+// versions don't. Mangled pointers are almost never aligned, so we can tell which case applies for each pointer.
+static MappedPtr<void> read_free_list_ptr(const MemoryReader& r, MappedPtr<void> field_addr) {
+  uint64_t raw = r.get(field_addr.cast<uint64_t>());
+  uint64_t demangled = raw ^ (field_addr.addr >> 12);
+  if ((raw == 0) || (demangled == 0)) {
+    return MappedPtr<void>();
+  }
+  for (uint64_t candidate : {raw, demangled}) {
+    if (r.obj_valid(MappedPtr<void>(candidate), GlibcMallocChunk::ALIGNMENT)) {
+      return MappedPtr<void>(candidate);
+    }
+  }
+  return MappedPtr<void>();
+}
+
+static void walk_heap_chunks(
+    const MemoryReader& r, GlibcMallocHeap& heap, MappedPtr<GlibcMallocChunk> first_chunk,
+    MappedPtr<GlibcMallocChunk> top) {
+  using ChunkState = GlibcMallocHeap::ChunkState;
+  auto end = heap.start.offset_bytes(heap.size).cast<GlibcMallocChunk>();
+  heap.walk_complete = false;
+  try {
+    for (auto addr = first_chunk; addr.offset_bytes(GlibcMallocChunk::HEADER_SIZE) <= end;) {
+      const auto& chunk = r.get(addr);
+      size_t size = chunk.size();
+      // A chunk's PREV_INUSE bit is the only record of whether the previous chunk is allocated
+      if (!heap.chunks.empty() && (heap.chunks.back().state == ChunkState::IN_USE) && !chunk.prev_in_use()) {
+        heap.chunks.back().state = ChunkState::FREE;
+      }
+      // Heaps that are no longer their arena's top end with two fenceposts; the last one has size 0
+      if ((size == 0) && (addr.offset_bytes(GlibcMallocChunk::FENCEPOST_SIZE) == end)) {
+        heap.chunks.emplace_back(GlibcMallocHeap::Chunk{addr, GlibcMallocChunk::FENCEPOST_SIZE, ChunkState::OVERHEAD});
+        heap.walk_complete = true;
+        break;
+      }
+      if ((size < GlibcMallocChunk::FENCEPOST_SIZE) || (size & (GlibcMallocChunk::ALIGNMENT - 1)) ||
+          (addr.offset_bytes(size) > end)) {
+        break;
+      }
+      ChunkState state = (size == GlibcMallocChunk::FENCEPOST_SIZE)
+          ? ChunkState::OVERHEAD
+          : (addr == top) ? ChunkState::TOP
+                          : ChunkState::IN_USE;
+      heap.chunks.emplace_back(GlibcMallocHeap::Chunk{addr, size, state});
+      addr = addr.offset_bytes(size);
+      if ((state == ChunkState::TOP) || (addr == end)) {
+        heap.walk_complete = true;
+        break;
+      }
+    }
+  } catch (const std::out_of_range&) {
+  }
+
+  // If we don't know where the top chunk is, assume it's the last chunk in the heap, as it almost always is
+  if (top.is_null() && heap.walk_complete && !heap.chunks.empty() &&
+      (heap.chunks.back().state != ChunkState::OVERHEAD)) {
+    heap.chunks.back().state = ChunkState::TOP;
+  }
+}
+
+std::vector<GlibcMallocHeap> find_glibc_malloc_heaps(const MemoryReader& r) {
+  using Kind = GlibcMallocHeap::Kind;
+  using ChunkState = GlibcMallocHeap::ChunkState;
+  auto regions = r.all_regions();
+  std::vector<GlibcMallocHeap> heaps;
+
+  // Non-main heaps are aligned to HEAP_MAX_SIZE, so we only need to check those addresses
+  std::unordered_set<MappedPtr<GlibcMallocState>> arenas;
+  for (const auto& [region_start, region_size] : regions) {
+    uint64_t region_end = region_start.addr + region_size;
+    uint64_t info_addr = (region_start.addr + GlibcHeapInfo::HEAP_MAX_SIZE - 1) & ~(GlibcHeapInfo::HEAP_MAX_SIZE - 1);
+    for (; info_addr + sizeof(GlibcHeapInfo) <= region_end; info_addr += GlibcHeapInfo::HEAP_MAX_SIZE) {
+      try {
+        const auto& info = r.get(MappedPtr<GlibcHeapInfo>(info_addr));
+        if (info.invalid_reason(r) || !r.exists_range(MappedPtr<void>(info_addr), info.size)) {
+          continue;
+        }
+        const auto& arena = r.get(info.ar_ptr);
+        if (arena.invalid_reason(r)) {
+          continue;
+        }
+        size_t header_size = info.header_size(r, MappedPtr<GlibcHeapInfo>(info_addr));
+        uint64_t first_chunk_addr = info_addr + header_size;
+        if (info.ar_ptr.addr == first_chunk_addr) {
+          first_chunk_addr = (first_chunk_addr + sizeof(GlibcMallocState) + GlibcMallocChunk::ALIGNMENT - 1) &
+              ~(GlibcMallocChunk::ALIGNMENT - 1);
+        }
+        auto& heap = heaps.emplace_back(GlibcMallocHeap{
+            .kind = Kind::NON_MAIN,
+            .start = MappedPtr<void>(info_addr),
+            .size = info.size,
+            .arena = info.ar_ptr,
+            .chunks = {},
+            .walk_complete = false});
+        // If the header layout couldn't be determined, the heap is still reported, but its chunks can't be walked
+        if (header_size) {
+          walk_heap_chunks(r, heap, MappedPtr<GlibcMallocChunk>(first_chunk_addr), arena.top);
+        }
+        arenas.emplace(info.ar_ptr);
+      } catch (const std::out_of_range&) {
+      }
+    }
+  }
+
+  // The main arena is a static variable in libc, so it isn't in any heap, but it's in the same circular list as all
+  // the other arenas. If the process never created another arena, we have to find the main heap by its first chunk
+  // instead, which is always the main thread's tcache.
+  MappedPtr<GlibcMallocState> main_arena;
+  if (!arenas.empty()) {
+    try {
+      auto first_arena = *arenas.begin();
+      auto arena = r.get(first_arena).next;
+      for (size_t z = 0; (z < 0x400) && (arena != first_arena); z++, arena = r.get(arena).next) {
+        if (!arenas.count(arena)) {
+          if (!r.get(arena).invalid_reason(r)) {
+            main_arena = arena;
+          }
+          break;
+        }
+      }
+    } catch (const std::out_of_range&) {
+    }
+  }
+  auto is_in_known_heap = [&](MappedPtr<void> addr) -> bool {
+    for (const auto& heap : heaps) {
+      if ((addr >= heap.start) && (addr < heap.start.offset_bytes(heap.size))) {
+        return true;
+      }
+    }
+    return false;
+  };
+  auto add_main_heap = [&](MappedPtr<void> start, size_t size, MappedPtr<GlibcMallocChunk> top) -> void {
+    auto& heap = heaps.emplace_back(GlibcMallocHeap{
+        .kind = Kind::MAIN,
+        .start = start,
+        .size = size,
+        .arena = main_arena,
+        .chunks = {},
+        .walk_complete = false});
+    walk_heap_chunks(r, heap, start.cast<GlibcMallocChunk>(), top);
+  };
+  if (!main_arena.is_null()) {
+    try {
+      const auto& arena = r.get(main_arena);
+      auto [region_start, region_size] = r.region_for_address(arena.top);
+      if (!is_in_known_heap(region_start)) {
+        add_main_heap(region_start, region_size, arena.top);
+      }
+    } catch (const std::out_of_range&) {
+    }
+  } else {
+    static constexpr size_t tcache_chunk_size = sizeof(GlibcTcachePerthread) + GlibcMallocChunk::HEADER_SIZE;
+    for (const auto& [region_start, region_size] : regions) {
+      if (region_size < tcache_chunk_size + GlibcMallocChunk::MIN_SIZE) {
+        continue;
+      }
+      const auto& chunk = r.get(region_start.cast<GlibcMallocChunk>());
+      if ((chunk.mchunk_prev_size == 0) && (chunk.mchunk_size == (tcache_chunk_size | GlibcMallocChunk::PREV_INUSE)) &&
+          !r.get(region_start.offset_bytes(GlibcMallocChunk::HEADER_SIZE).cast<GlibcTcachePerthread>()).invalid_reason(r)) {
+        add_main_heap(region_start, region_size, MappedPtr<GlibcMallocChunk>());
+      }
+    }
+  }
+
+  // Allocations above the mmap threshold get their own mappings. Adjacent mappings are often merged into a single
+  // region, so we walk each region until we find something that isn't an mmapped chunk.
+  for (const auto& [region_start, region_size] : regions) {
+    if (is_in_known_heap(region_start)) {
+      continue;
+    }
+    GlibcMallocHeap heap{
+        .kind = Kind::MMAPPED,
+        .start = region_start,
+        .size = 0,
+        .arena = MappedPtr<GlibcMallocState>(),
+        .chunks = {},
+        .walk_complete = true};
+    auto region_end = region_start.offset_bytes(region_size).cast<GlibcMallocChunk>();
+    for (auto addr = region_start.cast<GlibcMallocChunk>(); addr.offset_bytes(GlibcMallocChunk::HEADER_SIZE) <= region_end;) {
+      const auto& chunk = r.get(addr);
+      size_t size = chunk.size();
+      if ((chunk.mchunk_prev_size != 0) || ((chunk.mchunk_size & GlibcMallocChunk::SIZE_BITS) != GlibcMallocChunk::IS_MMAPPED) ||
+          (size == 0) || (size & 0xFFF) || (addr.offset_bytes(size) > region_end)) {
+        break;
+      }
+      heap.chunks.emplace_back(GlibcMallocHeap::Chunk{addr, size, ChunkState::IN_USE});
+      heap.size += size;
+      addr = addr.offset_bytes(size);
+    }
+    if (!heap.chunks.empty()) {
+      heaps.emplace_back(std::move(heap));
+    }
+  }
+
+  std::sort(heaps.begin(), heaps.end(), [](const auto& a, const auto& b) -> bool {
+    return a.start < b.start;
+  });
+
+  // Chunks in tcaches and fastbins look allocated to their neighbors, so we have to find them from the free lists
+  auto find_chunk = [&](MappedPtr<GlibcMallocChunk> addr) -> GlibcMallocHeap::Chunk* {
+    auto heap_it = std::upper_bound(heaps.begin(), heaps.end(), addr, [](const auto& addr, const auto& heap) -> bool {
+      return addr < heap.start;
+    });
+    if (heap_it == heaps.begin()) {
+      return nullptr;
+    }
+    auto& chunks = (--heap_it)->chunks;
+    auto chunk_it = std::lower_bound(chunks.begin(), chunks.end(), addr, [](const auto& chunk, const auto& addr) -> bool {
+      return chunk.addr < addr;
+    });
+    return ((chunk_it != chunks.end()) && (chunk_it->addr == addr)) ? &(*chunk_it) : nullptr;
+  };
+  auto mark_cached = [&](MappedPtr<GlibcMallocChunk> addr) -> bool {
+    auto* chunk = find_chunk(addr);
+    if (!chunk || (chunk->state != ChunkState::IN_USE)) {
+      return false;
+    }
+    chunk->state = ChunkState::CACHED;
+    return true;
+  };
+
+  if (!main_arena.is_null()) {
+    arenas.emplace(main_arena);
+  }
+  for (auto arena_addr : arenas) {
+    const auto& arena = r.get(arena_addr);
+    for (size_t z = 0; z < GlibcMallocState::NUM_FASTBINS; z++) {
+      try {
+        for (auto chunk_addr = arena.fastbinsY[z]; !chunk_addr.is_null() && mark_cached(chunk_addr);) {
+          chunk_addr = read_free_list_ptr(r, chunk_addr.offset_bytes(GlibcMallocChunk::HEADER_SIZE)).cast<GlibcMallocChunk>();
+        }
+      } catch (const std::out_of_range&) {
+      }
+    }
+  }
+
+  for (const auto& heap : heaps) {
+    if (heap.kind == Kind::MMAPPED) {
+      continue;
+    }
+    for (const auto& chunk : heap.chunks) {
+      if ((chunk.state != ChunkState::IN_USE) ||
+          (chunk.size != sizeof(GlibcTcachePerthread) + GlibcMallocChunk::HEADER_SIZE)) {
+        continue;
+      }
+      try {
+        const auto& tcache = r.get(chunk.user_addr().cast<GlibcTcachePerthread>());
+        if (tcache.invalid_reason(r)) {
+          continue;
+        }
+        for (size_t z = 0; z < GlibcTcachePerthread::NUM_BINS; z++) {
+          auto entry_addr = tcache.entries[z];
+          for (size_t y = 0; (y < tcache.counts[z]) && !entry_addr.is_null(); y++) {
+            if (!mark_cached(entry_addr.offset_bytes(-static_cast<ssize_t>(GlibcMallocChunk::HEADER_SIZE)).cast<GlibcMallocChunk>())) {
+              break;
+            }
+            entry_addr = read_free_list_ptr(r, entry_addr);
+          }
+        }
+      } catch (const std::out_of_range&) {
+      }
+    }
+  }
+
+  return heaps;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "PyObject.hh"
+
+// See malloc.c and arena.c in https://sourceware.org/git/?p=glibc.git;a=tree;f=malloc. These layouts are for 64-bit
+// glibc 2.30 and later (heap_info changed in 2.35; see GlibcHeapInfo); none of these structures are PyObjects. Memory
+// that Python allocates with PyMem_RawMalloc, or with PyObject_Malloc for requests larger than 512 bytes, comes from
+// here, as does memory allocated by most extension modules.
+
+struct GlibcMallocChunk {
+  static constexpr uint64_t PREV_INUSE = 1;
+  static constexpr uint64_t IS_MMAPPED = 2;
+  static constexpr uint64_t NON_MAIN_ARENA = 4;
+  static constexpr uint64_t SIZE_BITS = 7;
+  static constexpr size_t ALIGNMENT = 0x10;
+  static constexpr size_t HEADER_SIZE = 0x10; // User data begins here (after prev_size and size)
+  static constexpr size_t FENCEPOST_SIZE = 0x10; // Written at the end of each heap that's no longer the arena's top
+  static constexpr size_t MIN_SIZE = 0x20;
+
+  uint64_t mchunk_prev_size; // Only valid if the previous chunk is free
+  uint64_t mchunk_size; // Includes the header; low 3 bits are flags
+  MappedPtr<GlibcMallocChunk> fd; // Only valid if this chunk is free
+  MappedPtr<GlibcMallocChunk> bk; // Only valid if this chunk is free
+
+  inline size_t size() const {
+    return this->mchunk_size & ~SIZE_BITS;
+  }
+  inline bool prev_in_use() const {
+    return this->mchunk_size & PREV_INUSE;
+  }
+  inline bool is_mmapped() const {
+    return this->mchunk_size & IS_MMAPPED;
+  }
+};
+
+struct GlibcMallocState {
+  static constexpr size_t NUM_FASTBINS = 10;
+  static constexpr size_t NUM_BINS = 128;
+
+  int32_t mutex;
+  int32_t flags;
+  int32_t have_fastchunks;
+  MappedPtr<GlibcMallocChunk> fastbinsY[NUM_FASTBINS];
+  MappedPtr<GlibcMallocChunk> top;
+  MappedPtr<GlibcMallocChunk> last_remainder;
+  MappedPtr<GlibcMallocChunk> bins[NUM_BINS * 2 - 2];
+  uint32_t binmap[4];
+  MappedPtr<GlibcMallocState> next; // All arenas (including the main arena) form a circular list via this field
+  MappedPtr<GlibcMallocState> next_free;
+  uint64_t attached_threads;
+  uint64_t system_mem;
+  uint64_t max_system_mem;
+
+  const char* invalid_reason(const MemoryReader& r) const;
+};
+static_assert(sizeof(GlibcMallocState) == 0x898);
+
+// Non-main arenas allocate memory in heaps, which are aligned to HEAP_MAX_SIZE and begin with this structure. The first
+// heap in each arena is immediately followed by the arena's GlibcMallocState. glibc 2.35 added a pagesize field after
+// mprotect_size, which (with padding) makes the header 0x30 bytes instead of 0x20; only the fields common to both
+// layouts are declared here, so use header_size() to find where the heap's contents begin.
+struct GlibcHeapInfo {
+  static constexpr size_t HEAP_MAX_SIZE = 0x4000000;
+  static constexpr size_t HEADER_SIZE_PRE_2_35 = 0x20;
+  static constexpr size_t HEADER_SIZE_2_35 = 0x30;
+
+  MappedPtr<GlibcMallocState> ar_ptr;
+  MappedPtr<GlibcHeapInfo> prev;
+  uint64_t size; // Current size in bytes, including this header
+  uint64_t mprotect_size; // Size that has been made readable and writable
+
+  const char* invalid_reason(const MemoryReader& r) const;
+  // Returns the size of the header for the glibc version that created this heap, or 0 if it can't be determined
+  size_t header_size(const MemoryReader& r, MappedPtr<GlibcHeapInfo> addr) const;
+};
+static_assert(sizeof(GlibcHeapInfo) == GlibcHeapInfo::HEADER_SIZE_PRE_2_35);
+
+// Each thread's tcache is allocated as the first chunk the thread allocates from its arena
+struct GlibcTcachePerthread {
+  static constexpr size_t NUM_BINS = 64;
+
+  uint16_t counts[NUM_BINS];
+  MappedPtr<void> entries[NUM_BINS]; // Point to user data, not to chunk headers
+
+  const char* invalid_reason(const MemoryReader& r) const;
+};
+
+struct GlibcMallocHeap {
+  enum class Kind {
+    MAIN = 0, // The brk heap, used by the main arena
+    NON_MAIN, // A heap belonging to another arena
+    MMAPPED, // A run of chunks allocated directly with mmap (e.g. allocations larger than M_MMAP_THRESHOLD)
+  };
+  enum class ChunkState {
+    IN_USE = 0,
+    FREE, // In one of the arena's regular bins
+    CACHED, // Free, but in a tcache or fastbin (so it still looks in-use to its neighbors)
+    TOP, // The unallocated remainder at the end of the arena's current heap
+    OVERHEAD, // Fenceposts and other structures that are never returned by malloc
+  };
+  struct Chunk {
+    MappedPtr<GlibcMallocChunk> addr;
+    size_t size;
+    ChunkState state;
+
+    inline MappedPtr<void> user_addr() const {
+      return this->addr.offset_bytes(GlibcMallocChunk::HEADER_SIZE);
+    }
+  };
+
+  Kind kind;
+  MappedPtr<void> start;
+  size_t size;
+  MappedPtr<GlibcMallocState> arena; // May be null if the arena couldn't be found
+  std::vector<Chunk> chunks; // In address order
+  bool walk_complete; // False if a corrupt chunk header was found before the end of the heap
+};
+
+// Finds all malloc heaps (including runs of mmapped chunks) in the snapshot and walks their chunks. Chunks in tcaches
+// and fastbins are marked as CACHED when their tcache or arena can be found.
+std::vector<GlibcMallocHeap> find_glibc_malloc_heaps(const MemoryReader& r);
@@ -0,0 +1,263 @@
+#include "PyBufferObjects.hh"
+
+#include "PyStringObjects.hh"
+
+const char* PyByteArrayObject::invalid_reason(const Environment& env) const {
+  if ((this->ob_size < 0) || (this->ob_alloc < 0) || (this->ob_exports < 0)) {
+    return "invalid_size";
+  }
+  if (this->ob_bytes.is_null()) {
+    if (this->ob_alloc || this->ob_size || !this->ob_start.is_null()) {
+      return "invalid_ob_bytes";
+    }
+    return nullptr;
+  }
+  // There's always room for a trailing null byte after the data
+  if ((this->ob_start < this->ob_bytes) ||
+      (this->ob_start.offset_bytes(this->ob_size + 1) > this->ob_bytes.offset_bytes(this->ob_alloc))) {
+    return "invalid_ob_start";
+  }
+  if (!env.r.exists_range(this->ob_bytes, this->ob_alloc)) {
+    return "ob_bytes_out_of_range";
+  }
+  return nullptr;
+}
+
+std::string PyByteArrayObject::repr(Traversal& t) const {
+  if (const char* ir = t.check_valid(*this)) {
+    return std::format("<bytearray !{}>", ir);
+  }
+  if (this->ob_size == 0) {
+    return "bytearray(b\'\')";
+  }
+  try {
+    return std::format("bytearray({})", escape_string(t.env.r.read(this->ob_start, this->ob_size), false, t.max_string_length));
+  } catch (const std::out_of_range&) {
+    return std::format("<bytearray !unreadable_data>");
+  }
+}
+
+const char* PyArrayArrayObject::invalid_reason(const Environment& env) const {
+  if ((this->ob_size < 0) || (this->ob_size > this->allocated) || (this->ob_exports < 0)) {
+    return "invalid_size";
+  }
+  if (!env.r.obj_valid(this->ob_descr)) {
+    return "invalid_ob_descr";
+  }
+  const auto& descr = env.r.get(this->ob_descr);
+  if ((descr.itemsize != 1) && (descr.itemsize != 2) && (descr.itemsize != 4) && (descr.itemsize != 8)) {
+    return "invalid_itemsize";
+  }
+  if (this->ob_item.is_null() != (this->allocated == 0)) {
+    return "invalid_ob_item";
+  }
+  if (!this->ob_item.is_null() && !env.r.exists_range(this->ob_item, this->allocated * descr.itemsize)) {
+    return "ob_item_out_of_range";
+  }
+  if (!env.r.obj_valid_or_null(this->weakreflist, 1)) {
+    return "invalid_weakreflist";
+  }
+  return nullptr;
+}
+
+std::vector<std::string> PyArrayArrayObject::repr_tokens(Traversal& t) const {
+  const auto& descr = t.env.r.get(this->ob_descr);
+  return {
+      std::format("typecode=\'{}\'", descr.typecode),
+      std::format("size={}", this->ob_size),
+      std::format("allocated={}", this->allocated),
+      std::format("data_bytes={}", phosg::format_size(this->allocated_bytes(t.env.r)))};
+}
+
+std::string PyArrayArrayObject::repr(Traversal& t) const {
+  return t.token_repr<PyArrayArrayObject>(*this, "array.array");
+}
+
+static std::vector<std::string> buffer_repr_tokens(Traversal& t, const PyBuffer& buf) {
+  std::vector<std::string> tokens;
+  if (!buf.format.is_null()) {
+    try {
+      tokens.emplace_back(std::format("format=\'{}\'", t.env.r.get_cstr(buf.format)));
+    } catch (const std::out_of_range&) {
+      tokens.emplace_back("format=<!invalid_addr>");
+    }
+  }
+  tokens.emplace_back(std::format("itemsize={}", buf.itemsize));
+  tokens.emplace_back(std::format("len={}", buf.len));
+  if (buf.readonly) {
+    tokens.emplace_back("readonly");
+  }
+  if (!buf.obj.is_null()) {
+    tokens.emplace_back(std::format("obj={}", t.repr(buf.obj)));
+  }
+  return tokens;
+}
+
+const char* PyManagedBufferObject::invalid_reason(const Environment& env) const {
+  if (this->exports < 0) {
+    return "invalid_exports";
+  }
+  if ((this->master.len < 0) || (this->master.ndim < 0) || (this->master.ndim > PyMemoryViewObject::MAX_NDIM)) {
+    return "invalid_master";
+  }
+  if (!this->master.obj.is_null() && !env.r.obj_valid(this->master.obj)) {
+    return "invalid_master_obj";
+  }
+  return nullptr;
+}
+
+std::vector<std::string> PyManagedBufferObject::repr_tokens(Traversal& t) const {
+  auto tokens = buffer_repr_tokens(t, this->master);
+  tokens.emplace(tokens.begin(), std::format("exports={}", this->exports));
+  return tokens;
+}
+
+std::string PyManagedBufferObject::repr(Traversal& t) const {
+  return t.token_repr<PyManagedBufferObject>(*this, "managedbuffer");
+}
+
+const char* PyMemoryViewObject::invalid_reason(const Environment& env) const {
+  if ((this->view.ndim < 0) || (this->view.ndim > MAX_NDIM) || (this->ob_size != 3 * this->view.ndim)) {
+    return "invalid_ndim";
+  }
+  if ((this->view.len < 0) || (this->view.itemsize < 0) || (this->exports < 0)) {
+    return "invalid_size";
+  }
+  // Released views have no managed buffer or exporter
+  if (this->flags & FLAG_RELEASED) {
+    return nullptr;
+  }
+  if (env.invalid_reason(this->mbuf.cast<PyObject>(), env.get_type_if_exists("managedbuffer"))) {
+    return "invalid_mbuf";
+  }
+  if (!this->view.obj.is_null() && !env.r.obj_valid(this->view.obj)) {
+    return "invalid_view_obj";
+  }
+  if (!env.r.obj_valid_or_null(this->weakreflist, 1)) {
+    return "invalid_weakreflist";
+  }
+  return nullptr;
+}
+
+std::vector<std::string> PyMemoryViewObject::repr_tokens(Traversal& t) const {
+  if (this->flags & FLAG_RELEASED) {
+    return {"released"};
+  }
+  auto tokens = buffer_repr_tokens(t, this->view);
+  if (this->view.ndim != 1) {
+    tokens.emplace(tokens.begin(), std::format("ndim={}", this->view.ndim));
+  }
+  return tokens;
+}
+
+std::string PyMemoryViewObject::repr(Traversal& t) const {
+  return t.token_repr<PyMemoryViewObject>(*this, "memoryview");
+}
+
+int64_t NumpyArrayDescrObject::element_size() const {
+  auto is_valid_alignment = [](int64_t alignment) -> bool {
+    return (alignment > 0) && (alignment <= 0x40) && !(alignment & (alignment - 1));
+  };
+  if (is_valid_alignment(this->layout.v1.alignment) && (this->layout.v1.elsize >= 0)) {
+    return this->layout.v1.elsize;
+  }
+  if (is_valid_alignment(this->layout.v2.alignment) && (this->layout.v2.elsize >= 0)) {
+    return this->layout.v2.elsize;
+  }
+  return -1;
+}
+
+const char* NumpyArrayObject::invalid_reason(const Environment& env) const {
+  if ((this->nd < 0) || (this->nd > MAX_NDIM)) {
+    return "invalid_nd";
+  }
+  if (this->nd && (!env.r.obj_valid(this->dimensions) || !env.r.exists_array(this->dimensions, this->nd))) {
+    return "invalid_dimensions";
+  }
+  if (this->nd && (!env.r.obj_valid(this->strides) || !env.r.exists_array(this->strides, this->nd))) {
+    return "invalid_strides";
+  }
+  if (!env.r.obj_valid(this->descr)) {
+    return "invalid_descr";
+  }
+  if (!this->base.is_null() && !env.r.obj_valid(this->base)) {
+    return "invalid_base";
+  }
+  // Arrays that own their data always have a buffer, even if they have no elements
+  if (this->owns_data() && this->data.is_null()) {
+    return "invalid_data";
+  }
+  if (!env.r.obj_valid_or_null(this->weakreflist, 1)) {
+    return "invalid_weakreflist";
+  }
+  for (int64_t dim : this->get_shape(env.r)) {
+    if (dim < 0) {
+      return "invalid_shape";
+    }
+  }
+  return nullptr;
+}
+
+std::vector<int64_t> NumpyArrayObject::get_shape(const MemoryReader& r) const {
+  if (this->nd == 0) {
+    return {};
+  }
+  const auto* dims = r.get_array(this->dimensions, this->nd);
+  return std::vector<int64_t>(dims, dims + this->nd);
+}
+
+int64_t NumpyArrayObject::element_size(const MemoryReader& r) const {
+  int64_t elsize = r.get(this->descr).element_size();
+  // If the innermost dimension has only one element, numpy may set its stride to anything, so it can't be checked
+  if ((elsize >= 0) && (this->flags & FLAG_C_CONTIGUOUS) && (this->nd > 0) &&
+      (r.get_array(this->dimensions, this->nd)[this->nd - 1] > 1) &&
+      (r.get_array(this->strides, this->nd)[this->nd - 1] != elsize)) {
+    return -1;
+  }
+  return elsize;
+}
+
+size_t NumpyArrayObject::data_bytes(const MemoryReader& r) const {
+  int64_t elsize = this->element_size(r);
+  if (elsize < 0) {
+    return 0;
+  }
+  size_t ret = elsize;
+  for (int64_t dim : this->get_shape(r)) {
+    ret *= dim;
+  }
+  return ret;
+}
+
+std::vector<std::string> NumpyArrayObject::repr_tokens(Traversal& t) const {
+  std::vector<std::string> tokens;
+  std::string shape_str;
+  for (int64_t dim : this->get_shape(t.env.r)) {
+    shape_str += std::format("{}{}", shape_str.empty() ? "" : ", ", dim);
+  }
+  tokens.emplace_back(std::format("shape=({}{})", shape_str, (this->nd == 1) ? "," : ""));
+  const auto& descr = t.env.r.get(this->descr);
+  int64_t elsize = this->element_size(t.env.r);
+  if (elsize >= 0) {
+    tokens.emplace_back(std::format("dtype=\'{}{}{}\'", descr.byteorder, descr.kind, elsize));
+    tokens.emplace_back(std::format("nbytes={}", phosg::format_size(this->data_bytes(t.env.r))));
+  } else {
+    tokens.emplace_back(std::format("dtype=\'{}{}?\'", descr.byteorder, descr.kind));
+  }
+  if (!(this->flags & (FLAG_C_CONTIGUOUS | FLAG_F_CONTIGUOUS))) {
+    tokens.emplace_back("noncontiguous");
+  }
+  if (!(this->flags & FLAG_WRITEABLE)) {
+    tokens.emplace_back("readonly");
+  }
+  if (this->owns_data()) {
+    tokens.emplace_back("owndata");
+  } else if (!this->base.is_null()) {
+    tokens.emplace_back(std::format("base={}", t.repr(this->base)));
+  }
+  return tokens;
+}
+
+std::string NumpyArrayObject::repr(Traversal& t) const {
+  return t.token_repr<NumpyArrayObject>(*this, "numpy.ndarray");
+}
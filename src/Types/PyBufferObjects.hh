@@ -0,0 +1,177 @@
+#pragma once
+
+#include "PyObject.hh"
+
+// Objects in this file store their data in separate buffers, which are often much larger than the objects themselves.
+// Environment::shallow_size counts a buffer only for the object that owns it (and would free it), so views of another
+// object's data (memoryviews, and numpy arrays that don't have OWNDATA) don't count it again.
+
+// See https://github.com/python/cpython/blob/3.10/Include/cpython/bytearrayobject.h
+struct PyByteArrayObject : PyVarObject { // ob_size is the length of the data
+  int64_t ob_alloc; // Size of the ob_bytes allocation (0 if ob_bytes is null)
+  MappedPtr<uint8_t> ob_bytes;
+  MappedPtr<uint8_t> ob_start; // Data begins here; may be after ob_bytes if items were deleted from the front
+  int64_t ob_exports; // Number of buffer views of this object
+
+  const char* invalid_reason(const Environment& env) const;
+  // direct_referents inherited from PyVarObject
+  std::string repr(Traversal& t) const;
+};
+static_assert(sizeof(PyByteArrayObject) == 0x38);
+
+// See arraydescr in https://github.com/python/cpython/blob/3.10/Modules/arraymodule.c. Not a PyObject; these are all
+// in a static table in the array module.
+struct PyArrayDescr {
+  char typecode;
+  int32_t itemsize;
+  MappedPtr<void> getitem;
+  MappedPtr<void> setitem;
+  MappedPtr<void> compareitems;
+  MappedPtr<char> formats;
+  int32_t is_integer_type;
+  int32_t is_signed;
+};
+
+// See arrayobject in https://github.com/python/cpython/blob/3.10/Modules/arraymodule.c. This is the type of
+// array.array objects.
+struct PyArrayArrayObject : PyVarObject { // ob_size is the number of items
+  MappedPtr<uint8_t> ob_item; // Null if allocated is 0
+  int64_t allocated; // In items, not bytes
+  MappedPtr<PyArrayDescr> ob_descr;
+  MappedPtr<PyObject> weakreflist;
+  int64_t ob_exports;
+
+  const char* invalid_reason(const Environment& env) const;
+  // direct_referents inherited from PyVarObject
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+
+  inline size_t allocated_bytes(const MemoryReader& r) const {
+    return this->allocated * r.get(this->ob_descr).itemsize;
+  }
+};
+static_assert(sizeof(PyArrayArrayObject) == 0x40);
+
+// See https://github.com/python/cpython/blob/3.10/Include/cpython/object.h. Not a PyObject; this is embedded in
+// memoryview and managedbuffer objects.
+struct PyBuffer {
+  MappedPtr<void> buf;
+  MappedPtr<PyObject> obj; // Object that exported the buffer (and owns its memory); may be null
+  int64_t len; // In bytes
+  int64_t itemsize;
+  int32_t readonly;
+  int32_t ndim;
+  MappedPtr<char> format;
+  MappedPtr<int64_t> shape;
+  MappedPtr<int64_t> strides;
+  MappedPtr<int64_t> suboffsets;
+  MappedPtr<void> internal;
+};
+static_assert(sizeof(PyBuffer) == 0x50);
+
+// See https://github.com/python/cpython/blob/3.10/Include/memoryobject.h. Each exported buffer is held by one
+// managedbuffer, which may be shared by many memoryviews (e.g. slices of the same view).
+struct PyManagedBufferObject : PyObject {
+  int32_t flags;
+  int64_t exports; // Number of memoryviews using this buffer
+  PyBuffer master;
+
+  const char* invalid_reason(const Environment& env) const;
+  inline std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const {
+    return {this->master.obj};
+  }
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
+
+struct PyMemoryViewObject : PyVarObject { // ob_size is 3 * view.ndim (the size of ob_array)
+  static constexpr int32_t MAX_NDIM = 64; // PyBUF_MAX_NDIM
+  static constexpr int32_t FLAG_RELEASED = 0x001;
+
+  MappedPtr<PyManagedBufferObject> mbuf;
+  int64_t hash;
+  int32_t flags;
+  int64_t exports;
+  PyBuffer view; // A view of mbuf->master; its buf may point into the middle of the exporter's data
+  MappedPtr<PyObject> weakreflist;
+  int64_t ob_array[0]; // Shape, strides, and suboffsets for view
+
+  const char* invalid_reason(const Environment& env) const;
+  inline std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const {
+    return {this->mbuf, this->view.obj};
+  }
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
+static_assert(sizeof(PyMemoryViewObject) == 0x90);
+
+// See PyArray_Descr in https://github.com/numpy/numpy/blob/v1.26.0/numpy/core/include/numpy/ndarraytypes.h and
+// https://github.com/numpy/numpy/blob/v2.0.0/numpy/_core/include/numpy/ndarraytypes.h. The layouts are the same up to
+// type_num; after that, numpy 1.x has int elsize and alignment fields, but numpy 2.x has a uint64 flags field followed
+// by npy_intp elsize and alignment fields. Only the fields up to alignment are used here.
+struct NumpyArrayDescrObject : PyObject {
+  MappedPtr<PyTypeObject> typeobj;
+  char kind;
+  char type;
+  char byteorder;
+  char flags; // Only used in numpy 1.x
+  int32_t type_num;
+  union {
+    struct {
+      int32_t elsize; // Size of each element in bytes
+      int32_t alignment;
+    } v1;
+    struct {
+      uint64_t flags;
+      int64_t elsize;
+      int64_t alignment;
+    } v2;
+  } layout;
+
+  // Returns the size of each element in bytes, or -1 if the descr matches neither layout. The alignment is always a
+  // nonzero power of two; in numpy 2.x, v1.alignment overlaps the high half of v2.flags, which is always zero.
+  int64_t element_size() const;
+};
+
+// See PyArrayObject_fields in https://github.com/numpy/numpy/blob/v1.26.0/numpy/core/include/numpy/ndarraytypes.h
+struct NumpyArrayObject : PyObject {
+  static constexpr int32_t MAX_NDIM = 64;
+  static constexpr int32_t FLAG_C_CONTIGUOUS = 0x0001;
+  static constexpr int32_t FLAG_F_CONTIGUOUS = 0x0002;
+  static constexpr int32_t FLAG_OWNDATA = 0x0004;
+  static constexpr int32_t FLAG_WRITEABLE = 0x0400;
+
+  MappedPtr<uint8_t> data;
+  int32_t nd;
+  MappedPtr<int64_t> dimensions; // Allocated together with strides (2 * nd entries); null if nd is 0
+  MappedPtr<int64_t> strides;
+  MappedPtr<PyObject> base; // Object that owns the data if this array doesn't (another array, or any buffer exporter)
+  MappedPtr<NumpyArrayDescrObject> descr;
+  int32_t flags;
+  MappedPtr<PyObject> weakreflist;
+  // There are more fields here in numpy 1.20 and later (_buffer_info, and mem_handler in 1.22 and later), but they
+  // aren't needed since ndarray's tp_basicsize gives the object's size
+
+  inline bool owns_data() const {
+    return this->flags & FLAG_OWNDATA;
+  }
+
+  const char* invalid_reason(const Environment& env) const;
+  inline std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const {
+    return {this->base, this->descr};
+  }
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+
+  std::vector<int64_t> get_shape(const MemoryReader& r) const;
+  // Returns the descr's element size, or -1 if it can't be determined. For C-contiguous arrays, this also checks that
+  // the element size matches the innermost stride, so a misdetected descr layout doesn't produce garbage sizes.
+  int64_t element_size(const MemoryReader& r) const;
+  // Number of bytes covered by the array's elements (the product of the shape and the element size), or 0 if the
+  // element size can't be determined. The data buffer is at least this large if the array owns it.
+  size_t data_bytes(const MemoryReader& r) const;
+};
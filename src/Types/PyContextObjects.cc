@@ -0,0 +1,267 @@
+#include "PyContextObjects.hh"
+
+#include <bit>
+
+const char* PyHamtNodeBitmapObject::invalid_reason(const Environment& env) const {
+  // Every bit set in the bitmap has a (key, value) pair in the array
+  if (static_cast<size_t>(this->ob_size) != static_cast<size_t>(std::popcount(this->b_bitmap)) * 2) {
+    return "invalid_size";
+  }
+  if (!env.r.exists_array(env.r.host_to_mapped(&this->b_array[0]), this->ob_size)) {
+    return "array_out_of_range";
+  }
+  for (ssize_t z = 0; z < this->ob_size; z += 2) {
+    if (!this->b_array[z].is_null() && !env.r.obj_valid(this->b_array[z])) {
+      return "invalid_key";
+    }
+    if (!env.r.obj_valid(this->b_array[z + 1])) {
+      return "invalid_value";
+    }
+  }
+  return nullptr;
+}
+
+std::unordered_set<MappedPtr<void>> PyHamtNodeBitmapObject::direct_referents(const Environment&) const {
+  std::unordered_set<MappedPtr<void>> ret;
+  for (ssize_t z = 0; z < this->ob_size; z++) {
+    ret.emplace(this->b_array[z]);
+  }
+  return ret;
+}
+
+std::vector<std::string> PyHamtNodeBitmapObject::repr_tokens(Traversal& t) const {
+  return {std::format("bitmap={:08X}", this->b_bitmap), std::format("entries={}", this->ob_size / 2)};
+}
+
+std::string PyHamtNodeBitmapObject::repr(Traversal& t) const {
+  return t.token_repr<PyHamtNodeBitmapObject>(*this, "hamt_bitmap_node");
+}
+
+const char* PyHamtNodeArrayObject::invalid_reason(const Environment& env) const {
+  int64_t count = 0;
+  for (size_t z = 0; z < NUM_CHILDREN; z++) {
+    if (!this->a_array[z].is_null()) {
+      if (!env.r.obj_valid(this->a_array[z])) {
+        return "invalid_child";
+      }
+      count++;
+    }
+  }
+  if (count != this->a_count) {
+    return "invalid_count";
+  }
+  return nullptr;
+}
+
+std::unordered_set<MappedPtr<void>> PyHamtNodeArrayObject::direct_referents(const Environment&) const {
+  std::unordered_set<MappedPtr<void>> ret;
+  for (size_t z = 0; z < NUM_CHILDREN; z++) {
+    if (!this->a_array[z].is_null()) {
+      ret.emplace(this->a_array[z]);
+    }
+  }
+  return ret;
+}
+
+std::vector<std::string> PyHamtNodeArrayObject::repr_tokens(Traversal& t) const {
+  return {std::format("children={}", this->a_count)};
+}
+
+std::string PyHamtNodeArrayObject::repr(Traversal& t) const {
+  return t.token_repr<PyHamtNodeArrayObject>(*this, "hamt_array_node");
+}
+
+const char* PyHamtNodeCollisionObject::invalid_reason(const Environment& env) const {
+  // Collision nodes always have at least two keys
+  if ((this->ob_size < 4) || (this->ob_size & 1)) {
+    return "invalid_size";
+  }
+  if (!env.r.exists_array(env.r.host_to_mapped(&this->c_array[0]), this->ob_size)) {
+    return "array_out_of_range";
+  }
+  for (ssize_t z = 0; z < this->ob_size; z++) {
+    if (!env.r.obj_valid(this->c_array[z])) {
+      return (z & 1) ? "invalid_value" : "invalid_key";
+    }
+  }
+  return nullptr;
+}
+
+std::unordered_set<MappedPtr<void>> PyHamtNodeCollisionObject::direct_referents(const Environment&) const {
+  std::unordered_set<MappedPtr<void>> ret;
+  for (ssize_t z = 0; z < this->ob_size; z++) {
+    ret.emplace(this->c_array[z]);
+  }
+  return ret;
+}
+
+std::vector<std::string> PyHamtNodeCollisionObject::repr_tokens(Traversal& t) const {
+  return {std::format("hash={:08X}", static_cast<uint32_t>(this->c_hash)), std::format("entries={}", this->ob_size / 2)};
+}
+
+std::string PyHamtNodeCollisionObject::repr(Traversal& t) const {
+  return t.token_repr<PyHamtNodeCollisionObject>(*this, "hamt_collision_node");
+}
+
+const char* PyHamtObject::invalid_reason(const Environment& env) const {
+  if (!env.r.obj_valid(this->h_root)) {
+    return "invalid_root";
+  }
+  if (!env.r.obj_valid_or_null(this->h_weakreflist, 1)) {
+    return "invalid_weakreflist";
+  }
+  if (this->h_count < 0) {
+    return "invalid_count";
+  }
+  return nullptr;
+}
+
+// Hashes are 32 bits and each level of the trie consumes 5 of them, so there are at most 7 levels of bitmap and
+// array nodes, plus one level of collision nodes below them
+static constexpr size_t HAMT_MAX_TREE_DEPTH = 8;
+
+template <typename FnT>
+static void walk_hamt_node(const Environment& env, MappedPtr<PyObject> addr, size_t depth, FnT&& fn) {
+  if (depth >= HAMT_MAX_TREE_DEPTH) {
+    throw std::out_of_range("HAMT is too deep");
+  }
+  const auto& obj = env.r.get(addr);
+  if (obj.ob_type == env.get_type_if_exists("hamt_bitmap_node")) {
+    const auto& node = env.r.get(addr.cast<PyHamtNodeBitmapObject>());
+    if (const char* ir = node.invalid_reason(env)) {
+      throw invalid_object(ir);
+    }
+    fn(addr, MappedPtr<PyObject>(), MappedPtr<PyObject>());
+    for (ssize_t z = 0; z < node.ob_size; z += 2) {
+      if (node.b_array[z].is_null()) {
+        walk_hamt_node(env, node.b_array[z + 1], depth + 1, fn);
+      } else {
+        fn(MappedPtr<PyObject>(), node.b_array[z], node.b_array[z + 1]);
+      }
+    }
+  } else if (obj.ob_type == env.get_type_if_exists("hamt_array_node")) {
+    const auto& node = env.r.get(addr.cast<PyHamtNodeArrayObject>());
+    if (const char* ir = node.invalid_reason(env)) {
+      throw invalid_object(ir);
+    }
+    fn(addr, MappedPtr<PyObject>(), MappedPtr<PyObject>());
+    for (size_t z = 0; z < PyHamtNodeArrayObject::NUM_CHILDREN; z++) {
+      if (!node.a_array[z].is_null()) {
+        walk_hamt_node(env, node.a_array[z], depth + 1, fn);
+      }
+    }
+  } else if (obj.ob_type == env.get_type_if_exists("hamt_collision_node")) {
+    const auto& node = env.r.get(addr.cast<PyHamtNodeCollisionObject>());
+    if (const char* ir = node.invalid_reason(env)) {
+      throw invalid_object(ir);
+    }
+    fn(addr, MappedPtr<PyObject>(), MappedPtr<PyObject>());
+    for (ssize_t z = 0; z < node.ob_size; z += 2) {
+      fn(MappedPtr<PyObject>(), node.c_array[z], node.c_array[z + 1]);
+    }
+  } else {
+    throw invalid_object("invalid_hamt_node_type");
+  }
+}
+
+std::vector<std::pair<MappedPtr<PyObject>, MappedPtr<PyObject>>> PyHamtObject::get_items(const Environment& env) const {
+  std::vector<std::pair<MappedPtr<PyObject>, MappedPtr<PyObject>>> ret;
+  walk_hamt_node(env, this->h_root, 0, [&](MappedPtr<PyObject>, MappedPtr<PyObject> key, MappedPtr<PyObject> value) -> void {
+    if (!key.is_null()) {
+      ret.emplace_back(key, value);
+    }
+  });
+  return ret;
+}
+
+std::vector<MappedPtr<PyObject>> PyHamtObject::get_nodes(const Environment& env) const {
+  std::vector<MappedPtr<PyObject>> ret;
+  walk_hamt_node(env, this->h_root, 0, [&](MappedPtr<PyObject> node, MappedPtr<PyObject>, MappedPtr<PyObject>) -> void {
+    if (!node.is_null()) {
+      ret.emplace_back(node);
+    }
+  });
+  return ret;
+}
+
+std::vector<std::string> PyHamtObject::repr_tokens(Traversal& t) const {
+  std::vector<std::string> tokens;
+  tokens.emplace_back(std::format("count={}", this->h_count));
+  try {
+    for (const auto& [key, value] : this->get_items(t.env)) {
+      if ((t.max_entries >= 0) && (tokens.size() > static_cast<size_t>(t.max_entries))) {
+        tokens.emplace_back("...");
+        break;
+      }
+      tokens.emplace_back(std::format("{}={}", t.repr(key), t.repr(value)));
+    }
+  } catch (const std::out_of_range&) {
+    tokens.emplace_back("!invalid_nodes");
+  } catch (const invalid_object&) {
+    tokens.emplace_back("!invalid_nodes");
+  }
+  return tokens;
+}
+
+std::string PyHamtObject::repr(Traversal& t) const {
+  return t.token_repr<PyHamtObject>(*this, "hamt");
+}
+
+const char* PyContextObject::invalid_reason(const Environment& env) const {
+  if (!this->ctx_prev.is_null() && !env.r.obj_valid(this->ctx_prev)) {
+    return "invalid_ctx_prev";
+  }
+  if (env.invalid_reason(this->ctx_vars.cast<PyObject>(), env.get_type_if_exists("hamt"))) {
+    return "invalid_ctx_vars";
+  }
+  if (!env.r.obj_valid_or_null(this->ctx_weakreflist, 1)) {
+    return "invalid_ctx_weakreflist";
+  }
+  if (this->ctx_entered & ~1) {
+    return "invalid_ctx_entered";
+  }
+  // Only entered contexts have a previous context (though it may be null if no context was current before)
+  if (!this->ctx_entered && !this->ctx_prev.is_null()) {
+    return "invalid_ctx_prev";
+  }
+  return nullptr;
+}
+
+std::vector<std::string> PyContextObject::repr_tokens(Traversal& t) const {
+  std::vector<std::string> tokens;
+  if (this->ctx_entered) {
+    tokens.emplace_back("entered");
+  }
+  tokens.emplace_back(std::format("vars={}", t.repr(this->ctx_vars.cast<PyObject>())));
+  return tokens;
+}
+
+std::string PyContextObject::repr(Traversal& t) const {
+  return t.token_repr<PyContextObject>(*this, "Context");
+}
+
+const char* PyContextVarObject::invalid_reason(const Environment& env) const {
+  if (env.invalid_reason(this->var_name, env.get_type_if_exists("str"))) {
+    return "invalid_var_name";
+  }
+  if (!this->var_default.is_null() && !env.r.obj_valid(this->var_default)) {
+    return "invalid_var_default";
+  }
+  if (!this->var_cached.is_null() && !env.r.obj_valid(this->var_cached)) {
+    return "invalid_var_cached";
+  }
+  return nullptr;
+}
+
+std::vector<std::string> PyContextVarObject::repr_tokens(Traversal& t) const {
+  std::vector<std::string> tokens;
+  tokens.emplace_back(std::format("name={}", t.repr(this->var_name)));
+  if (!this->var_default.is_null()) {
+    tokens.emplace_back(std::format("default={}", t.repr(this->var_default)));
+  }
+  return tokens;
+}
+
+std::string PyContextVarObject::repr(Traversal& t) const {
+  return t.token_repr<PyContextVarObject>(*this, "ContextVar");
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "PyObject.hh"
+
+// See https://github.com/python/cpython/blob/3.10/Include/internal/pycore_context.h and
+// https://github.com/python/cpython/blob/3.10/Include/internal/pycore_hamt.h. Contexts store their variables in a
+// HAMT (hash array mapped trie), which is immutable; setting a variable creates a new HAMT that shares most of its
+// nodes with the old one, so the same nodes (and values) are often reachable from many contexts.
+
+// Each HAMT node is one of these three types
+struct PyHamtNodeBitmapObject : PyVarObject { // ob_size is the number of entries in b_array (2 per key)
+  uint32_t b_bitmap;
+  MappedPtr<PyObject> b_array[0]; // (key, value) pairs; if key is null, value is a child node
+
+  const char* invalid_reason(const Environment& env) const;
+  std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const;
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
+
+struct PyHamtNodeArrayObject : PyObject {
+  static constexpr size_t NUM_CHILDREN = 32;
+
+  MappedPtr<PyObject> a_array[NUM_CHILDREN]; // Child nodes; null if unused
+  int64_t a_count; // Number of non-null entries in a_array
+
+  const char* invalid_reason(const Environment& env) const;
+  std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const;
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
+static_assert(sizeof(PyHamtNodeArrayObject) == 0x118);
+
+// Used when multiple keys have the same hash
+struct PyHamtNodeCollisionObject : PyVarObject { // ob_size is the number of entries in c_array (2 per key)
+  int32_t c_hash;
+  MappedPtr<PyObject> c_array[0]; // (key, value) pairs
+
+  const char* invalid_reason(const Environment& env) const;
+  std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const;
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
+
+struct PyHamtObject : PyObject {
+  MappedPtr<PyObject> h_root; // Always a bitmap node for an empty HAMT
+  MappedPtr<PyObject> h_weakreflist;
+  int64_t h_count;
+
+  const char* invalid_reason(const Environment& env) const;
+  inline std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const {
+    return {this->h_root};
+  }
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+
+  // Returns all (key, value) pairs, in no particular order. Throws out_of_range or invalid_object if any node is
+  // invalid or the trie is deeper than a valid HAMT can be.
+  std::vector<std::pair<MappedPtr<PyObject>, MappedPtr<PyObject>>> get_items(const Environment& env) const;
+  // Returns the nodes of the trie, including the root
+  std::vector<MappedPtr<PyObject>> get_nodes(const Environment& env) const;
+};
+
+struct PyContextObject : PyObject {
+  MappedPtr<PyContextObject> ctx_prev; // Context that was current before this one was entered; null if not entered
+  MappedPtr<PyHamtObject> ctx_vars; // Maps ContextVar objects to their values
+  MappedPtr<PyObject> ctx_weakreflist;
+  int32_t ctx_entered;
+
+  const char* invalid_reason(const Environment& env) const;
+  inline std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const {
+    return {this->ctx_prev, this->ctx_vars};
+  }
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
+
+struct PyContextVarObject : PyObject {
+  MappedPtr<PyObject> var_name;
+  MappedPtr<PyObject> var_default; // Null if no default was given
+  MappedPtr<PyObject> var_cached; // Value in the context that var_cached_tsid was last using; may be null
+  uint64_t var_cached_tsid;
+  uint64_t var_cached_tsver;
+  int64_t var_hash;
+
+  const char* invalid_reason(const Environment& env) const;
+  inline std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const {
+    return {this->var_name, this->var_default, this->var_cached};
+  }
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
+static_assert(sizeof(PyContextVarObject) == 0x40);
@@ -0,0 +1,117 @@
+#include "PyDequeObject.hh"
+
+const char* PyDequeObject::invalid_reason(const Environment& env) const {
+  if (const char* ir = this->PyVarObject::invalid_reason(env)) {
+    return ir;
+  }
+  if ((this->ob_size < 0) || (this->leftindex < 0) || (this->leftindex >= static_cast<int64_t>(BLOCK_LENGTH)) ||
+      (this->rightindex < 0) || (this->rightindex >= static_cast<int64_t>(BLOCK_LENGTH))) {
+    return "invalid_size_or_index";
+  }
+  if ((this->maxlen < -1) || ((this->maxlen >= 0) && (this->ob_size > this->maxlen))) {
+    return "invalid_maxlen";
+  }
+  if ((this->numfreeblocks < 0) || (this->numfreeblocks > static_cast<int64_t>(MAX_FREE_BLOCKS))) {
+    return "invalid_numfreeblocks";
+  }
+  if (!env.r.obj_valid(this->leftblock) || !env.r.obj_valid(this->rightblock)) {
+    return "invalid_block_ptr";
+  }
+  try {
+    auto blocks = this->get_blocks(env.r);
+    if (blocks.back() != this->rightblock) {
+      return "invalid_block_list";
+    }
+  } catch (const std::out_of_range&) {
+    return "invalid_block_list";
+  }
+  return nullptr;
+}
+
+std::vector<MappedPtr<PyDequeObject::Block>> PyDequeObject::get_blocks(const MemoryReader& r) const {
+  // An empty deque still has one block
+  size_t num_blocks = std::max<size_t>(this->num_blocks(), 1);
+  std::vector<MappedPtr<Block>> ret;
+  ret.reserve(num_blocks);
+  for (auto block_addr = this->leftblock; ret.size() < num_blocks; block_addr = r.get(block_addr).rightlink) {
+    if (!r.obj_valid(block_addr)) {
+      throw std::out_of_range("Deque block list is too short");
+    }
+    ret.emplace_back(block_addr);
+  }
+  return ret;
+}
+
+std::vector<MappedPtr<PyObject>> PyDequeObject::get_items(const MemoryReader& r, size_t max_items) const {
+  size_t num_items = (max_items && (max_items < static_cast<size_t>(this->ob_size))) ? max_items : this->ob_size;
+  std::vector<MappedPtr<PyObject>> ret;
+  ret.reserve(num_items);
+  size_t index = this->leftindex;
+  for (auto block_addr : this->get_blocks(r)) {
+    const auto& block = r.get(block_addr);
+    for (; (index < BLOCK_LENGTH) && (ret.size() < num_items); index++) {
+      ret.emplace_back(block.data[index]);
+    }
+    index = 0;
+  }
+  return ret;
+}
+
+std::unordered_set<MappedPtr<void>> PyDequeObject::direct_referents(const Environment& env) const {
+  std::unordered_set<MappedPtr<void>> ret;
+  ret.reserve(this->ob_size);
+  for (auto item_addr : this->get_items(env.r)) {
+    ret.emplace(item_addr);
+  }
+  return ret;
+}
+
+std::string PyDequeObject::repr(Traversal& t) const {
+  if (const char* ir = t.check_valid(*this)) {
+    return std::format("<deque !{}>", ir);
+  }
+  if (!t.recursion_allowed()) {
+    return std::format("<deque !recursion_depth len={}>", this->ob_size);
+  }
+
+  auto cycle_guard = t.cycle_guard(this);
+  if (cycle_guard.is_recursive) {
+    return "<deque !recursive_repr>";
+  }
+
+  std::vector<std::string> repr_strs;
+  bool has_extra = false;
+  for (auto item_addr : this->get_items(t.env.r)) {
+    if ((t.max_entries >= 0) && (repr_strs.size() >= static_cast<size_t>(t.max_entries))) {
+      has_extra = true;
+      break;
+    }
+    repr_strs.emplace_back(t.repr(item_addr));
+  }
+
+  std::string maxlen_str = (this->maxlen >= 0) ? std::format(", maxlen={}", this->maxlen) : "";
+  auto indent = t.indent();
+  if ((repr_strs.size() == 0) && !has_extra) {
+    return std::format("deque([]{})", maxlen_str);
+
+  } else if ((repr_strs.size() == 1) && !has_extra) {
+    return std::format("deque([{}]{})", repr_strs[0], maxlen_str);
+
+  } else { // 2 or more items
+    std::string ret = "deque([\n";
+    for (const auto& repr_str : repr_strs) {
+      ret.append(t.recursion_depth * 2, ' ');
+      ret += repr_str;
+      ret += ",\n";
+    }
+    if (has_extra) {
+      ret.append(t.recursion_depth * 2, ' ');
+      ret += "...\n";
+    }
+    ret.append((t.recursion_depth - 1) * 2, ' ');
+    ret += "]";
+    ret += maxlen_str;
+    ret += ")";
+    return ret;
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "PyObject.hh"
+
+// See https://github.com/python/cpython/blob/3.10/Modules/_collectionsmodule.c
+struct PyDequeObject : PyVarObject {
+  static constexpr size_t BLOCK_LENGTH = 64;
+  static constexpr size_t MAX_FREE_BLOCKS = 16;
+
+  // Items are stored in a doubly-linked list of fixed-size blocks. Not a PyObject!
+  struct Block {
+    MappedPtr<Block> leftlink;
+    MappedPtr<PyObject> data[BLOCK_LENGTH];
+    MappedPtr<Block> rightlink;
+  };
+
+  MappedPtr<Block> leftblock;
+  MappedPtr<Block> rightblock;
+  int64_t leftindex; // 0 <= leftindex < BLOCK_LENGTH
+  int64_t rightindex; // 0 <= rightindex < BLOCK_LENGTH
+  uint64_t state; // Incremented whenever the deque is mutated
+  int64_t maxlen; // -1 if unbounded
+  int64_t numfreeblocks;
+  MappedPtr<Block> freeblocks[MAX_FREE_BLOCKS];
+  MappedPtr<PyObject> weakreflist;
+
+  // Number of blocks in the list (not counting freeblocks, which are only a cache)
+  inline size_t num_blocks() const {
+    return (this->leftindex + this->ob_size + BLOCK_LENGTH - 1) / BLOCK_LENGTH;
+  }
+
+  const char* invalid_reason(const Environment& env) const;
+  std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const;
+  std::string repr(Traversal& t) const;
+
+  std::vector<MappedPtr<Block>> get_blocks(const MemoryReader& r) const;
+  // Returns the items in order from left to right. If max_items is nonzero, returns at most that many items.
+  std::vector<MappedPtr<PyObject>> get_items(const MemoryReader& r, size_t max_items = 0) const;
+};
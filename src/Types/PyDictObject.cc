@@ -128,6 +128,32 @@ std::vector<std::pair<MappedPtr<PyObject>, MappedPtr<PyObject>>> PyDictObject::g
   return ret;
 }
 
+std::vector<std::pair<MappedPtr<PyObject>, size_t>> PyDictObject::get_probe_lengths(const MemoryReader& r) const {
+  const auto& keys = r.get(this->ma_keys);
+  auto entries_r = this->read_entries(r);
+  auto table = this->get_table(r);
+  uint64_t mask = keys.dk_size - 1;
+
+  std::vector<std::pair<MappedPtr<PyObject>, size_t>> ret;
+  for (int64_t table_v : table) {
+    if (table_v < 0) {
+      continue;
+    }
+    const auto& entry = entries_r.pget<PyDictKeyEntry>(table_v * sizeof(PyDictKeyEntry));
+    // Follow the same probe sequence as lookdict in dictobject.c until we reach this entry's index slot. The probe
+    // sequence visits every slot eventually, but a corrupt table could make this not terminate, so we limit it.
+    uint64_t perturb = entry.me_hash;
+    uint64_t slot = entry.me_hash & mask;
+    size_t probes = 1;
+    for (; (table[slot] != table_v) && (probes <= keys.dk_size); probes++) {
+      perturb >>= 5;
+      slot = (slot * 5 + perturb + 1) & mask;
+    }
+    ret.emplace_back(entry.me_key, probes);
+  }
+  return ret;
+}
+
 std::unordered_set<MappedPtr<void>> PyDictObject::direct_referents(const Environment& env) const {
   std::unordered_set<MappedPtr<void>> ret{this->ma_keys, this->ma_values};
   for (const auto& it : this->get_items(env.r)) {
@@ -21,17 +21,47 @@ struct PyDictKeysObject {
   // IndexType dk_indices[dk_size];
   // PyDictKeyEntry dk_entries[dk_usable + dk_nentries];
 
-  inline int64_t bytes_per_table_value() const {
-    if (this->dk_size < 0x100) {
+  static inline int64_t bytes_per_table_value_for_size(uint64_t dk_size) {
+    if (dk_size < 0x100) {
       return 1;
-    } else if (this->dk_size < 0x10000) {
+    } else if (dk_size < 0x10000) {
       return 2;
-    } else if (this->dk_size < 0x100000000) {
+    } else if (dk_size < 0x100000000) {
       return 4;
     } else {
       return 8;
     }
   }
+  inline int64_t bytes_per_table_value() const {
+    return this->bytes_per_table_value_for_size(this->dk_size);
+  }
+
+  // Number of entry slots allocated (USABLE_FRACTION in dictobject.c)
+  static inline uint64_t usable_fraction_for_size(uint64_t dk_size) {
+    return (dk_size << 1) / 3;
+  }
+  inline uint64_t usable_fraction() const {
+    return this->usable_fraction_for_size(this->dk_size);
+  }
+
+  // Total size of a keys object, including its index table and entries
+  static inline size_t allocated_size_for_size(uint64_t dk_size) {
+    return sizeof(PyDictKeysObject) + bytes_per_table_value_for_size(dk_size) * dk_size +
+        usable_fraction_for_size(dk_size) * sizeof(PyDictKeyEntry);
+  }
+  inline size_t allocated_size() const {
+    return this->allocated_size_for_size(this->dk_size);
+  }
+
+  // Smallest dk_size that a freshly-built dict with this many items would have (see estimate_keysize in dictobject.c)
+  static inline uint64_t min_size_for_items(uint64_t num_items) {
+    uint64_t estimated_size = (num_items * 3 + 1) >> 1;
+    uint64_t dk_size = 8; // PyDict_MINSIZE
+    while (dk_size < estimated_size) {
+      dk_size <<= 1;
+    }
+    return dk_size;
+  }
 
   const char* invalid_reason(const Environment& env) const;
   std::string repr(Traversal& t) const;
@@ -53,6 +83,30 @@ struct PyDictObject : PyObject {
   phosg::StringReader read_values(const MemoryReader& r) const;
   phosg::StringReader read_entries(const MemoryReader& r) const;
   std::vector<std::pair<MappedPtr<PyObject>, MappedPtr<PyObject>>> get_items(const MemoryReader& r) const;
+  // Returns (key, probe count) for each active entry, where the probe count is the number of index table slots that
+  // a lookup for that key examines (1 means no collisions)
+  std::vector<std::pair<MappedPtr<PyObject>, size_t>> get_probe_lengths(const MemoryReader& r) const;
+
+  // Calls fn(entry, value) for each active entry, in insertion order. This is faster than get_items since it doesn't
+  // read the index table or allocate memory.
+  template <typename FnT>
+    requires(std::is_invocable_r_v<void, FnT, const PyDictKeyEntry&, MappedPtr<PyObject>>)
+  void for_each_entry(const MemoryReader& r, FnT&& fn) const {
+    const auto& keys = r.get(this->ma_keys);
+    auto entries_r = this->read_entries(r);
+    auto values_r = this->read_values(r);
+    for (size_t z = 0; z < keys.dk_nentries; z++) {
+      const auto& entry = entries_r.pget<PyDictKeyEntry>(z * sizeof(PyDictKeyEntry));
+      // Deleted entries in combined tables have a null value (and a dummy key); unused entries in split tables have a
+      // null value in ma_values
+      MappedPtr<PyObject> value = this->ma_values.is_null()
+          ? entry.me_value
+          : MappedPtr<PyObject>(values_r.pget_u64l(z * sizeof(uint64_t)));
+      if (!value.is_null()) {
+        fn(entry, value);
+      }
+    }
+  }
 
   template <typename T>
   MappedPtr<T> value_for_key(const MemoryReader& r, const std::string& key) const {
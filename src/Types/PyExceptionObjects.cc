@@ -0,0 +1,106 @@
+#include "PyExceptionObjects.hh"
+
+#include "PyTypeObject.hh"
+
+const char* PyBaseExceptionObject::invalid_reason(const Environment& env) const {
+  if (!this->dict.is_null() && env.invalid_reason(this->dict, env.get_type_if_exists("dict"))) {
+    return "invalid_dict";
+  }
+  if (!this->args.is_null() && !env.r.obj_valid(this->args)) {
+    return "invalid_args";
+  }
+  if (!this->traceback.is_null() && !env.r.obj_valid(this->traceback)) {
+    return "invalid_traceback";
+  }
+  if (!this->context.is_null() && !env.r.obj_valid(this->context)) {
+    return "invalid_context";
+  }
+  if (!this->cause.is_null() && !env.r.obj_valid(this->cause)) {
+    return "invalid_cause";
+  }
+  if (this->suppress_context & ~1) {
+    return "invalid_suppress_context";
+  }
+  return nullptr;
+}
+
+std::unordered_set<MappedPtr<void>> PyBaseExceptionObject::direct_referents(const Environment& env) const {
+  std::unordered_set<MappedPtr<void>> ret{this->dict, this->args, this->traceback, this->context, this->cause};
+  auto this_addr = env.r.host_to_mapped(this);
+  const auto& type_obj = env.r.get(this->ob_type);
+  // Members must be within the object; skip any that aren't, in case the type is corrupt
+  int64_t max_offset = type_obj.tp_basicsize - sizeof(MappedPtr<PyObject>);
+  for (int64_t offset : type_obj.object_member_offsets(env)) {
+    if ((offset < static_cast<int64_t>(sizeof(PyObject))) || (offset > max_offset)) {
+      continue;
+    }
+    auto value = env.r.get(this_addr.offset_bytes(offset).cast<MappedPtr<PyObject>>());
+    if (!value.is_null()) {
+      ret.emplace(value);
+    }
+  }
+  return ret;
+}
+
+std::vector<std::string> PyBaseExceptionObject::repr_tokens(Traversal& t) const {
+  std::vector<std::string> tokens;
+  tokens.emplace_back(std::format("args={}", t.repr(this->args)));
+  if (!this->dict.is_null()) {
+    tokens.emplace_back(std::format("dict={}", t.repr(this->dict)));
+  }
+  if (!this->cause.is_null()) {
+    tokens.emplace_back(std::format("cause={}", t.repr(this->cause)));
+  }
+  if (!this->context.is_null() && !this->suppress_context) {
+    tokens.emplace_back(std::format("context={}", t.repr(this->context)));
+  }
+  if (!this->traceback.is_null()) {
+    tokens.emplace_back(std::format("traceback={}", t.repr(this->traceback)));
+  }
+  return tokens;
+}
+
+std::string PyBaseExceptionObject::repr(Traversal& t) const {
+  std::string type_name = t.env.r.get(this->ob_type).name(t.env.r);
+  return t.token_repr<PyBaseExceptionObject>(*this, type_name.c_str());
+}
+
+const char* PyTracebackObject::invalid_reason(const Environment& env) const {
+  if (!this->tb_next.is_null() && env.invalid_reason(this->tb_next.cast<PyObject>(), env.get_type_if_exists("traceback"))) {
+    return "invalid_tb_next";
+  }
+  if (env.invalid_reason(this->tb_frame.cast<PyObject>(), env.get_type_if_exists("frame"))) {
+    return "invalid_tb_frame";
+  }
+  if ((this->tb_lasti < -1) || (this->tb_lineno < -1)) {
+    return "invalid_position";
+  }
+  return nullptr;
+}
+
+std::vector<std::string> PyTracebackObject::repr_tokens(Traversal& t) const {
+  std::vector<std::string> tokens;
+  tokens.emplace_back(std::format("lineno={}", this->tb_lineno));
+  tokens.emplace_back(std::format("frame={}", t.repr(this->tb_frame.cast<PyObject>())));
+  if (!this->tb_next.is_null()) {
+    tokens.emplace_back(std::format("next={}", t.repr(this->tb_next.cast<PyObject>())));
+  }
+  return tokens;
+}
+
+std::string PyTracebackObject::repr(Traversal& t) const {
+  return t.token_repr<PyTracebackObject>(*this, "traceback");
+}
+
+std::vector<MappedPtr<PyTracebackObject>> PyTracebackObject::get_chain(const Environment& env) const {
+  std::vector<MappedPtr<PyTracebackObject>> ret{env.r.host_to_mapped(this)};
+  // Tracebacks can't be cyclic in practice, but a corrupt snapshot could make them so
+  for (auto tb_addr = this->tb_next; !tb_addr.is_null() && (ret.size() < 0x10000);) {
+    if (!env.r.obj_valid(tb_addr)) {
+      break;
+    }
+    ret.emplace_back(tb_addr);
+    tb_addr = env.r.get(tb_addr).tb_next;
+  }
+  return ret;
+}
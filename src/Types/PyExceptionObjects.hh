@@ -0,0 +1,43 @@
+#pragma once
+
+#include "PyFrameObject.hh"
+#include "PyObject.hh"
+
+// See https://github.com/python/cpython/blob/3.10/Include/cpython/pyerrors.h. All exception types have this layout
+// at the beginning; some (e.g. StopIteration, OSError, SyntaxError) have additional fields after it. Those fields, and
+// the __slots__ of user-defined subclasses, are all exposed as object members of the type, so direct_referents finds
+// them through tp_members.
+struct PyBaseExceptionObject : PyObject {
+  MappedPtr<PyObject> dict; // May be null
+  MappedPtr<PyObject> args;
+  MappedPtr<PyObject> traceback; // __traceback__; may be null
+  MappedPtr<PyObject> context; // __context__; may be null
+  MappedPtr<PyObject> cause; // __cause__; may be null
+  char suppress_context;
+
+  const char* invalid_reason(const Environment& env) const;
+  std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const;
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
+
+// See https://github.com/python/cpython/blob/3.10/Include/cpython/traceback.h. Tracebacks form a linked list from the
+// frame where the exception was caught (the head) to the frame where it was raised (the tail).
+struct PyTracebackObject : PyObject {
+  MappedPtr<PyTracebackObject> tb_next; // May be null
+  MappedPtr<PyFrameObject> tb_frame;
+  int tb_lasti;
+  int tb_lineno;
+
+  const char* invalid_reason(const Environment& env) const;
+  inline std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const {
+    return {this->tb_next, this->tb_frame};
+  }
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+
+  // Returns the tracebacks in the list, starting with this one. Stops early if the list is corrupt.
+  std::vector<MappedPtr<PyTracebackObject>> get_chain(const Environment& env) const;
+};
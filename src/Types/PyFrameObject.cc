@@ -2,6 +2,8 @@
 
 #include <algorithm>
 
+#include "PyStringObjects.hh"
+
 const char* PyFrameObject::invalid_reason(const Environment& env) const {
   if (this->f_state < PyFrameState::FRAME_CREATED || this->f_state > PyFrameState::FRAME_CLEARED) {
     return "invalid_f_state";
@@ -114,6 +116,83 @@ std::string PyFrameObject::where(Traversal& t) const {
   }
 }
 
+std::string PyFrameObject::location(const Environment& env) const {
+  try {
+    const auto& code_obj = env.r.get(this->f_code);
+    if (const char* ir = code_obj.invalid_reason(env)) {
+      throw invalid_object(ir);
+    }
+    std::string name = decode_string_types(env.r, code_obj.co_name, 0x100);
+    std::string filename = decode_string_types(env.r, code_obj.co_filename, 0x400);
+    try {
+      auto line = code_obj.line_number_for_code_offset(env, this->f_lasti * sizeof(Py_CODEUNIT));
+      return std::format("{} ({}:{})", name, filename, line);
+    } catch (const std::exception& e) {
+      return std::format("{} ({}:?)", name, filename);
+    }
+  } catch (const std::out_of_range&) {
+    return "!invalid_code";
+  } catch (const invalid_object& e) {
+    return std::format("!{}", e.reason);
+  }
+}
+
+MappedPtr<PyObject> PyFrameObject::stack_top(const Environment& env) const {
+  if (this->f_stackdepth <= 0) {
+    return MappedPtr<PyObject>();
+  }
+  return env.r.get(this->f_valuestack.offset_bytes((this->f_stackdepth - 1) * sizeof(MappedPtr<PyObject>)));
+}
+
+std::vector<MappedPtr<PyObject>> PyFrameObject::slot_values(const Environment& env) const {
+  auto localsplus_addr = env.r.host_to_mapped(&this->f_localsplus[0]);
+  const auto& code_obj = env.r.get(this->f_code);
+  if ((this->f_valuestack.addr < localsplus_addr.addr) || (code_obj.co_stacksize < 0)) {
+    throw invalid_object("invalid_f_valuestack");
+  }
+  size_t num_slots = (this->f_valuestack.addr - localsplus_addr.addr) / sizeof(MappedPtr<PyObject>) + code_obj.co_stacksize;
+  if (num_slots > 0x10000) {
+    throw invalid_object("invalid_f_valuestack");
+  }
+  const auto* slots = env.r.get_array(localsplus_addr, num_slots);
+  std::vector<MappedPtr<PyObject>> ret;
+  for (size_t z = 0; z < num_slots; z++) {
+    if (!slots[z].is_null()) {
+      ret.emplace_back(slots[z]);
+    }
+  }
+  return ret;
+}
+
+std::vector<MappedPtr<PyObject>> PyFrameObject::stack_slots(const Environment& env) const {
+  const auto& code_obj = env.r.get(this->f_code);
+  if ((code_obj.co_stacksize < 0) || (code_obj.co_stacksize > 0x10000)) {
+    throw invalid_object("invalid_co_stacksize");
+  }
+  const auto* slots = env.r.get_array(this->f_valuestack, code_obj.co_stacksize);
+  return std::vector<MappedPtr<PyObject>>(slots, slots + code_obj.co_stacksize);
+}
+
+int16_t PyFrameObject::opcode_at(const Environment& env, int64_t index) const {
+  const auto& code_obj = env.r.get(this->f_code);
+  const auto& bytecode = env.r.get(code_obj.co_code.cast<PyBytesObject>());
+  if ((index < 0) || (static_cast<int64_t>((index + 1) * sizeof(Py_CODEUNIT)) > bytecode.ob_size)) {
+    return -1;
+  }
+  auto unit_addr = code_obj.co_code.offset_bytes(sizeof(PyBytesObject) + index * sizeof(Py_CODEUNIT)).cast<Py_CODEUNIT>();
+  return env.r.get(unit_addr).op.code;
+}
+
+int16_t PyFrameObject::current_opcode(const Environment& env) const {
+  // The interpreter doesn't update f_lasti when it executes the instruction after an EXTENDED_ARG
+  int64_t index = this->f_lasti;
+  int16_t opcode = this->opcode_at(env, index);
+  while (opcode == PyOpcode::EXTENDED_ARG) {
+    opcode = this->opcode_at(env, ++index);
+  }
+  return opcode;
+}
+
 std::unordered_map<MappedPtr<PyObject>, MappedPtr<PyObject>> PyFrameObject::locals(const Environment& env) const {
   if (const char* ir = env.invalid_reason(this->f_code, env.get_type("code"))) {
     throw invalid_object(ir);
@@ -22,6 +22,18 @@ struct PyTryBlock {
   int b_level;
 };
 
+// See https://github.com/python/cpython/blob/3.10/Include/opcode.h. Only the opcodes we need to recognize are here.
+enum PyOpcode : uint8_t {
+  BEFORE_ASYNC_WITH = 52,
+  YIELD_FROM = 72,
+  CALL_FUNCTION = 131,
+  CALL_FUNCTION_KW = 141,
+  CALL_FUNCTION_EX = 142,
+  SETUP_WITH = 143,
+  EXTENDED_ARG = 144,
+  CALL_METHOD = 161,
+};
+
 union Py_CODEUNIT {
   uint16_t cache;
   struct {
@@ -59,6 +71,29 @@ struct PyFrameObject : PyVarObject {
 
   static std::string name_for_state(PyFrameState st);
   std::string where(Traversal& t) const;
+  // Like where(), but returns "name (filename:line)" with the strings decoded instead of repr'd, for use in reports
+  std::string location(const Environment& env) const;
+  // Returns the object at the top of the value stack, or null if the stack is empty. For a suspended generator or
+  // coroutine frame, this is the object it's awaiting or yielding from (if any).
+  MappedPtr<PyObject> stack_top(const Environment& env) const;
+  // Returns all non-null local variables, cells, free variables, and value stack slots. For frames that are currently
+  // executing, the stack depth isn't recorded, so this includes all co_stacksize stack slots, some of which may be
+  // stale (and point to objects that have since been freed).
+  std::vector<MappedPtr<PyObject>> slot_values(const Environment& env) const;
+  // Returns all co_stacksize value stack slots in order (bottom first), including null ones. As with slot_values,
+  // slots above the current stack depth may be stale if the frame is executing.
+  std::vector<MappedPtr<PyObject>> stack_slots(const Environment& env) const;
+  // Returns the stack level at which the innermost block (try, with, etc.) was set up, or 0 if there are no blocks.
+  // Slots below this level belong to enclosing statements.
+  inline size_t innermost_block_level() const {
+    return (this->f_iblock > 0) ? this->f_blockstack[this->f_iblock - 1].b_level : 0;
+  }
+  // Returns the opcode of the instruction at the given index (in code units, like f_lasti), or -1 if the index is
+  // out of range
+  int16_t opcode_at(const Environment& env, int64_t index) const;
+  // Returns the opcode of the instruction being executed, skipping any EXTENDED_ARG prefixes, or -1 if the frame
+  // hasn't started
+  int16_t current_opcode(const Environment& env) const;
 
   std::unordered_map<MappedPtr<PyObject>, MappedPtr<PyObject>> locals(const Environment& env) const;
 
@@ -0,0 +1,120 @@
+#include "PyFunctionObjects.hh"
+
+#include "PyDictObject.hh"
+#include "PyStringObjects.hh"
+#include "PyTypeObject.hh"
+
+const char* PyLruListElemObject::invalid_reason(const Environment& env) const {
+  if (!env.r.obj_valid(this->prev) || !env.r.obj_valid(this->next)) {
+    return "invalid_link";
+  }
+  if (!env.r.obj_valid(this->key)) {
+    return "invalid_key";
+  }
+  if (!env.r.obj_valid(this->result)) {
+    return "invalid_result";
+  }
+  return nullptr;
+}
+
+std::vector<std::string> PyLruListElemObject::repr_tokens(Traversal& t) const {
+  return {std::format("key={}", t.repr(this->key)), std::format("result={}", t.repr(this->result))};
+}
+
+std::string PyLruListElemObject::repr(Traversal& t) const {
+  return t.token_repr<PyLruListElemObject>(*this, "functools._lru_list_elem");
+}
+
+const char* PyLruCacheObject::invalid_reason(const Environment& env) const {
+  if (!env.r.obj_valid(this->root_prev) || !env.r.obj_valid(this->root_next)) {
+    return "invalid_root_link";
+  }
+  if (!env.r.obj_valid(this->wrapper, 1)) {
+    return "invalid_wrapper";
+  }
+  if (this->typed & ~1) {
+    return "invalid_typed";
+  }
+  if (env.invalid_reason(this->cache, env.get_type_if_exists("dict"))) {
+    return "invalid_cache";
+  }
+  if (!env.r.obj_valid(this->func)) {
+    return "invalid_func";
+  }
+  if ((this->maxsize < -1) || (this->hits < 0) || (this->misses < 0)) {
+    return "invalid_stats";
+  }
+  if (!this->dict.is_null() && !env.r.obj_valid(this->dict)) {
+    return "invalid_dict";
+  }
+  return nullptr;
+}
+
+std::vector<std::string> PyLruCacheObject::repr_tokens(Traversal& t) const {
+  std::vector<std::string> tokens;
+  tokens.emplace_back(std::format("func={}", t.repr(this->func)));
+  tokens.emplace_back((this->maxsize < 0) ? "maxsize=None" : std::format("maxsize={}", this->maxsize));
+  tokens.emplace_back(std::format("currsize={}", t.env.r.get(this->cache.cast<PyDictObject>()).ma_used));
+  tokens.emplace_back(std::format("hits={}", this->hits));
+  tokens.emplace_back(std::format("misses={}", this->misses));
+  if (this->typed) {
+    tokens.emplace_back("typed");
+  }
+  return tokens;
+}
+
+std::string PyLruCacheObject::repr(Traversal& t) const {
+  return t.token_repr<PyLruCacheObject>(*this, "functools._lru_cache_wrapper");
+}
+
+static std::string describe_callable_inner(const Environment& env, MappedPtr<PyObject> addr, size_t depth) {
+  if (addr.is_null()) {
+    return "<NULL>";
+  }
+  // Partials of bound methods of partials etc. are possible, but deeper nesting is almost certainly a corrupt object
+  if (depth > 8) {
+    return "<...>";
+  }
+
+  try {
+    const auto& obj = env.r.get(addr);
+    const auto& type_obj = env.r.get(obj.ob_type);
+    if (obj.ob_type == env.get_type_if_exists("function")) {
+      const auto& fn = env.r.get(addr.cast<PyFunctionObject>());
+      std::string qualname = decode_string_types(env.r, fn.func_qualname, 0x100);
+      if (!fn.func_module.is_null()) {
+        try {
+          return decode_string_types(env.r, fn.func_module, 0x100) + "." + qualname;
+        } catch (const invalid_object&) {
+        }
+      }
+      return qualname;
+
+    } else if (obj.ob_type == env.get_type_if_exists("method")) {
+      return describe_callable_inner(env, env.r.get(addr.cast<PyMethodObject>()).im_func, depth + 1);
+
+    } else if (obj.ob_type == env.get_type_if_exists("builtin_function_or_method")) {
+      const auto& fn = env.r.get(addr.cast<PyCFunctionObject>());
+      std::string name = env.r.get_cstr(env.r.get(fn.m_ml).ml_name);
+      if (!fn.m_self.is_null() && (env.r.get(fn.m_self).ob_type != env.get_type_if_exists("module"))) {
+        return env.r.get(env.r.get(fn.m_self).ob_type).name(env.r) + "." + name;
+      }
+      return name;
+
+    } else if (obj.ob_type == env.get_type_if_exists("functools.partial")) {
+      return std::format("partial({})", describe_callable_inner(env, env.r.get(addr.cast<PyPartialObject>()).fn, depth + 1));
+
+    } else {
+      return std::format("<{}>", type_obj.name(env.r));
+    }
+
+  } catch (const std::out_of_range&) {
+    return "<!invalid_addr>";
+  } catch (const invalid_object& e) {
+    return std::format("<!{}>", e.reason);
+  }
+}
+
+std::string describe_callable(const Environment& env, MappedPtr<PyObject> addr) {
+  return describe_callable_inner(env, addr, 0);
+}
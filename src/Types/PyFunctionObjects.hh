@@ -0,0 +1,123 @@
+#pragma once
+
+#include "PyObject.hh"
+
+// See https://github.com/python/cpython/blob/3.10/Include/funcobject.h
+struct PyFunctionObject : PyObject {
+  MappedPtr<PyObject> func_code;
+  MappedPtr<PyObject> func_globals;
+  MappedPtr<PyObject> func_defaults;
+  MappedPtr<PyObject> func_kwdefaults;
+  MappedPtr<PyObject> func_closure;
+  MappedPtr<PyObject> func_doc;
+  MappedPtr<PyObject> func_name;
+  MappedPtr<PyObject> func_dict;
+  MappedPtr<PyObject> func_weakreflist;
+  MappedPtr<PyObject> func_module;
+  MappedPtr<PyObject> func_annotations;
+  MappedPtr<PyObject> func_qualname;
+  MappedPtr<void> vectorcall;
+};
+
+// See https://github.com/python/cpython/blob/3.10/Include/classobject.h
+struct PyMethodObject : PyObject {
+  MappedPtr<PyObject> im_func;
+  MappedPtr<PyObject> im_self;
+  MappedPtr<PyObject> im_weakreflist;
+  MappedPtr<void> vectorcall;
+};
+
+// See https://github.com/python/cpython/blob/3.10/Include/methodobject.h. Not a PyObject!
+struct PyMethodDef {
+  MappedPtr<char> ml_name;
+  MappedPtr<void> ml_meth;
+  int32_t ml_flags;
+  MappedPtr<char> ml_doc;
+};
+
+// See https://github.com/python/cpython/blob/3.10/Include/cpython/methodobject.h. This is the layout of
+// builtin_function_or_method objects.
+struct PyCFunctionObject : PyObject {
+  MappedPtr<PyMethodDef> m_ml;
+  MappedPtr<PyObject> m_self; // The module for module-level functions; the bound object for methods
+  MappedPtr<PyObject> m_module;
+  MappedPtr<PyObject> m_weakreflist;
+  MappedPtr<void> vectorcall;
+};
+
+// See https://github.com/python/cpython/blob/3.10/Include/descrobject.h. This is the layout of method_descriptor
+// objects, which LOAD_METHOD pushes (followed by the instance) when calling a method of a builtin type.
+struct PyMethodDescrObject : PyObject {
+  MappedPtr<PyTypeObject> d_type;
+  MappedPtr<PyObject> d_name;
+  MappedPtr<PyObject> d_qualname;
+  MappedPtr<PyMethodDef> d_method;
+  MappedPtr<void> vectorcall;
+};
+
+// See partialobject in https://github.com/python/cpython/blob/3.10/Modules/_functoolsmodule.c
+struct PyPartialObject : PyObject {
+  MappedPtr<PyObject> fn;
+  MappedPtr<PyObject> args;
+  MappedPtr<PyObject> kw;
+  MappedPtr<PyObject> dict;
+  MappedPtr<PyObject> weakreflist;
+  MappedPtr<void> vectorcall;
+};
+
+// See lru_list_elem in https://github.com/python/cpython/blob/3.10/Modules/_functoolsmodule.c. Bounded caches store
+// one of these per entry as the dict value; the elements also form a doubly-linked list (in LRU order) whose links
+// don't hold references.
+struct PyLruListElemObject : PyObject {
+  MappedPtr<PyLruListElemObject> prev;
+  MappedPtr<PyLruListElemObject> next;
+  int64_t hash;
+  MappedPtr<PyObject> key;
+  MappedPtr<PyObject> result;
+
+  const char* invalid_reason(const Environment& env) const;
+  inline std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const {
+    return {this->key, this->result};
+  }
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
+static_assert(sizeof(PyLruListElemObject) == 0x38);
+
+// See lru_cache_object in https://github.com/python/cpython/blob/3.10/Modules/_functoolsmodule.c. This is the type of
+// functions decorated with functools.lru_cache (and functools.cache).
+struct PyLruCacheObject : PyObject {
+  // The list's root element is embedded here (its ob_refcnt and ob_type are this object's)
+  MappedPtr<PyLruListElemObject> root_prev;
+  MappedPtr<PyLruListElemObject> root_next;
+  int64_t root_hash;
+  MappedPtr<PyObject> root_key;
+  MappedPtr<PyObject> root_result;
+  MappedPtr<void> wrapper; // Implementation function; depends on maxsize
+  int32_t typed;
+  MappedPtr<PyObject> cache; // Dict of {key: lru_list_elem} if maxsize > 0, or {key: result} if unbounded
+  int64_t hits;
+  MappedPtr<PyObject> func;
+  int64_t maxsize; // -1 if unbounded
+  int64_t misses;
+  MappedPtr<PyObject> kwd_mark;
+  MappedPtr<PyTypeObject> lru_list_elem_type;
+  MappedPtr<PyObject> cache_info_type;
+  MappedPtr<PyObject> dict;
+  MappedPtr<PyObject> weakreflist;
+
+  const char* invalid_reason(const Environment& env) const;
+  inline std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const {
+    return {this->cache, this->func, this->kwd_mark, this->cache_info_type, this->dict};
+  }
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
+static_assert(sizeof(PyLruCacheObject) == 0x98);
+
+// Returns a short human-readable name for a callable object, suitable for grouping callbacks by what they call: the
+// qualified name for functions, the underlying function's name for bound methods and partials, and Type.name for
+// builtin methods. For other objects, returns the type name in angle brackets. Never throws.
+std::string describe_callable(const Environment& env, MappedPtr<PyObject> addr);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "PyObject.hh"
+
+// See https://github.com/python/cpython/blob/3.10/Include/internal/pycore_gc.h. None of these are PyObjects.
+
+// Every GC-tracked object is immediately preceded by one of these
+struct PyGCHead {
+  static constexpr uint64_t PREV_FLAGS_MASK = 3; // Low bits of _gc_prev are used as flags during collection
+  static constexpr uint64_t NEXT_MASK_UNREACHABLE = 1; // Only set during collection
+
+  uint64_t _gc_next;
+  uint64_t _gc_prev;
+
+  inline MappedPtr<PyGCHead> next() const {
+    return MappedPtr<PyGCHead>(this->_gc_next & ~NEXT_MASK_UNREACHABLE);
+  }
+  inline MappedPtr<PyGCHead> prev() const {
+    return MappedPtr<PyGCHead>(this->_gc_prev & ~PREV_FLAGS_MASK);
+  }
+  static inline MappedPtr<PyObject> object_for_head(MappedPtr<PyGCHead> addr) {
+    return addr.offset_bytes(sizeof(PyGCHead)).cast<PyObject>();
+  }
+};
+
+struct PyGCGeneration {
+  PyGCHead head; // Sentinel of a circular doubly-linked list of all objects in this generation
+  int32_t threshold;
+  int32_t count; // For generation 0, allocations minus deallocations; for others, collections of the next-younger one
+};
+
+struct PyGCGenerationStats {
+  int64_t collections;
+  int64_t collected;
+  int64_t uncollectable;
+};
+
+// This is embedded in PyInterpreterState (as interp->gc)
+struct PyGCRuntimeState {
+  static constexpr size_t NUM_GENERATIONS = 3;
+
+  MappedPtr<PyObject> trash_delete_later;
+  int32_t trash_delete_nesting;
+  int32_t enabled;
+  int32_t debug;
+  PyGCGeneration generations[NUM_GENERATIONS];
+  MappedPtr<PyGCHead> generation0; // Always points to generations[0].head
+  PyGCGeneration permanent_generation; // Objects moved here by gc.freeze()
+  PyGCGenerationStats generation_stats[NUM_GENERATIONS];
+  int32_t collecting;
+  MappedPtr<PyObject> garbage; // gc.garbage
+  MappedPtr<PyObject> callbacks; // gc.callbacks
+  int64_t long_lived_total; // Number of objects that survived the last full collection
+  int64_t long_lived_pending; // Number of objects that survived non-full collections since then
+
+  // There's no way to find the interpreter state without symbols, but this structure refers to itself via
+  // generation0, which makes it easy to find by scanning memory
+  inline const char* invalid_reason(const Environment& env, MappedPtr<PyGCRuntimeState> addr) const {
+    auto gen0_head_addr = addr.offset_bytes(offsetof(PyGCRuntimeState, generations)).cast<PyGCHead>();
+    if (this->generation0 != gen0_head_addr) {
+      return "invalid_generation0";
+    }
+    if ((this->enabled & ~1) || (this->collecting & ~1)) {
+      return "invalid_flags";
+    }
+    for (size_t z = 0; z < NUM_GENERATIONS; z++) {
+      const auto& gen = this->generations[z];
+      if ((gen.threshold < 0) || (gen.count < 0)) {
+        return "invalid_generation_state";
+      }
+      if (!env.r.obj_valid(gen.head.next()) || !env.r.obj_valid(gen.head.prev())) {
+        return "invalid_generation_list";
+      }
+    }
+    if ((this->long_lived_total < 0) || (this->long_lived_pending < 0)) {
+      return "invalid_long_lived_count";
+    }
+    return nullptr;
+  }
+};
+static_assert(sizeof(PyGCRuntimeState) == 0xF0);
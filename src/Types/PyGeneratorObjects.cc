@@ -52,6 +52,38 @@ std::vector<std::string> PyGenObject::repr_tokens(Traversal& t) const {
   return tokens;
 }
 
+MappedPtr<PyFrameObject> PyGenObject::innermost_frame(const Environment& env) const {
+  auto frame_addr = this->gi_frame;
+  // The chain can't be longer than the recursion limit, but a corrupt snapshot could make it cyclic
+  for (size_t depth = 0; (depth < 0x1000) && !frame_addr.is_null(); depth++) {
+    const auto& frame = env.r.get(frame_addr);
+    if (frame.is_running()) {
+      break;
+    }
+    // Like gen_yf in genobject.c: the frame is only awaiting the object at the top of its stack if it's suspended at
+    // a YIELD_FROM (f_lasti points to the instruction before it, so it's re-executed on resume). At a plain yield,
+    // the top of the stack may be an unrelated generator, such as one being iterated by a for loop. Frames that
+    // haven't started yet (f_lasti < 0) aren't awaiting anything.
+    if ((frame.f_lasti < 0) || (frame.opcode_at(env, frame.f_lasti + 1) != PyOpcode::YIELD_FROM)) {
+      break;
+    }
+    auto awaited_addr = frame.stack_top(env);
+    if (awaited_addr.is_null() || !env.r.obj_valid(awaited_addr)) {
+      break;
+    }
+    auto awaited_type = env.r.get(awaited_addr).ob_type;
+    if ((awaited_type != env.get_type_if_exists("generator")) && (awaited_type != env.get_type_if_exists("coroutine"))) {
+      break;
+    }
+    auto awaited_frame_addr = env.r.get(awaited_addr.cast<PyGenObject>()).gi_frame;
+    if (awaited_frame_addr.is_null() || !env.r.obj_valid(awaited_frame_addr)) {
+      break;
+    }
+    frame_addr = awaited_frame_addr;
+  }
+  return frame_addr;
+}
+
 std::string PyGenObject::repr(Traversal& t) const {
   return t.token_repr<PyGenObject>(*this, "generator");
 }
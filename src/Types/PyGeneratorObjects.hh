@@ -19,6 +19,11 @@ struct PyGenObject : PyObject {
   std::string repr(Traversal& t) const;
 
   std::vector<std::string> repr_tokens(Traversal& t) const;
+
+  // Follows the chain of generators and coroutines that this one is awaiting (or yielding from), and returns the
+  // innermost one's frame. This is where a suspended task is actually waiting. Returns null if this generator has
+  // finished (and therefore has no frame).
+  MappedPtr<PyFrameObject> innermost_frame(const Environment& env) const;
 };
 
 // See https://github.com/python/cpython/blob/3.10/Include/genobject.h
@@ -11,6 +11,23 @@ const char* PyLongObject::invalid_reason(const Environment& env) const {
   return nullptr;
 }
 
+int64_t PyLongObject::as_int64(const MemoryReader& r) const {
+  int64_t num_digits = (this->ob_size < 0) ? -this->ob_size : this->ob_size;
+  if (num_digits > 3) {
+    throw std::out_of_range("Integer is too large");
+  }
+  auto digits_r = r.read(r.host_to_mapped(this).offset_bytes(sizeof(*this)), num_digits * 4);
+  uint64_t value = 0;
+  for (int64_t z = 0; z < num_digits; z++) {
+    uint64_t digit = digits_r.get_u32l() & 0x3FFFFFFF;
+    if ((z == 2) && (digit & 0xFFFFFFF8)) {
+      throw std::out_of_range("Integer is too large");
+    }
+    value |= digit << (z * 30);
+  }
+  return (this->ob_size < 0) ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+}
+
 std::string PyLongObject::repr(Traversal& t) const {
   if (const char* ir = t.check_valid(*this)) {
     return std::format("<int !{}>", ir);
@@ -6,6 +6,9 @@
 struct PyLongObject : PyVarObject {
   const char* invalid_reason(const Environment& env) const;
   std::string repr(Traversal& t) const;
+
+  // Returns the value of the integer. Throws out_of_range if it doesn't fit in an int64_t.
+  int64_t as_int64(const MemoryReader& r) const;
 };
 
 struct PyBoolObject : PyLongObject {
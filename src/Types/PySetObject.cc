@@ -14,6 +14,41 @@ std::vector<MappedPtr<PyObject>> PySetObject::get_items(const MemoryReader& r) c
   return ret;
 }
 
+std::vector<std::pair<MappedPtr<PyObject>, size_t>> PySetObject::get_probe_lengths(const MemoryReader& r) const {
+  static constexpr uint64_t LINEAR_PROBES = 9;
+  auto entries_r = this->read_entries(r);
+  uint64_t mask = this->mask;
+
+  std::vector<std::pair<MappedPtr<PyObject>, size_t>> ret;
+  for (uint64_t z = 0; z <= mask; z++) {
+    const auto& entry = entries_r.pget<Entry>(z * sizeof(Entry));
+    // Dummy entries have a hash of -1, which no live object can have
+    if (entry.key.is_null() || (entry.hash == static_cast<uint64_t>(-1))) {
+      continue;
+    }
+    // Follow the same probe sequence as set_lookkey in setobject.c: a short linear scan from each slot (if it doesn't
+    // wrap around the end of the table), then a perturbed jump to the next slot
+    uint64_t perturb = entry.hash;
+    uint64_t slot = entry.hash & mask;
+    size_t probes = 0;
+    bool found = false;
+    while (!found && (probes <= mask + 1)) {
+      probes++;
+      found = (slot == z);
+      if (!found && (slot + LINEAR_PROBES <= mask)) {
+        for (uint64_t x = 1; !found && (x <= LINEAR_PROBES); x++) {
+          probes++;
+          found = (slot + x == z);
+        }
+      }
+      perturb >>= 5;
+      slot = (slot * 5 + 1 + perturb) & mask;
+    }
+    ret.emplace_back(entry.key, probes);
+  }
+  return ret;
+}
+
 const char* PySetObject::invalid_reason(const Environment& env) const {
   if (const char* ir = this->PyObject::invalid_reason(env)) {
     return ir;
@@ -23,8 +23,21 @@ struct PySetObject : PyObject {
   std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const;
   std::string repr(Traversal& t) const;
 
+  // Smallest table size that a freshly-built set with this many items would have (tables are resized when they're
+  // 3/5 full; see set_add_entry in setobject.c)
+  static inline uint64_t min_table_size_for_items(uint64_t num_items) {
+    uint64_t table_size = 8; // PySet_MINSIZE
+    while (num_items * 5 >= (table_size - 1) * 3) {
+      table_size <<= 1;
+    }
+    return table_size;
+  }
+
   inline phosg::StringReader read_entries(const MemoryReader& r) const {
     return r.read(this->table, sizeof(Entry) * (this->mask + 1));
   }
   std::vector<MappedPtr<PyObject>> get_items(const MemoryReader& r) const;
+  // Returns (key, probe count) for each active entry, where the probe count is the number of table entries that a
+  // lookup for that key compares against (1 means no collisions)
+  std::vector<std::pair<MappedPtr<PyObject>, size_t>> get_probe_lengths(const MemoryReader& r) const;
 };
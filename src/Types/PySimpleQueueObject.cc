@@ -0,0 +1,45 @@
+#include "PySimpleQueueObject.hh"
+
+const char* PySimpleQueueObject::invalid_reason(const Environment& env) const {
+  if (!env.r.obj_valid(this->lock, 8)) {
+    return "invalid_lock";
+  }
+  if (this->locked & ~1) {
+    return "invalid_locked";
+  }
+  if (!env.r.obj_valid_or_null(this->weakreflist, 1)) {
+    return "invalid_weakreflist";
+  }
+  if (const char* ir = env.invalid_reason(this->lst.cast<PyObject>(), env.get_type_if_exists("list"))) {
+    return ir;
+  }
+  if ((this->lst_pos < 0) || (this->lst_pos > env.r.get(this->lst).ob_size)) {
+    return "invalid_lst_pos";
+  }
+  return nullptr;
+}
+
+std::vector<MappedPtr<PyObject>> PySimpleQueueObject::get_items(const MemoryReader& r) const {
+  auto items = r.get(this->lst).get_items(r);
+  items.erase(items.begin(), items.begin() + this->lst_pos);
+  return items;
+}
+
+std::unordered_set<MappedPtr<void>> PySimpleQueueObject::direct_referents(const Environment& env) const {
+  return {this->lst, this->weakreflist};
+}
+
+std::vector<std::string> PySimpleQueueObject::repr_tokens(Traversal& t) const {
+  std::vector<std::string> tokens;
+  const auto& lst = t.env.r.get(this->lst);
+  tokens.emplace_back(std::format("size={}", lst.ob_size - this->lst_pos));
+  tokens.emplace_back(std::format("items={}", t.repr(this->lst.cast<PyObject>())));
+  if (this->lst_pos) {
+    tokens.emplace_back(std::format("consumed={}", this->lst_pos));
+  }
+  return tokens;
+}
+
+std::string PySimpleQueueObject::repr(Traversal& t) const {
+  return t.token_repr<PySimpleQueueObject>(*this, "_queue.SimpleQueue");
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "PyListObject.hh"
+#include "PyObject.hh"
+
+// See simplequeueobject in https://github.com/python/cpython/blob/3.10/Modules/_queuemodule.c. This is the type of
+// queue.SimpleQueue objects, which ThreadPoolExecutor uses for its work queue.
+struct PySimpleQueueObject : PyObject {
+  MappedPtr<void> lock; // PyThread_type_lock; held while the queue is empty
+  int32_t locked;
+  MappedPtr<PyListObject> lst;
+  int64_t lst_pos; // Items before this index in lst have already been consumed
+  MappedPtr<PyObject> weakreflist;
+
+  const char* invalid_reason(const Environment& env) const;
+  std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const;
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+
+  // Returns the items that haven't been consumed yet, in the order they'll be returned by get()
+  std::vector<MappedPtr<PyObject>> get_items(const MemoryReader& r) const;
+};
@@ -1,7 +1,7 @@
 #include "PyStringObjects.hh"
 #include "Base.hh"
 
-static std::string escape_string(phosg::StringReader r, bool is_str, size_t max_len = 0) {
+std::string escape_string(phosg::StringReader r, bool is_str, size_t max_len) {
   std::string ret;
   if (!is_str) {
     ret.push_back('b');
@@ -70,31 +70,83 @@ static std::string decode_ucs(phosg::StringReader r, uint8_t ucs_type) {
   return ret;
 }
 
-std::string decode_string_types(const MemoryReader& r, MappedPtr<PyObject> addr) {
+StringRepresentationSizes get_string_representation_sizes(const MemoryReader& r, MappedPtr<PyObject> addr) {
+  // See unicode_sizeof_impl in https://github.com/python/cpython/blob/3.10/Objects/unicodeobject.c
+  const auto& str = r.get(addr.cast<PyASCIIStringObject>());
+  StringRepresentationSizes ret;
+  MappedPtr<void> data_addr;
+  if (str.is_compact() && str.is_ascii()) {
+    ret.data_bytes = str.length + 1;
+    ret.object_bytes = sizeof(PyASCIIStringObject) + ret.data_bytes;
+    data_addr = addr.offset_bytes(sizeof(PyASCIIStringObject));
+  } else if (str.is_compact()) {
+    ret.data_bytes = (str.length + 1) * str.char_kind();
+    ret.object_bytes = sizeof(PyCompactStringObject) + ret.data_bytes;
+    data_addr = addr.offset_bytes(sizeof(PyCompactStringObject));
+  } else {
+    const auto& general_str = r.get(addr.cast<PyGeneralStringObject>());
+    ret.object_bytes = sizeof(PyGeneralStringObject);
+    data_addr = general_str.data;
+    if (!data_addr.is_null()) {
+      ret.data_bytes = (str.length + 1) * str.char_kind();
+      ret.object_bytes += ret.data_bytes;
+    }
+  }
+
+  if (!str.wstr.is_null() && (str.wstr != data_addr)) {
+    // Compact ASCII strings don't have a wstr_length field; their wstr length is always the same as their length
+    size_t wstr_length = (str.is_compact() && str.is_ascii())
+        ? str.length
+        : r.get(addr.cast<PyCompactStringObject>()).wstr_length;
+    ret.wstr_bytes = (wstr_length + 1) * sizeof(wchar_t);
+  }
+  if (!str.is_compact() || !str.is_ascii()) {
+    const auto& compact_str = r.get(addr.cast<PyCompactStringObject>());
+    if (!compact_str.utf8.is_null() && (compact_str.utf8 != data_addr)) {
+      ret.utf8_bytes = compact_str.utf8_length + 1;
+    }
+  }
+  return ret;
+}
+
+phosg::StringReader read_string_data(const MemoryReader& r, MappedPtr<PyObject> addr, size_t max_chars) {
   const auto& obj = r.get(addr.cast<PyASCIIStringObject>());
-  if (obj.length == 0) {
-    return "";
+  size_t length = (max_chars && (max_chars < obj.length)) ? max_chars : obj.length;
+  if (length == 0) {
+    return phosg::StringReader();
   }
 
   if (obj.is_compact() && obj.is_ascii()) {
     try {
-      return r.read(addr.offset_bytes(sizeof(obj)).cast<char>(), obj.length).all();
+      return r.read(addr.offset_bytes(sizeof(obj)), length);
     } catch (const std::out_of_range&) {
       throw invalid_object("invalid_ascii_str_data");
     }
 
   } else {
-    uint8_t char_kind = obj.char_kind();
-    bool is_compact = obj.is_compact();
     MappedPtr<void> data_addr;
-    if (is_compact) {
+    if (obj.is_compact()) {
       data_addr = addr.offset_bytes(sizeof(PyCompactStringObject));
     } else {
       data_addr = r.get(addr.cast<PyGeneralStringObject>()).data;
     }
 
     try {
-      return decode_ucs(r.read(data_addr, obj.length * char_kind), char_kind);
+      return r.read(data_addr, length * obj.char_kind());
+    } catch (const std::out_of_range&) {
+      throw invalid_object("invalid_unicode_str_data");
+    }
+  }
+}
+
+std::string decode_string_types(const MemoryReader& r, MappedPtr<PyObject> addr, size_t max_chars) {
+  const auto& obj = r.get(addr.cast<PyASCIIStringObject>());
+  auto data_r = read_string_data(r, addr, max_chars);
+  if (obj.is_compact() && obj.is_ascii()) {
+    return data_r.all();
+  } else {
+    try {
+      return decode_ucs(data_r, obj.char_kind());
     } catch (const std::out_of_range&) {
       throw invalid_object("invalid_unicode_str_data");
     }
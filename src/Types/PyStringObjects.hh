@@ -56,6 +56,31 @@ struct PyGeneralStringObject : PyCompactStringObject {
   MappedPtr<void> data; // void*, Py_UCS1*, Py_UCS2*, or Py_UCS4*
 };
 
+// Sizes of the various representations of a str object, computed from header fields only (this doesn't read the
+// string's data)
+struct StringRepresentationSizes {
+  size_t object_bytes = 0; // Size of the object itself, including its data if the string is compact
+  size_t data_bytes = 0; // Canonical (PEP 393) data, including the trailing null
+  size_t utf8_bytes = 0; // Cached UTF-8 copy (not present for ASCII strings, which use their data as UTF-8)
+  size_t wstr_bytes = 0; // Cached wchar_t copy (or the only data, for legacy strings that were never made ready)
+
+  inline size_t total_bytes() const {
+    // Compact strings' data is part of the object; object_bytes already accounts for this
+    return this->object_bytes + this->utf8_bytes + this->wstr_bytes;
+  }
+};
+StringRepresentationSizes get_string_representation_sizes(const MemoryReader& r, MappedPtr<PyObject> addr);
+
+// Returns a reader for the string's data in its native representation (1, 2, or 4 bytes per code point, as given by
+// char_kind; compact ASCII strings always use 1 byte per code point), without decoding or copying it. Two equal
+// strings always have the same native representation. If max_chars is nonzero, reads at most that many code points.
+phosg::StringReader read_string_data(const MemoryReader& r, MappedPtr<PyObject> addr, size_t max_chars = 0);
+
 // Returns a copy of the UTF-8 data associated with a string, regardless of what format is actually stored in memory.
-// For bytes objects, use PyBytesObject::read_contents instead.
-std::string decode_string_types(const MemoryReader& r, MappedPtr<PyObject> addr);
+// For bytes objects, use PyBytesObject::read_contents instead. If max_chars is nonzero, decodes at most that many code
+// points.
+std::string decode_string_types(const MemoryReader& r, MappedPtr<PyObject> addr, size_t max_chars = 0);
+
+// Formats data as a Python str or bytes literal, escaping non-printable characters. If max_len is nonzero, truncates
+// the output after that many bytes of data.
+std::string escape_string(phosg::StringReader r, bool is_str, size_t max_len = 0);
@@ -0,0 +1,47 @@
+#include "PyThreadLockObjects.hh"
+
+const char* PyThreadLockObject::invalid_reason(const Environment& env) const {
+  if (!env.r.obj_valid(this->lock_lock, 8)) {
+    return "invalid_lock_lock";
+  }
+  if (!env.r.obj_valid_or_null(this->in_weakreflist, 1)) {
+    return "invalid_in_weakreflist";
+  }
+  if (this->locked & ~1) {
+    return "invalid_locked";
+  }
+  return nullptr;
+}
+
+std::vector<std::string> PyThreadLockObject::repr_tokens(Traversal& t) const {
+  return {this->locked ? "locked" : "unlocked"};
+}
+
+std::string PyThreadLockObject::repr(Traversal& t) const {
+  return t.token_repr<PyThreadLockObject>(*this, "_thread.lock");
+}
+
+const char* PyThreadRLockObject::invalid_reason(const Environment& env) const {
+  if (!env.r.obj_valid(this->rlock_lock, 8)) {
+    return "invalid_rlock_lock";
+  }
+  if (!env.r.obj_valid_or_null(this->in_weakreflist, 1)) {
+    return "invalid_in_weakreflist";
+  }
+  // The count can't realistically be this large; if it is, this probably isn't an RLock
+  if (this->rlock_count > 0x100000000) {
+    return "invalid_rlock_count";
+  }
+  return nullptr;
+}
+
+std::vector<std::string> PyThreadRLockObject::repr_tokens(Traversal& t) const {
+  if (this->rlock_count == 0) {
+    return {"unlocked"};
+  }
+  return {std::format("owner={:X}", this->rlock_owner), std::format("count={}", this->rlock_count)};
+}
+
+std::string PyThreadRLockObject::repr(Traversal& t) const {
+  return t.token_repr<PyThreadRLockObject>(*this, "_thread.RLock");
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "PyObject.hh"
+
+// See lockobject in https://github.com/python/cpython/blob/3.10/Modules/_threadmodule.c. This is the type of
+// threading.Lock objects (and of the per-waiter locks used by threading.Condition).
+struct PyThreadLockObject : PyObject {
+  MappedPtr<void> lock_lock; // PyThread_type_lock (a sem_t* on Linux)
+  MappedPtr<PyObject> in_weakreflist;
+  char locked;
+
+  const char* invalid_reason(const Environment& env) const;
+  inline std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const {
+    return {this->in_weakreflist};
+  }
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
+
+// See rlockobject in https://github.com/python/cpython/blob/3.10/Modules/_threadmodule.c. This is the type of
+// threading.RLock objects, unless the C implementation is unavailable.
+struct PyThreadRLockObject : PyObject {
+  MappedPtr<void> rlock_lock; // PyThread_type_lock
+  uint64_t rlock_owner; // Thread ID (as in PyThreadState::thread_id) of the owning thread; only valid if rlock_count > 0
+  uint64_t rlock_count; // Number of times the owner has acquired the lock; 0 if unlocked
+  MappedPtr<PyObject> in_weakreflist;
+
+  const char* invalid_reason(const Environment& env) const;
+  inline std::unordered_set<MappedPtr<void>> direct_referents(const Environment& env) const {
+    return {this->in_weakreflist};
+  }
+  std::string repr(Traversal& t) const;
+
+  std::vector<std::string> repr_tokens(Traversal& t) const;
+};
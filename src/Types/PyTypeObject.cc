@@ -22,6 +22,114 @@ std::string PyTypeObject::name(const MemoryReader& r) const {
   return this->type_name_is_valid(name) ? name : "";
 }
 
+std::string PyTypeObject::module_name(const Environment& env) const {
+  if (this->is_heap_type() && env.r.obj_valid(this->tp_dict)) {
+    try {
+      const auto& dict = env.r.get(this->tp_dict);
+      if (!dict.invalid_reason(env)) {
+        return decode_string_types(env.r, dict.value_for_key<PyObject>(env.r, "__module__"));
+      }
+    } catch (const std::out_of_range&) {
+    } catch (const invalid_object&) {
+    }
+  }
+  std::string name = this->name(env.r);
+  size_t dot_pos = name.rfind('.');
+  return (dot_pos == std::string::npos) ? "builtins" : name.substr(0, dot_pos);
+}
+
+std::string PyTypeObject::qualname(const Environment& env) const {
+  // See PyHeapTypeObject in https://github.com/python/cpython/blob/3.10/Include/cpython/object.h. The type object is
+  // followed by the method tables (PyAsyncMethods, PyNumberMethods, PyMappingMethods, PySequenceMethods, and
+  // PyBufferProcs), then ht_name, ht_slots, and ht_qualname.
+  static constexpr size_t HT_QUALNAME_OFFSET = sizeof(PyTypeObject) + (4 + 36 + 3 + 10 + 2 + 2) * sizeof(uint64_t);
+  static_assert(HT_QUALNAME_OFFSET == 0x360);
+  if (this->is_heap_type()) {
+    try {
+      auto qualname_addr = env.r.get(
+          env.r.host_to_mapped(this).offset_bytes(HT_QUALNAME_OFFSET).cast<MappedPtr<PyObject>>());
+      if (!env.invalid_reason(qualname_addr, env.get_type_if_exists("str"))) {
+        return decode_string_types(env.r, qualname_addr, 0x400);
+      }
+    } catch (const std::out_of_range&) {
+    } catch (const invalid_object&) {
+    }
+  }
+  return this->name(env.r);
+}
+
+std::string PyTypeObject::qualified_name(const Environment& env) const {
+  std::string name = this->name(env.r);
+  if (!this->is_heap_type() || (name.find('.') != std::string::npos)) {
+    return name;
+  }
+  return this->module_name(env) + "." + this->qualname(env);
+}
+
+int64_t PyTypeObject::member_offset(const Environment& env, const std::string& name) const {
+  // Bound the walk in case the tp_base chain is corrupt
+  const PyTypeObject* type_obj = this;
+  for (size_t depth = 0; depth < 0x100; depth++) {
+    if (!type_obj->tp_members.is_null()) {
+      auto member_addr = type_obj->tp_members.cast<PyMemberDef>();
+      for (;; member_addr = member_addr.offset_bytes(sizeof(PyMemberDef))) {
+        const auto& member = env.r.get(member_addr);
+        if (member.name.is_null()) {
+          break;
+        }
+        if (((member.type == PyMemberDef::T_OBJECT) || (member.type == PyMemberDef::T_OBJECT_EX)) &&
+            (env.r.get_cstr(member.name) == name)) {
+          return member.offset;
+        }
+      }
+    }
+    if (type_obj->tp_base.is_null()) {
+      break;
+    }
+    type_obj = &env.r.get(type_obj->tp_base);
+  }
+  throw std::out_of_range("Member not found");
+}
+
+std::vector<int64_t> PyTypeObject::object_member_offsets(const Environment& env) const {
+  std::vector<int64_t> ret;
+  const PyTypeObject* type_obj = this;
+  for (size_t depth = 0; depth < 0x100; depth++) {
+    if (!type_obj->tp_members.is_null()) {
+      auto member_addr = type_obj->tp_members.cast<PyMemberDef>();
+      for (size_t z = 0; z < 0x1000; z++, member_addr = member_addr.offset_bytes(sizeof(PyMemberDef))) {
+        const auto& member = env.r.get(member_addr);
+        if (member.name.is_null()) {
+          break;
+        }
+        if ((member.type == PyMemberDef::T_OBJECT) || (member.type == PyMemberDef::T_OBJECT_EX)) {
+          ret.emplace_back(member.offset);
+        }
+      }
+    }
+    if (type_obj->tp_base.is_null()) {
+      break;
+    }
+    type_obj = &env.r.get(type_obj->tp_base);
+  }
+  return ret;
+}
+
+MappedPtr<PyTypeObject> PyTypeObject::find_in_mro(
+    const Environment& env, const std::string& name, const std::string& module_prefix) const {
+  try {
+    const auto& mro = env.r.get(this->tp_mro.cast<PyTupleObject>());
+    for (auto base_addr : mro.get_items()) {
+      const auto& base = env.r.get(base_addr.cast<PyTypeObject>());
+      if ((base.name(env.r) == name) && base.module_name(env).starts_with(module_prefix)) {
+        return base_addr.cast<PyTypeObject>();
+      }
+    }
+  } catch (const std::out_of_range&) {
+  }
+  return MappedPtr<PyTypeObject>();
+}
+
 const char* PyTypeObject::invalid_reason(const Environment& env) const {
   if (const char* ir = this->PyVarObject::invalid_reason(env)) {
     return ir;
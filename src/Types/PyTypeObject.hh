@@ -5,6 +5,34 @@
 struct PyDictObject;
 struct PyTupleObject;
 
+// See the Py_TPFLAGS_* definitions in https://github.com/python/cpython/blob/3.10/Include/object.h
+enum PyTypeFlags : unsigned long {
+  Py_TPFLAGS_HEAPTYPE = (1UL << 9),
+  Py_TPFLAGS_HAVE_GC = (1UL << 14),
+  Py_TPFLAGS_LONG_SUBCLASS = (1UL << 24),
+  Py_TPFLAGS_LIST_SUBCLASS = (1UL << 25),
+  Py_TPFLAGS_TUPLE_SUBCLASS = (1UL << 26),
+  Py_TPFLAGS_BYTES_SUBCLASS = (1UL << 27),
+  Py_TPFLAGS_UNICODE_SUBCLASS = (1UL << 28),
+  Py_TPFLAGS_DICT_SUBCLASS = (1UL << 29),
+  Py_TPFLAGS_BASE_EXC_SUBCLASS = (1UL << 30),
+  Py_TPFLAGS_TYPE_SUBCLASS = (1UL << 31),
+};
+
+// See https://github.com/python/cpython/blob/3.10/Include/structmember.h. tp_members points to an array of these,
+// terminated by an entry with a null name. For classes that define __slots__, there's one entry per slot.
+struct PyMemberDef {
+  static constexpr int32_t T_OBJECT = 6; // Reads as None if null
+  static constexpr int32_t T_OBJECT_EX = 16; // Raises AttributeError if null; used for __slots__
+
+  MappedPtr<char> name;
+  int32_t type;
+  int64_t offset;
+  int32_t flags;
+  MappedPtr<char> doc;
+};
+static_assert(sizeof(PyMemberDef) == 0x28);
+
 // See struct _typeobject in https://github.com/python/cpython/blob/3.10/Include/cpython/object.h
 struct PyTypeObject : PyVarObject {
   /* 0000 */ MappedPtr<char> tp_name;
@@ -71,4 +99,32 @@ struct PyTypeObject : PyVarObject {
 
   static bool type_name_is_valid(const std::string& name);
   std::string name(const MemoryReader& r) const;
+  // Returns the name of the module that defines this type: __module__ from tp_dict for heap types, or the part of
+  // tp_name before the last dot for static types. Types with no dot in their names are in the builtins module.
+  std::string module_name(const Environment& env) const;
+  // Returns __qualname__ for heap types (which is stored in the PyHeapTypeObject, not in tp_dict), or tp_name for
+  // static types
+  std::string qualname(const Environment& env) const;
+  // Returns a name that identifies the type across modules: tp_name if it already includes the module (as it does
+  // for static types and types created from specs), or the module name and __qualname__ otherwise
+  std::string qualified_name(const Environment& env) const;
+  // Returns the offset of the named object member (e.g. a __slots__ attribute) within instances of this type,
+  // searching base classes too. Throws out_of_range if there's no such member.
+  int64_t member_offset(const Environment& env, const std::string& name) const;
+  // Returns the offsets of all object members (T_OBJECT and T_OBJECT_EX) defined by this type and its bases. For
+  // heap types these include __slots__; for builtin types, any extra object fields they expose as attributes.
+  std::vector<int64_t> object_member_offsets(const Environment& env) const;
+  // Returns the address of the first type in this type's MRO (which includes this type itself) that has the given
+  // name (without the module name, for heap types) and is defined in a module whose name starts with module_prefix, or
+  // null if there's no such type. Subclasses often reuse their base class's name (e.g. class Queue(asyncio.Queue)), so
+  // all types with the name are checked, not just the first one.
+  MappedPtr<PyTypeObject> find_in_mro(
+      const Environment& env, const std::string& name, const std::string& module_prefix = "") const;
+
+  inline bool is_heap_type() const {
+    return this->tp_flags & Py_TPFLAGS_HEAPTYPE;
+  }
+  inline bool is_gc() const {
+    return this->tp_flags & Py_TPFLAGS_HAVE_GC;
+  }
 };
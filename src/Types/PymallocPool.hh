@@ -0,0 +1,108 @@
+#pragma once
+
+#include "PyObject.hh"
+
+// See https://github.com/python/cpython/blob/3.10/Objects/obmalloc.c. pymalloc serves all requests up to
+// SMALL_REQUEST_THRESHOLD bytes from pools, each of which holds blocks of a single size class; pools are carved out of
+// arenas. Arenas can only be returned to the OS when all of their pools are empty. Builds that use the radix tree
+// (the default on 64-bit platforms since 3.10) define USE_LARGE_POOLS and USE_LARGE_ARENAS, which makes pools 16KB
+// and arenas 1MB; other builds use 4KB pools and 256KB arenas. Both layouts are supported; the pool size is inferred
+// from each pool's maxnextoffset.
+struct PymallocPoolHeader {
+  // Note that this is not a PyObject - there's no ob_type!
+  static constexpr size_t ALIGNMENT = 16;
+  static constexpr size_t SMALL_REQUEST_THRESHOLD = 512;
+  static constexpr size_t NUM_SIZE_CLASSES = SMALL_REQUEST_THRESHOLD / ALIGNMENT;
+  static constexpr size_t SMALL_POOL_SIZE = 0x1000;
+  static constexpr size_t SMALL_ARENA_SIZE = 0x40000;
+  static constexpr size_t LARGE_POOL_SIZE = 0x4000;
+  static constexpr size_t LARGE_ARENA_SIZE = 0x100000;
+  // Pools are aligned to their size, so scanning at this stride finds pools of either size
+  static constexpr size_t MIN_POOL_SIZE = SMALL_POOL_SIZE;
+  static constexpr size_t POOL_OVERHEAD = 0x30; // sizeof(pool_header), rounded up to ALIGNMENT
+
+  union {
+    MappedPtr<void> padding;
+    uint32_t count; // Number of allocated blocks
+  } ref;
+  MappedPtr<void> freeblock; // Head of this pool's free list (each free block begins with a pointer to the next)
+  MappedPtr<PymallocPoolHeader> nextpool;
+  MappedPtr<PymallocPoolHeader> prevpool;
+  uint32_t arenaindex; // Index into the (process-global) arenas array
+  uint32_t szidx; // Size class index; block size is (szidx + 1) * ALIGNMENT
+  uint32_t nextoffset; // Offset of the next never-used block
+  uint32_t maxnextoffset; // Largest valid value of nextoffset
+
+  inline size_t block_size() const {
+    return (this->szidx + 1) * ALIGNMENT;
+  }
+  // maxnextoffset is always pool_size - block_size (the offset of the last block that fits in the pool)
+  inline size_t pool_size() const {
+    return this->maxnextoffset + this->block_size();
+  }
+  inline size_t arena_size() const {
+    return (this->pool_size() == LARGE_POOL_SIZE) ? LARGE_ARENA_SIZE : SMALL_ARENA_SIZE;
+  }
+  inline size_t pools_per_arena() const {
+    return this->arena_size() / this->pool_size();
+  }
+  inline size_t capacity() const {
+    return (this->pool_size() - POOL_OVERHEAD) / this->block_size();
+  }
+  // Number of blocks that have ever been handed out from this pool (allocated now or on the free list)
+  inline size_t num_carved_blocks() const {
+    return std::min<size_t>((this->nextoffset - POOL_OVERHEAD) / this->block_size(), this->capacity());
+  }
+
+  // Pools aren't tracked anywhere we can find without symbols, so we find them by scanning page-aligned addresses.
+  // This checks all the invariants that obmalloc.c maintains, which makes false positives very unlikely.
+  inline const char* invalid_reason(const MemoryReader& r, MappedPtr<PymallocPoolHeader> addr) const {
+    if (this->szidx >= NUM_SIZE_CLASSES) {
+      return "invalid_szidx";
+    }
+    size_t block_size = this->block_size();
+    size_t pool_size = this->pool_size();
+    if (((pool_size != SMALL_POOL_SIZE) && (pool_size != LARGE_POOL_SIZE)) || (addr.addr & (pool_size - 1))) {
+      return "invalid_maxnextoffset";
+    }
+    if ((this->nextoffset < POOL_OVERHEAD) || (this->nextoffset > pool_size) ||
+        ((this->nextoffset - POOL_OVERHEAD) % block_size)) {
+      return "invalid_nextoffset";
+    }
+    if (this->ref.count > this->num_carved_blocks()) {
+      return "invalid_count";
+    }
+    return nullptr;
+  }
+
+  // Returns the offsets (from the beginning of the pool) of all allocated blocks. Throws out_of_range if the free list
+  // is corrupt.
+  std::vector<size_t> allocated_block_offsets(const MemoryReader& r, MappedPtr<PymallocPoolHeader> addr) const {
+    size_t block_size = this->block_size();
+    size_t num_carved = this->num_carved_blocks();
+    std::vector<bool> is_free(num_carved, false);
+    size_t num_free = 0;
+    for (auto free_addr = this->freeblock; !free_addr.is_null(); free_addr = r.get(free_addr.cast<MappedPtr<void>>())) {
+      if ((free_addr < addr.offset_bytes(POOL_OVERHEAD)) || (free_addr >= addr.offset_bytes(this->pool_size()))) {
+        // The last entry in the free list may point to the next never-used block, which is past num_carved
+        break;
+      }
+      size_t index = (addr.bytes_until(free_addr) - POOL_OVERHEAD) / block_size;
+      if ((index >= num_carved) || is_free[index]) {
+        break;
+      }
+      is_free[index] = true;
+      if (++num_free > num_carved) {
+        throw std::out_of_range("Pool free list is too long");
+      }
+    }
+
+    std::vector<size_t> ret;
+    for (size_t z = 0; z < num_carved; z++) {
+      if (!is_free[z]) {
+        ret.emplace_back(POOL_OVERHEAD + z * block_size);
+      }
+    }
+    return ret;
+  }
+};
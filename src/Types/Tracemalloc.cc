@@ -0,0 +1,54 @@
+#include "Tracemalloc.hh"
+
+const char* PyHashtable::invalid_reason(const MemoryReader& r) const {
+  // Tables are never smaller than HASHTABLE_MIN_SIZE, and are resized when they're more than half full
+  if ((this->nbuckets < 16) || (this->nbuckets & (this->nbuckets - 1)) || (this->nentries > this->nbuckets)) {
+    return "invalid_size";
+  }
+  if (!r.obj_valid(this->get_entry_func, 1) || !r.obj_valid(this->hash_func, 1) ||
+      !r.obj_valid(this->compare_func, 1) || !r.obj_valid(this->alloc_malloc, 1) || !r.obj_valid(this->alloc_free, 1)) {
+    return "invalid_func";
+  }
+  if ((!this->key_destroy_func.is_null() && !r.exists(this->key_destroy_func)) ||
+      (!this->value_destroy_func.is_null() && !r.exists(this->value_destroy_func))) {
+    return "invalid_destroy_func";
+  }
+  if (!r.obj_valid(this->buckets, 0x10) || !r.exists_array(this->buckets, this->nbuckets)) {
+    return "invalid_buckets";
+  }
+  return nullptr;
+}
+
+// See traceback_t in _tracemalloc.c; frames are packed, so they begin immediately after the two counts
+struct TracemallocTracebackHeader {
+  uint64_t hash;
+  uint16_t nframe;
+  uint16_t total_nframe;
+} __attribute__((packed));
+static constexpr size_t PACKED_FRAME_SIZE = 12;
+
+const char* TracemallocTrace::invalid_reason(const MemoryReader& r) const {
+  if (!r.obj_valid(this->traceback)) {
+    return "invalid_traceback";
+  }
+  const auto& header = r.get(this->traceback.cast<TracemallocTracebackHeader>());
+  if ((header.nframe == 0) || (header.nframe > header.total_nframe)) {
+    return "invalid_nframe";
+  }
+  if (!r.exists_range(this->traceback.offset_bytes(sizeof(TracemallocTracebackHeader)), header.nframe * PACKED_FRAME_SIZE)) {
+    return "invalid_frames";
+  }
+  return nullptr;
+}
+
+std::vector<TracemallocFrame> get_tracemalloc_frames(const MemoryReader& r, MappedPtr<void> traceback_addr) {
+  const auto& header = r.get(traceback_addr.cast<TracemallocTracebackHeader>());
+  auto frames_r = r.read(traceback_addr.offset_bytes(sizeof(TracemallocTracebackHeader)), header.nframe * PACKED_FRAME_SIZE);
+  std::vector<TracemallocFrame> ret;
+  while (!frames_r.eof()) {
+    auto& frame = ret.emplace_back();
+    frame.filename = MappedPtr<PyObject>(frames_r.get_u64l());
+    frame.lineno = frames_r.get_u32l();
+  }
+  return ret;
+}
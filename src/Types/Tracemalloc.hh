@@ -0,0 +1,64 @@
+#pragma once
+
+#include "PyObject.hh"
+
+// See https://github.com/python/cpython/blob/3.10/Include/internal/pycore_hashtable.h. This is the generic hashtable
+// used by tracemalloc (among others); it's not a PyObject.
+struct PyHashtable {
+  struct Entry {
+    MappedPtr<Entry> next;
+    uint64_t key_hash;
+    MappedPtr<void> key;
+    MappedPtr<void> value;
+  };
+
+  uint64_t nentries;
+  uint64_t nbuckets;
+  MappedPtr<MappedPtr<Entry>> buckets;
+  MappedPtr<void> get_entry_func;
+  MappedPtr<void> hash_func;
+  MappedPtr<void> compare_func;
+  MappedPtr<void> key_destroy_func; // May be null
+  MappedPtr<void> value_destroy_func; // May be null
+  MappedPtr<void> alloc_malloc;
+  MappedPtr<void> alloc_free;
+
+  const char* invalid_reason(const MemoryReader& r) const;
+
+  // Calls fn(key, value) for each entry. Throws out_of_range if the table is corrupt.
+  template <typename FnT>
+    requires(std::is_invocable_r_v<void, FnT, MappedPtr<void>, MappedPtr<void>>)
+  void for_each_entry(const MemoryReader& r, FnT&& fn) const {
+    const auto* buckets = r.get_array(this->buckets, this->nbuckets);
+    size_t num_entries = 0;
+    for (size_t z = 0; z < this->nbuckets; z++) {
+      for (auto entry_addr = buckets[z]; !entry_addr.is_null();) {
+        if (++num_entries > this->nentries) {
+          throw std::out_of_range("Too many entries in hashtable");
+        }
+        const auto& entry = r.get(entry_addr);
+        fn(entry.key, entry.value);
+        entry_addr = entry.next;
+      }
+    }
+  }
+};
+
+// See https://github.com/python/cpython/blob/3.10/Modules/_tracemalloc.c. tracemalloc_traces (and the tables in
+// tracemalloc_domains, for domains other than 0) map each traced memory block's address to one of these.
+struct TracemallocTrace {
+  uint64_t size;
+  MappedPtr<void> traceback; // Points to a traceback_t, which is decoded by get_tracemalloc_frames
+
+  const char* invalid_reason(const MemoryReader& r) const;
+};
+
+// Frames are packed (12 bytes each) in memory; this is the unpacked equivalent
+struct TracemallocFrame {
+  MappedPtr<PyObject> filename;
+  uint32_t lineno;
+};
+
+// Returns the frames of a traceback_t, most recent call first. There may be fewer frames than were actually on the
+// stack; tracemalloc only records as many frames as its limit (the argument to tracemalloc.start) allows.
+std::vector<TracemallocFrame> get_tracemalloc_frames(const MemoryReader& r, MappedPtr<void> traceback_addr);